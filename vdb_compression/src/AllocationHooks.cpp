@@ -0,0 +1,43 @@
+// Global operator new/delete replacements feeding the PhaseProfiler
+// allocation counters: every C++ heap allocation in the process is counted,
+// including those made inside OpenVDB and TBB. Linked into the command-line
+// tools only (VDB_COUNT_ALLOCATIONS); libvdbcompress leaves the allocator of
+// its host program alone.
+
+#include "PhaseProfiler.h"
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+const bool kCountingEnabled = (PhaseProfiler::enableAllocationCounting(), true);
+
+} // namespace
+
+void* operator new(std::size_t size) {
+    PhaseProfiler::recordAllocation(size);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    PhaseProfiler::recordAllocation(size);
+    return std::malloc(size ? size : 1);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
@@ -0,0 +1,258 @@
+#include "BatchCompressor.h"
+#include "VDBCompressorVTK.h"
+#include "VTKSlabReader.h"
+#include "VolumeCompression.h"
+#include <openvdb/openvdb.h>
+#include <openvdb/io/File.h>
+#include <tbb/parallel_pipeline.h>
+#include <tbb/task_arena.h>
+#include <glob.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+
+// Working memory of an in-memory compression per input voxel: the float
+// volume, the sorted copy for the background median and the output grid
+const size_t kBytesPerVoxel = 3 * sizeof(float);
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+struct BatchCompressor::Item {
+    size_t index = 0;
+    std::vector<float> volumeData;
+    openvdb::GridPtrVec grids;
+    BatchFileResult result;
+};
+
+BatchCompressor::BatchCompressor(const BatchOptions& options)
+    : options_(options) {
+    CompressionSettings settings;
+    settings.quality = options_.quality;
+    settings.brickSize = options_.brickSize;
+    settings.metricType = options_.metricType;
+    settings.maxError = options_.maxError;
+    settings.targetPSNR = options_.targetPSNR;
+    settings.targetBytes = options_.targetBytes;
+    settings.tileTolerance = options_.tileTolerance;
+    settings.adaptiveBackground = options_.adaptiveBackground;
+    settings.outputType = options_.outputType;
+    validateSettings(settings, options_.lodLevels);
+    openvdb::initialize();
+    registerOutputGridTypes();
+}
+
+std::vector<std::string> BatchCompressor::expandInputs(const std::string& listOrPattern) {
+    std::vector<std::string> files;
+    if (listOrPattern.find_first_of("*?[") != std::string::npos) {
+        glob_t matches;
+        int status = glob(listOrPattern.c_str(), 0, nullptr, &matches);
+        if (status == 0) {
+            files.assign(matches.gl_pathv, matches.gl_pathv + matches.gl_pathc);
+        }
+        globfree(&matches);
+        if (status != 0 && status != GLOB_NOMATCH) {
+            throw std::runtime_error("Failed to expand: " + listOrPattern);
+        }
+    } else {
+        std::ifstream in(listOrPattern);
+        if (!in) {
+            throw std::runtime_error("Failed to open file list: " + listOrPattern);
+        }
+        std::string line;
+        while (std::getline(in, line)) {
+            size_t begin = line.find_first_not_of(" \t\r");
+            if (begin == std::string::npos || line[begin] == '#') continue;
+            size_t end = line.find_last_not_of(" \t\r");
+            files.push_back(line.substr(begin, end - begin + 1));
+        }
+    }
+    if (files.empty()) {
+        throw std::runtime_error("No input files in: " + listOrPattern);
+    }
+    return files;
+}
+
+std::string BatchCompressor::outputPath(const std::string& input) const {
+    size_t slash = input.find_last_of("/\\");
+    size_t dot = input.find_last_of('.');
+    std::string stem = (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+                       ? input : input.substr(0, dot);
+    if (options_.outputDir.empty()) {
+        return stem + ".vdb";
+    }
+    std::string name = (slash == std::string::npos) ? stem : stem.substr(slash + 1);
+    char last = options_.outputDir.back();
+    return options_.outputDir + (last == '/' || last == '\\' ? "" : "/") + name + ".vdb";
+}
+
+size_t BatchCompressor::inFlightLimit(const std::vector<std::string>& inputs) const {
+    // One token per file in the pipeline: enough to keep every worker busy
+    // plus the file being read and the one being written
+    size_t threads = static_cast<size_t>(options_.jobs > 0 ? options_.jobs : tbb::this_task_arena::max_concurrency());
+    size_t tokens = threads + 2;
+    if (options_.maxMemory == 0) {
+        return tokens;
+    }
+
+    // Headers only; the largest file decides how many fit in the limit
+    size_t largest = 0;
+    for (const auto& input : inputs) {
+        try {
+            VTKSlabReader header(input);
+            largest = std::max(largest, static_cast<size_t>(header.width()) * header.height() * header.depth());
+        } catch (const std::exception&) {
+            // Reported when the file is read
+        }
+    }
+    size_t perFile = std::max<size_t>(largest * kBytesPerVoxel, 1);
+    return std::max<size_t>(1, std::min(tokens, options_.maxMemory / perFile));
+}
+
+void BatchCompressor::compressItem(Item& item) const {
+    if (!item.result.error.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+        VDBCompressor compressor;
+        compressor.setErrorBound(options_.maxError, options_.targetPSNR);
+        compressor.setTargetBytes(options_.targetBytes);
+        compressor.setTileTolerance(options_.tileTolerance);
+        compressor.setAdaptiveBackground(options_.adaptiveBackground);
+
+        BatchFileResult& r = item.result;
+        openvdb::FloatGrid::Ptr grid = compressor.compressVolume(
+            item.volumeData, r.W, r.H, r.D, options_.quality, options_.brickSize, options_.metricType);
+        std::vector<float>().swap(item.volumeData);
+
+        r.activeVoxels = grid->activeVoxelCount();
+        if (options_.lodLevels > 0) {
+            for (const auto& level : compressor.buildLodPyramid(grid, options_.lodLevels)) {
+                item.grids.push_back(convertOutputGrid(level, options_.outputType));
+            }
+        } else {
+            item.grids.push_back(convertOutputGrid(grid, options_.outputType));
+        }
+    } catch (const std::exception& e) {
+        item.result.error = e.what();
+    }
+    std::vector<float>().swap(item.volumeData);
+    item.result.compressSeconds = secondsSince(start);
+}
+
+void BatchCompressor::writeItem(Item& item) const {
+    if (!item.result.error.empty()) {
+        return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+        openvdb::io::File file(item.result.output);
+        file.write(item.grids);
+        file.close();
+        std::ifstream written(item.result.output, std::ios::binary | std::ios::ate);
+        item.result.outputBytes = static_cast<size_t>(written.tellg());
+    } catch (const std::exception& e) {
+        item.result.error = e.what();
+    }
+    item.grids.clear();
+    item.result.writeSeconds = secondsSince(start);
+}
+
+std::vector<BatchFileResult> BatchCompressor::run(const std::vector<std::string>& inputs) {
+    // Inputs with the same stem in different directories share an output
+    // path under --output-dir; refuse rather than overwrite one with another
+    std::map<std::string, std::string> outputs;
+    for (const auto& input : inputs) {
+        auto inserted = outputs.insert(std::make_pair(outputPath(input), input));
+        if (!inserted.second) {
+            throw std::runtime_error("Inputs " + inserted.first->second + " and " + input +
+                                     " would both be written to " + inserted.first->first);
+        }
+    }
+
+    std::vector<BatchFileResult> results(inputs.size());
+    size_t tokens = inFlightLimit(inputs);
+    std::cout << "Batch: " << inputs.size() << " files, up to " << tokens << " in flight" << std::endl;
+
+    tbb::task_arena arena(options_.jobs > 0 ? options_.jobs : tbb::task_arena::automatic);
+    arena.execute([&] {
+        size_t next = 0;
+        tbb::parallel_pipeline(tokens,
+            tbb::make_filter<void, std::shared_ptr<Item>>(tbb::filter_mode::serial_in_order,
+                [&](tbb::flow_control& control) -> std::shared_ptr<Item> {
+                    if (next >= inputs.size()) {
+                        control.stop();
+                        return nullptr;
+                    }
+                    auto item = std::make_shared<Item>();
+                    item->index = next++;
+                    item->result.input = inputs[item->index];
+                    item->result.output = outputPath(item->result.input);
+                    auto start = std::chrono::steady_clock::now();
+                    try {
+                        loadVTKVolume(item->result.input, item->volumeData,
+                                      item->result.W, item->result.H, item->result.D);
+                    } catch (const std::exception& e) {
+                        item->result.error = e.what();
+                    }
+                    item->result.readSeconds = secondsSince(start);
+                    return item;
+                }) &
+            tbb::make_filter<std::shared_ptr<Item>, std::shared_ptr<Item>>(tbb::filter_mode::parallel,
+                [this](std::shared_ptr<Item> item) {
+                    compressItem(*item);
+                    return item;
+                }) &
+            tbb::make_filter<std::shared_ptr<Item>, void>(tbb::filter_mode::serial_in_order,
+                [&](std::shared_ptr<Item> item) {
+                    writeItem(*item);
+                    const BatchFileResult& r = item->result;
+                    if (r.error.empty()) {
+                        std::cout << "✓ [" << item->index + 1 << "/" << inputs.size() << "] "
+                                  << r.input << " -> " << r.output << std::endl;
+                    } else {
+                        std::cerr << "✗ [" << item->index + 1 << "/" << inputs.size() << "] "
+                                  << r.input << ": " << r.error << std::endl;
+                    }
+                    results[item->index] = r;
+                }));
+    });
+    return results;
+}
+
+void BatchCompressor::printSummary(const std::vector<BatchFileResult>& results, double wallSeconds) {
+    size_t succeeded = 0;
+    size_t totalVoxels = 0;
+    size_t totalBytes = 0;
+
+    std::cout << "=== Batch Summary ===" << std::endl;
+    for (const auto& r : results) {
+        if (!r.error.empty()) {
+            std::cout << "✗ " << r.input << ": " << r.error << std::endl;
+            continue;
+        }
+        size_t voxels = static_cast<size_t>(r.W) * r.H * r.D;
+        ++succeeded;
+        totalVoxels += voxels;
+        totalBytes += r.outputBytes;
+        std::cout << r.input << ": " << r.W << "x" << r.H << "x" << r.D << ", "
+                  << r.activeVoxels << " active voxels, " << r.outputBytes << " bytes ("
+                  << static_cast<double>(voxels * sizeof(float)) / std::max<size_t>(r.outputBytes, 1) << ":1), "
+                  << "read " << r.readSeconds << " s, compress " << r.compressSeconds
+                  << " s, write " << r.writeSeconds << " s" << std::endl;
+    }
+    std::cout << "Files: " << succeeded << " of " << results.size() << " compressed, "
+              << totalBytes << " bytes written" << std::endl;
+    std::cout << "Wall time: " << wallSeconds << " s ("
+              << (wallSeconds > 0.0 ? totalVoxels / wallSeconds : 0.0) << " voxels/s)" << std::endl;
+}
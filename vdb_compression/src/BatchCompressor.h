@@ -0,0 +1,67 @@
+#ifndef BATCHCOMPRESSOR_H
+#define BATCHCOMPRESSOR_H
+
+#include "OutputPrecision.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Compresses many VTK files in one process as a three-stage TBB pipeline:
+// reading file N+1, compressing file N and writing file N-1 overlap.
+// Reads and writes run one at a time in input order; compression runs on
+// as many files in flight as the memory limit allows.
+
+struct BatchOptions {
+    float quality = 0.5f;
+    int brickSize = 32;
+    int metricType = 3;
+    float maxError = 0.0f;
+    float targetPSNR = 0.0f;
+    size_t targetBytes = 0;
+    float tileTolerance = 0.0f;
+    bool adaptiveBackground = false;
+    OutputType outputType = OutputType::Float;
+    int lodLevels = 0;
+    std::string outputDir;   // empty: next to each input
+    int jobs = 0;            // worker threads, 0 = all cores
+    size_t maxMemory = 0;    // estimated bytes of files in flight, 0 = no limit
+};
+
+struct BatchFileResult {
+    std::string input;
+    std::string output;
+    int W = 0, H = 0, D = 0;
+    size_t outputBytes = 0;
+    size_t activeVoxels = 0;
+    double readSeconds = 0.0;
+    double compressSeconds = 0.0;
+    double writeSeconds = 0.0;
+    std::string error;       // empty on success
+};
+
+class BatchCompressor {
+public:
+    explicit BatchCompressor(const BatchOptions& options);
+
+    // Expands a shell glob, or reads a file list (one path per line) when
+    // the argument has no wildcard characters
+    static std::vector<std::string> expandInputs(const std::string& listOrPattern);
+
+    // Processes every file; a failing file is reported and skipped. Throws
+    // before starting when two inputs map to the same output file.
+    std::vector<BatchFileResult> run(const std::vector<std::string>& inputs);
+
+    static void printSummary(const std::vector<BatchFileResult>& results, double wallSeconds);
+
+private:
+    struct Item;
+
+    std::string outputPath(const std::string& input) const;
+    size_t inFlightLimit(const std::vector<std::string>& inputs) const;
+    void compressItem(Item& item) const;
+    void writeItem(Item& item) const;
+
+    BatchOptions options_;
+};
+
+#endif
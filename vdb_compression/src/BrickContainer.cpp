@@ -0,0 +1,422 @@
+#include "BrickContainer.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#ifdef VDB_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef VDB_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace {
+
+const char kMagic[4] = {'V', 'B', 'C', '1'};
+const uint32_t kVersion = 1;
+const size_t kHeaderBytes = 40;
+const size_t kEntryBytes = 48;
+const int kZstdLevel = 3;
+
+template <typename T>
+void putPod(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T getPod(const char*& src) {
+    T value;
+    std::memcpy(&value, src, sizeof(T));
+    src += sizeof(T);
+    return value;
+}
+
+// Groups the i-th byte of every float together, which makes smooth float
+// data far more compressible for byte-oriented codecs
+void shuffleBytes(const float* values, size_t count, char* out) {
+    const char* src = reinterpret_cast<const char*>(values);
+    for (size_t b = 0; b < sizeof(float); ++b) {
+        char* plane = out + b * count;
+        for (size_t i = 0; i < count; ++i) {
+            plane[i] = src[i * sizeof(float) + b];
+        }
+    }
+}
+
+void unshuffleBytes(const char* in, size_t count, float* values) {
+    char* dst = reinterpret_cast<char*>(values);
+    for (size_t b = 0; b < sizeof(float); ++b) {
+        const char* plane = in + b * count;
+        for (size_t i = 0; i < count; ++i) {
+            dst[i * sizeof(float) + b] = plane[i];
+        }
+    }
+}
+
+void compressPayload(BrickCompression compression, const std::vector<char>& raw, std::vector<char>& out) {
+    switch (compression) {
+        case BrickCompression::None:
+            out = raw;
+            return;
+#ifdef VDB_HAVE_LZ4
+        case BrickCompression::LZ4: {
+            out.resize(LZ4_compressBound(static_cast<int>(raw.size())));
+            int size = LZ4_compress_default(raw.data(), out.data(), static_cast<int>(raw.size()),
+                                            static_cast<int>(out.size()));
+            if (size <= 0) {
+                throw std::runtime_error("LZ4 compression failed");
+            }
+            out.resize(size);
+            return;
+        }
+#endif
+#ifdef VDB_HAVE_ZSTD
+        case BrickCompression::Zstd: {
+            out.resize(ZSTD_compressBound(raw.size()));
+            size_t size = ZSTD_compress(out.data(), out.size(), raw.data(), raw.size(), kZstdLevel);
+            if (ZSTD_isError(size)) {
+                throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(size));
+            }
+            out.resize(size);
+            return;
+        }
+#endif
+        default:
+            throw std::runtime_error(std::string("Brick compression not available: ") +
+                                     brickCompressionName(compression));
+    }
+}
+
+void decompressPayload(BrickCompression compression, const std::vector<char>& in, std::vector<char>& raw) {
+    switch (compression) {
+        case BrickCompression::None:
+            if (in.size() != raw.size()) {
+                throw std::runtime_error("Corrupt uncompressed brick");
+            }
+            std::memcpy(raw.data(), in.data(), raw.size());
+            return;
+#ifdef VDB_HAVE_LZ4
+        case BrickCompression::LZ4: {
+            int size = LZ4_decompress_safe(in.data(), raw.data(), static_cast<int>(in.size()),
+                                           static_cast<int>(raw.size()));
+            if (size != static_cast<int>(raw.size())) {
+                throw std::runtime_error("Corrupt LZ4 brick");
+            }
+            return;
+        }
+#endif
+#ifdef VDB_HAVE_ZSTD
+        case BrickCompression::Zstd: {
+            size_t size = ZSTD_decompress(raw.data(), raw.size(), in.data(), in.size());
+            if (ZSTD_isError(size) || size != raw.size()) {
+                throw std::runtime_error("Corrupt zstd brick");
+            }
+            return;
+        }
+#endif
+        default:
+            throw std::runtime_error(std::string("Brick compression not available: ") +
+                                     brickCompressionName(compression));
+    }
+}
+
+} // namespace
+
+BrickCompression parseBrickCompression(const std::string& name) {
+    if (name == "none") return BrickCompression::None;
+#ifdef VDB_HAVE_LZ4
+    if (name == "lz4") return BrickCompression::LZ4;
+#endif
+#ifdef VDB_HAVE_ZSTD
+    if (name == "zstd") return BrickCompression::Zstd;
+#endif
+    throw std::runtime_error("Unknown or unavailable brick compression: " + name);
+}
+
+const char* brickCompressionName(BrickCompression compression) {
+    switch (compression) {
+        case BrickCompression::None: return "none";
+        case BrickCompression::LZ4: return "lz4";
+        case BrickCompression::Zstd: return "zstd";
+    }
+    return "unknown";
+}
+
+BrickContainerWriter::BrickContainerWriter(int W, int H, int D, int brickSize, float background,
+                                           BrickCompression compression) {
+    header_.W = W;
+    header_.H = H;
+    header_.D = D;
+    header_.brickSize = brickSize;
+    header_.background = background;
+    header_.compression = compression;
+}
+
+void BrickContainerWriter::resize(size_t brickCount) {
+    entries_.resize(brickCount);
+    payloads_.resize(brickCount);
+    duplicateOf_.assign(brickCount, -1);
+    header_.brickCount = brickCount;
+}
+
+void BrickContainerWriter::setBrick(size_t index, const std::vector<float>& volumeData,
+                                    int x, int y, int z, float minVal, float maxVal) {
+    int W = header_.W, H = header_.H;
+    BrickEntry& entry = entries_[index];
+    entry.x = x;
+    entry.y = y;
+    entry.z = z;
+    entry.nx = std::min(header_.brickSize, W - x);
+    entry.ny = std::min(header_.brickSize, H - y);
+    entry.nz = std::min(header_.brickSize, header_.D - z);
+    entry.minVal = minVal;
+    entry.maxVal = maxVal;
+    entry.offset = 0;
+
+    size_t count = static_cast<size_t>(entry.nx) * entry.ny * entry.nz;
+    std::vector<float> values(count);
+    for (int k = 0; k < entry.nz; ++k) {
+        for (int j = 0; j < entry.ny; ++j) {
+            const float* row = &volumeData[static_cast<size_t>(z + k) * W * H + static_cast<size_t>(y + j) * W + x];
+            std::copy(row, row + entry.nx, values.begin() + (static_cast<size_t>(k) * entry.ny + j) * entry.nx);
+        }
+    }
+
+    std::vector<char> raw(count * sizeof(float));
+    shuffleBytes(values.data(), count, raw.data());
+    compressPayload(header_.compression, raw, payloads_[index]);
+
+    entry.rawSize = static_cast<uint32_t>(raw.size());
+    entry.compressedSize = static_cast<uint32_t>(payloads_[index].size());
+}
+
+void BrickContainerWriter::setDuplicate(size_t index, size_t source, int x, int y, int z) {
+    if (source >= index || duplicateOf_[source] >= 0) {
+        throw std::runtime_error("Duplicate brick must reference an earlier brick with its own payload");
+    }
+    BrickEntry& entry = entries_[index];
+    entry = entries_[source];
+    entry.x = x;
+    entry.y = y;
+    entry.z = z;
+    payloads_[index].clear();
+    duplicateOf_[index] = static_cast<int64_t>(source);
+}
+
+size_t BrickContainerWriter::byteSize() const {
+    size_t bytes = kHeaderBytes + kEntryBytes * entries_.size();
+    for (const auto& payload : payloads_) {
+        bytes += payload.size();
+    }
+    return bytes;
+}
+
+void BrickContainerWriter::write(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    std::vector<char> head;
+    head.insert(head.end(), kMagic, kMagic + sizeof(kMagic));
+    putPod<uint32_t>(head, kVersion);
+    putPod<int32_t>(head, header_.W);
+    putPod<int32_t>(head, header_.H);
+    putPod<int32_t>(head, header_.D);
+    putPod<int32_t>(head, header_.brickSize);
+    putPod<float>(head, header_.background);
+    putPod<uint8_t>(head, static_cast<uint8_t>(header_.compression));
+    head.resize(head.size() + 3, 0);
+    putPod<uint64_t>(head, entries_.size());
+
+    // Payloads follow the directory in brick order; duplicates reuse the
+    // offset of their source
+    uint64_t offset = kHeaderBytes + kEntryBytes * entries_.size();
+    std::vector<uint64_t> offsets(entries_.size());
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        const BrickEntry& e = entries_[i];
+        if (duplicateOf_[i] >= 0) {
+            offsets[i] = offsets[duplicateOf_[i]];
+        } else {
+            offsets[i] = offset;
+            offset += e.compressedSize;
+        }
+        putPod<int32_t>(head, e.x);
+        putPod<int32_t>(head, e.y);
+        putPod<int32_t>(head, e.z);
+        putPod<int32_t>(head, e.nx);
+        putPod<int32_t>(head, e.ny);
+        putPod<int32_t>(head, e.nz);
+        putPod<float>(head, e.minVal);
+        putPod<float>(head, e.maxVal);
+        putPod<uint64_t>(head, offsets[i]);
+        putPod<uint32_t>(head, e.compressedSize);
+        putPod<uint32_t>(head, e.rawSize);
+    }
+
+    out.write(head.data(), head.size());
+    for (const auto& payload : payloads_) {
+        out.write(payload.data(), payload.size());
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+BrickContainerReader::BrickContainerReader(const std::string& filename)
+    : file_(filename, std::ios::binary), bricksX_(0), bricksY_(0), bricksZ_(0) {
+    if (!file_) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    std::vector<char> head(kHeaderBytes);
+    file_.read(head.data(), head.size());
+    if (!file_ || std::memcmp(head.data(), kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a brick container: " + filename);
+    }
+
+    const char* src = head.data() + sizeof(kMagic);
+    if (getPod<uint32_t>(src) != kVersion) {
+        throw std::runtime_error("Unsupported brick container version: " + filename);
+    }
+    header_.W = getPod<int32_t>(src);
+    header_.H = getPod<int32_t>(src);
+    header_.D = getPod<int32_t>(src);
+    header_.brickSize = getPod<int32_t>(src);
+    header_.background = getPod<float>(src);
+    header_.compression = static_cast<BrickCompression>(getPod<uint8_t>(src));
+    src += 3;
+    header_.brickCount = getPod<uint64_t>(src);
+
+    if (header_.W <= 0 || header_.H <= 0 || header_.D <= 0 || header_.brickSize <= 0) {
+        throw std::runtime_error("Invalid brick container header: " + filename);
+    }
+
+    std::vector<char> directory(kEntryBytes * header_.brickCount);
+    file_.read(directory.data(), directory.size());
+    if (!file_) {
+        throw std::runtime_error("Truncated brick directory: " + filename);
+    }
+
+    int bs = header_.brickSize;
+    bricksX_ = (header_.W + bs - 1) / bs;
+    bricksY_ = (header_.H + bs - 1) / bs;
+    bricksZ_ = (header_.D + bs - 1) / bs;
+    brickLookup_.assign(static_cast<size_t>(bricksX_) * bricksY_ * bricksZ_, -1);
+
+    src = directory.data();
+    entries_.resize(header_.brickCount);
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        BrickEntry& e = entries_[i];
+        e.x = getPod<int32_t>(src);
+        e.y = getPod<int32_t>(src);
+        e.z = getPod<int32_t>(src);
+        e.nx = getPod<int32_t>(src);
+        e.ny = getPod<int32_t>(src);
+        e.nz = getPod<int32_t>(src);
+        e.minVal = getPod<float>(src);
+        e.maxVal = getPod<float>(src);
+        e.offset = getPod<uint64_t>(src);
+        e.compressedSize = getPod<uint32_t>(src);
+        e.rawSize = getPod<uint32_t>(src);
+
+        if (e.x < 0 || e.y < 0 || e.z < 0 || e.x % bs || e.y % bs || e.z % bs ||
+            e.x + e.nx > header_.W || e.y + e.ny > header_.H || e.z + e.nz > header_.D ||
+            e.rawSize != static_cast<uint64_t>(e.nx) * e.ny * e.nz * sizeof(float)) {
+            throw std::runtime_error("Invalid brick directory entry in: " + filename);
+        }
+        brickLookup_[(static_cast<size_t>(e.z / bs) * bricksY_ + e.y / bs) * bricksX_ + e.x / bs] = i;
+    }
+}
+
+void BrickContainerReader::readPayload(const BrickEntry& entry, std::vector<char>& payload) {
+    payload.resize(entry.compressedSize);
+    file_.clear();
+    file_.seekg(static_cast<std::streamoff>(entry.offset));
+    file_.read(payload.data(), payload.size());
+    if (!file_) {
+        throw std::runtime_error("Truncated brick payload");
+    }
+}
+
+void BrickContainerReader::decodePayload(const BrickEntry& entry, const std::vector<char>& payload,
+                                         float* values) const {
+    std::vector<char> raw(entry.rawSize);
+    decompressPayload(header_.compression, payload, raw);
+    unshuffleBytes(raw.data(), raw.size() / sizeof(float), values);
+}
+
+void BrickContainerReader::readBrick(size_t index, std::vector<float>& values) {
+    const BrickEntry& entry = entries_.at(index);
+    std::vector<char> payload;
+    readPayload(entry, payload);
+    values.resize(entry.rawSize / sizeof(float));
+    decodePayload(entry, payload, values.data());
+}
+
+size_t BrickContainerReader::readRegion(const int lo[3], const int hi[3], std::vector<float>& region) {
+    int dims[3] = {header_.W, header_.H, header_.D};
+    int rdims[3];
+    for (int a = 0; a < 3; ++a) {
+        if (hi[a] < lo[a]) {
+            throw std::runtime_error("Empty region");
+        }
+        rdims[a] = hi[a] - lo[a] + 1;
+    }
+    region.assign(static_cast<size_t>(rdims[0]) * rdims[1] * rdims[2], header_.background);
+
+    // Bricks intersecting the region, found through the brick grid lookup
+    int bs = header_.brickSize;
+    int b0[3], b1[3];
+    for (int a = 0; a < 3; ++a) {
+        if (hi[a] < 0 || lo[a] >= dims[a]) {
+            return 0;
+        }
+        b0[a] = std::max(lo[a], 0) / bs;
+        b1[a] = std::min(hi[a], dims[a] - 1) / bs;
+    }
+    std::vector<size_t> hits;
+    for (int bz = b0[2]; bz <= b1[2]; ++bz) {
+        for (int by = b0[1]; by <= b1[1]; ++by) {
+            for (int bx = b0[0]; bx <= b1[0]; ++bx) {
+                int64_t index = brickLookup_[(static_cast<size_t>(bz) * bricksY_ + by) * bricksX_ + bx];
+                if (index >= 0) {
+                    hits.push_back(static_cast<size_t>(index));
+                }
+            }
+        }
+    }
+
+    // Read payloads in file order, then decode them in parallel; bricks are
+    // disjoint so each writes its own part of the region
+    std::sort(hits.begin(), hits.end(), [this](size_t a, size_t b) {
+        return entries_[a].offset < entries_[b].offset;
+    });
+    std::vector<std::vector<char>> payloads(hits.size());
+    for (size_t i = 0; i < hits.size(); ++i) {
+        readPayload(entries_[hits[i]], payloads[i]);
+    }
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, hits.size()), [&](const tbb::blocked_range<size_t>& r) {
+        std::vector<float> values;
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const BrickEntry& e = entries_[hits[i]];
+            values.resize(e.rawSize / sizeof(float));
+            decodePayload(e, payloads[i], values.data());
+
+            int x0 = std::max(e.x, lo[0]), x1 = std::min(e.x + e.nx - 1, hi[0]);
+            int y0 = std::max(e.y, lo[1]), y1 = std::min(e.y + e.ny - 1, hi[1]);
+            int z0 = std::max(e.z, lo[2]), z1 = std::min(e.z + e.nz - 1, hi[2]);
+            for (int z = z0; z <= z1; ++z) {
+                for (int y = y0; y <= y1; ++y) {
+                    const float* src = &values[(static_cast<size_t>(z - e.z) * e.ny + (y - e.y)) * e.nx + (x0 - e.x)];
+                    float* dst = &region[(static_cast<size_t>(z - lo[2]) * rdims[1] + (y - lo[1])) * rdims[0] + (x0 - lo[0])];
+                    std::copy(src, src + (x1 - x0 + 1), dst);
+                }
+            }
+        }
+    });
+    return hits.size();
+}
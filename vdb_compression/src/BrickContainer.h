@@ -0,0 +1,95 @@
+#ifndef BRICKCONTAINER_H
+#define BRICKCONTAINER_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Random-access brick container (.vbc):
+//   header | brick directory | individually compressed brick payloads
+// Payloads are float bricks, byte-shuffled and compressed with LZ4 or zstd,
+// so a region read only touches the bricks that intersect it. Identical
+// bricks share one payload: their directory entries hold the same offset.
+
+enum class BrickCompression : uint8_t {
+    None = 0,
+    LZ4 = 1,
+    Zstd = 2
+};
+
+struct BrickContainerHeader {
+    int32_t W = 0, H = 0, D = 0;
+    int32_t brickSize = 0;
+    float background = 0.0f;
+    BrickCompression compression = BrickCompression::None;
+    uint64_t brickCount = 0;
+};
+
+struct BrickEntry {
+    int32_t x, y, z;        // brick origin in voxels
+    int32_t nx, ny, nz;     // brick extent
+    float minVal, maxVal;
+    uint64_t offset;        // payload position from the start of the file
+    uint32_t compressedSize;
+    uint32_t rawSize;
+};
+
+// Parses "lz4", "zstd" or "none"; throws if the codec was not compiled in
+BrickCompression parseBrickCompression(const std::string& name);
+const char* brickCompressionName(BrickCompression compression);
+
+class BrickContainerWriter {
+public:
+    BrickContainerWriter(int W, int H, int D, int brickSize, float background,
+                         BrickCompression compression);
+
+    void resize(size_t brickCount);
+
+    // Extracts, shuffles and compresses brick `index`. Calls for distinct
+    // indices may run concurrently.
+    void setBrick(size_t index, const std::vector<float>& volumeData,
+                  int x, int y, int z, float minVal, float maxVal);
+
+    // Makes brick `index` a copy of the already set brick `source`, stored
+    // once and referenced from both directory entries
+    void setDuplicate(size_t index, size_t source, int x, int y, int z);
+
+    size_t brickCount() const { return entries_.size(); }
+    size_t byteSize() const;
+    void write(const std::string& filename) const;
+
+private:
+    BrickContainerHeader header_;
+    std::vector<BrickEntry> entries_;
+    std::vector<std::vector<char>> payloads_;
+    std::vector<int64_t> duplicateOf_;  // source entry, or -1 for own payload
+};
+
+class BrickContainerReader {
+public:
+    explicit BrickContainerReader(const std::string& filename);
+
+    const BrickContainerHeader& header() const { return header_; }
+    const std::vector<BrickEntry>& entries() const { return entries_; }
+
+    // Decodes one brick into values[(z * ny + y) * nx + x]
+    void readBrick(size_t index, std::vector<float>& values);
+
+    // Decodes only the bricks intersecting the inclusive voxel box [lo, hi]
+    // into a dense region indexed relative to lo; uncovered voxels read as
+    // background. Returns the number of bricks decoded.
+    size_t readRegion(const int lo[3], const int hi[3], std::vector<float>& region);
+
+private:
+    void readPayload(const BrickEntry& entry, std::vector<char>& payload);
+    void decodePayload(const BrickEntry& entry, const std::vector<char>& payload, float* values) const;
+
+    std::ifstream file_;
+    BrickContainerHeader header_;
+    std::vector<BrickEntry> entries_;
+    int bricksX_, bricksY_, bricksZ_;
+    std::vector<int64_t> brickLookup_;  // brick grid cell -> entry index or -1
+};
+
+#endif
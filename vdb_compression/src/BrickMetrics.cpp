@@ -0,0 +1,288 @@
+#include "BrickMetrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// Bins of the per-brick value histogram used for the entropy
+const int kHistogramBins = 16;
+
+// Version 2: moments accumulated about a shift (version 1 variances lost
+// precision on offset data)
+const char kStatsMagic[4] = {'V', 'B', 'S', '2'};
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated brick statistics file");
+    }
+    return value;
+}
+
+class ClosestMetric : public BrickMetric {
+public:
+    const char* name() const override { return "closest"; }
+    bool needsFullStats() const override { return false; }
+    bool highestFirst() const override { return false; }
+    double score(const BrickStats& s, float background) const override {
+        return std::min(std::abs(s.minVal - background), std::abs(s.maxVal - background));
+    }
+};
+
+class FarthestMetric : public BrickMetric {
+public:
+    const char* name() const override { return "farthest"; }
+    bool needsFullStats() const override { return false; }
+    bool highestFirst() const override { return false; }
+    double score(const BrickStats& s, float background) const override {
+        return std::max(std::abs(s.minVal - background), std::abs(s.maxVal - background));
+    }
+};
+
+class MedianMetric : public BrickMetric {
+public:
+    const char* name() const override { return "median"; }
+    bool needsFullStats() const override { return false; }
+    bool highestFirst() const override { return false; }
+    double score(const BrickStats& s, float background) const override {
+        return std::abs((s.minVal + s.maxVal) / 2.0f - background);
+    }
+};
+
+// Offset of the mean from the background plus the spread around it, so a
+// noisy brick outranks a flat one with the same range
+class DeviationMetric : public BrickMetric {
+public:
+    const char* name() const override { return "deviation"; }
+    double score(const BrickStats& s, float background) const override {
+        return std::abs(s.mean - background) + std::sqrt(s.variance);
+    }
+};
+
+// Value range weighted by how many histogram levels are actually used
+class EntropyMetric : public BrickMetric {
+public:
+    const char* name() const override { return "entropy"; }
+    double score(const BrickStats& s, float) const override {
+        return (s.maxVal - s.minVal) * s.entropy / std::log2(static_cast<double>(kHistogramBins));
+    }
+};
+
+// RMS voxel-to-voxel change: large for edges, small for smooth ramps
+class GradientMetric : public BrickMetric {
+public:
+    const char* name() const override { return "gradient"; }
+    double score(const BrickStats& s, float) const override {
+        return std::sqrt(s.gradientEnergy);
+    }
+};
+
+// Contrast, spread and edges, discounted by the share of the brick that is
+// background anyway
+class CombinedMetric : public BrickMetric {
+public:
+    const char* name() const override { return "combined"; }
+    double score(const BrickStats& s, float background) const override {
+        return (1.0 - s.nearBackground) *
+               (std::abs(s.mean - background) + std::sqrt(s.variance) + std::sqrt(s.gradientEnergy));
+    }
+};
+
+} // namespace
+
+BrickStats computeBrickStats(
+    const float* volume,
+    int W, int H,
+    int x0, int y0, int z0,
+    int nx, int ny, int nz,
+    float background,
+    float nearTolerance,
+    bool full) {
+
+    BrickStats stats;
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    double sum = 0.0;
+    double sumSq = 0.0;
+    double gradient = 0.0;
+    size_t near = 0;
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+    // Moments are taken about the first voxel so that offset data (e.g.
+    // 60000 +/- 0.1) does not cancel away the variance
+    const double shift = volume[static_cast<size_t>(z0) * sliceVoxels + static_cast<size_t>(y0) * W + x0];
+
+    for (int k = 0; k < nz; ++k) {
+        for (int j = 0; j < ny; ++j) {
+            const float* row = &volume[static_cast<size_t>(z0 + k) * sliceVoxels + static_cast<size_t>(y0 + j) * W + x0];
+            for (int x = 0; x < nx; ++x) {
+                lo = std::min(lo, row[x]);
+                hi = std::max(hi, row[x]);
+            }
+            if (!full) continue;
+
+            double s = 0.0, ss = 0.0;
+            float g = 0.0f;
+            int n = 0;
+            for (int x = 0; x < nx; ++x) {
+                double v = row[x] - shift;
+                s += v;
+                ss += v * v;
+                n += std::abs(row[x] - background) <= nearTolerance;
+            }
+            for (int x = 0; x + 1 < nx; ++x) {
+                float d = row[x + 1] - row[x];
+                g += d * d;
+            }
+            if (j > 0) {
+                const float* up = row - W;
+                for (int x = 0; x < nx; ++x) {
+                    float d = row[x] - up[x];
+                    g += d * d;
+                }
+            }
+            if (k > 0) {
+                const float* back = row - sliceVoxels;
+                for (int x = 0; x < nx; ++x) {
+                    float d = row[x] - back[x];
+                    g += d * d;
+                }
+            }
+            sum += s;
+            sumSq += ss;
+            gradient += g;
+            near += n;
+        }
+    }
+    stats.minVal = lo;
+    stats.maxVal = hi;
+    if (!full) {
+        return stats;
+    }
+
+    double count = static_cast<double>(nx) * ny * nz;
+    double mean = sum / count;
+    stats.mean = static_cast<float>(shift + mean);
+    stats.variance = static_cast<float>(std::max(0.0, sumSq / count - mean * mean));
+    stats.gradientEnergy = static_cast<float>(gradient / count);
+    stats.nearBackground = static_cast<float>(near / count);
+
+    // A denormal range would overflow the bin scale
+    if (hi - lo > std::numeric_limits<float>::min()) {
+        int histogram[kHistogramBins] = {0};
+        float scale = kHistogramBins / (hi - lo);
+        for (int k = 0; k < nz; ++k) {
+            for (int j = 0; j < ny; ++j) {
+                const float* row = &volume[static_cast<size_t>(z0 + k) * sliceVoxels + static_cast<size_t>(y0 + j) * W + x0];
+                for (int x = 0; x < nx; ++x) {
+                    histogram[std::min(kHistogramBins - 1, static_cast<int>((row[x] - lo) * scale))]++;
+                }
+            }
+        }
+        double entropy = 0.0;
+        for (int b = 0; b < kHistogramBins; ++b) {
+            if (histogram[b] > 0) {
+                double p = histogram[b] / count;
+                entropy -= p * std::log2(p);
+            }
+        }
+        stats.entropy = static_cast<float>(entropy);
+    }
+    return stats;
+}
+
+void BrickStatsTable::write(const std::string& filename) const {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+    out.write(kStatsMagic, sizeof(kStatsMagic));
+    writePod<int32_t>(out, W);
+    writePod<int32_t>(out, H);
+    writePod<int32_t>(out, D);
+    writePod<int32_t>(out, brickSize);
+    writePod<uint8_t>(out, full ? 1 : 0);
+    writePod<float>(out, background);
+    writePod<float>(out, dataRange);
+    writePod<uint64_t>(out, fingerprint);
+    writePod<uint64_t>(out, stats.size());
+    for (const auto& s : stats) {
+        writePod<float>(out, s.minVal);
+        writePod<float>(out, s.maxVal);
+        writePod<float>(out, s.mean);
+        writePod<float>(out, s.variance);
+        writePod<float>(out, s.entropy);
+        writePod<float>(out, s.gradientEnergy);
+        writePod<float>(out, s.nearBackground);
+    }
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+BrickStatsTable BrickStatsTable::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+    char magic[sizeof(kStatsMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kStatsMagic, sizeof(kStatsMagic)) != 0) {
+        throw std::runtime_error("Not a brick statistics file: " + filename);
+    }
+
+    BrickStatsTable table;
+    table.W = readPod<int32_t>(in);
+    table.H = readPod<int32_t>(in);
+    table.D = readPod<int32_t>(in);
+    table.brickSize = readPod<int32_t>(in);
+    table.full = readPod<uint8_t>(in) != 0;
+    table.background = readPod<float>(in);
+    table.dataRange = readPod<float>(in);
+    table.fingerprint = readPod<uint64_t>(in);
+    uint64_t count = readPod<uint64_t>(in);
+    if (table.brickSize <= 0 || count != static_cast<uint64_t>((table.W + table.brickSize - 1) / table.brickSize) *
+                                         ((table.H + table.brickSize - 1) / table.brickSize) *
+                                         ((table.D + table.brickSize - 1) / table.brickSize)) {
+        throw std::runtime_error("Inconsistent brick statistics file: " + filename);
+    }
+    table.stats.resize(count);
+    for (auto& s : table.stats) {
+        s.minVal = readPod<float>(in);
+        s.maxVal = readPod<float>(in);
+        s.mean = readPod<float>(in);
+        s.variance = readPod<float>(in);
+        s.entropy = readPod<float>(in);
+        s.gradientEnergy = readPod<float>(in);
+        s.nearBackground = readPod<float>(in);
+    }
+    return table;
+}
+
+std::shared_ptr<const BrickMetric> BrickMetric::create(int metricType) {
+    switch (metricType) {
+        case 1: return std::make_shared<ClosestMetric>();
+        case 2: return std::make_shared<FarthestMetric>();
+        case 4: return std::make_shared<DeviationMetric>();
+        case 5: return std::make_shared<EntropyMetric>();
+        case 6: return std::make_shared<GradientMetric>();
+        case 7: return std::make_shared<CombinedMetric>();
+        case 3:
+        default:
+            return std::make_shared<MedianMetric>();
+    }
+}
+
+const char* BrickMetric::describe() {
+    return "1=closest, 2=farthest, 3=median (recommended), 4=deviation, 5=entropy, 6=gradient, 7=combined";
+}
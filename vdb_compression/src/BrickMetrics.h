@@ -0,0 +1,75 @@
+#ifndef BRICKMETRICS_H
+#define BRICKMETRICS_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Per-brick statistics and the ranking metrics built on them. The value
+// range is always computed; the rest only for metrics that ask for it.
+struct BrickStats {
+    float minVal = 0.0f;
+    float maxVal = 0.0f;
+    float mean = 0.0f;
+    float variance = 0.0f;
+    float entropy = 0.0f;          // bits, of a kHistogramBins histogram over [minVal, maxVal]
+    float gradientEnergy = 0.0f;   // mean squared forward difference over x, y and z
+    float nearBackground = 0.0f;   // fraction of voxels within the tolerance of the background
+};
+
+// Statistics of the nx * ny * nz brick at (x0, y0, z0) of a volume indexed
+// [(z * H + y) * W + x]. One sweep over the brick rows accumulates range,
+// moments, gradients and the background count with branch-free inner loops
+// the compiler vectorizes; the entropy histogram re-reads the brick while it
+// is still in cache. With full == false only the range is computed.
+BrickStats computeBrickStats(
+    const float* volume,
+    int W, int H,
+    int x0, int y0, int z0,
+    int nx, int ny, int nz,
+    float background,
+    float nearTolerance,
+    bool full);
+
+// Brick statistics of a whole volume, bricks in x-fastest order, with the
+// global background and data range they were computed against. This is the
+// sidecar cache of sweep mode; fingerprint identifies the voxel contents.
+struct BrickStatsTable {
+    int W = 0, H = 0, D = 0;
+    int brickSize = 0;
+    bool full = false;             // stats beyond minVal/maxVal are valid
+    float background = 0.0f;
+    float dataRange = 0.0f;
+    uint64_t fingerprint = 0;
+    std::vector<BrickStats> stats;
+
+    void write(const std::string& filename) const;
+    static BrickStatsTable read(const std::string& filename);
+};
+
+// Scores a brick against the background; bricks are ranked by this score
+// in the direction given by highestFirst()
+class BrickMetric {
+public:
+    virtual ~BrickMetric() {}
+
+    virtual const char* name() const = 0;
+    virtual double score(const BrickStats& stats, float background) const = 0;
+
+    // false when the score only uses minVal/maxVal (cheaper, streamable)
+    virtual bool needsFullStats() const { return true; }
+
+    // Selection direction in quality mode: false activates the lowest scores
+    // first (the original similarity ranking), true the highest, for scores
+    // that measure how much detail a brick holds. Error-bounded and
+    // target-size modes always start from the highest score.
+    virtual bool highestFirst() const { return true; }
+
+    // Built-in metrics: 1 = closest, 2 = farthest, 3 = median (range only),
+    // 4 = deviation, 5 = entropy, 6 = gradient, 7 = combined
+    static std::shared_ptr<const BrickMetric> create(int metricType);
+    static const char* describe();
+};
+
+#endif
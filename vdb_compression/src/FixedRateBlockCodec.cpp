@@ -0,0 +1,394 @@
+#include "FixedRateBlockCodec.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = {'V', 'F', 'R', '1'};
+
+const int kBlockValues = 64;
+const int kIntPrecision = 32;
+const int kExponentBits = 8;
+const int kExponentBias = 127;
+const uint32_t kNegabinaryMask = 0xaaaaaaaau;
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated fixed-rate stream");
+    }
+    return value;
+}
+
+// LSB-first bit stream over the zero-initialized words of one block
+class BitWriter {
+public:
+    explicit BitWriter(uint64_t* words) : words_(words), pos_(0) {}
+
+    void writeBits(uint64_t value, unsigned n) {
+        if (n == 0) {
+            return;
+        }
+        if (n < 64) {
+            value &= (uint64_t(1) << n) - 1;
+        }
+        size_t w = pos_ >> 6;
+        unsigned offset = pos_ & 63;
+        words_[w] |= value << offset;
+        if (offset + n > 64) {
+            words_[w + 1] |= value >> (64 - offset);
+        }
+        pos_ += n;
+    }
+
+    bool writeBit(bool bit) {
+        writeBits(bit ? 1 : 0, 1);
+        return bit;
+    }
+
+private:
+    uint64_t* words_;
+    size_t pos_;
+};
+
+class BitReader {
+public:
+    explicit BitReader(const uint64_t* words) : words_(words), pos_(0) {}
+
+    uint64_t readBits(unsigned n) {
+        if (n == 0) {
+            return 0;
+        }
+        size_t w = pos_ >> 6;
+        unsigned offset = pos_ & 63;
+        uint64_t value = words_[w] >> offset;
+        if (offset + n > 64) {
+            value |= words_[w + 1] << (64 - offset);
+        }
+        if (n < 64) {
+            value &= (uint64_t(1) << n) - 1;
+        }
+        pos_ += n;
+        return value;
+    }
+
+    bool readBit() { return readBits(1) != 0; }
+
+private:
+    const uint64_t* words_;
+    size_t pos_;
+};
+
+// Coefficient order by total sequency i + j + k, low frequencies first
+struct SequencyOrder {
+    int perm[kBlockValues];
+
+    SequencyOrder() {
+        for (int i = 0; i < kBlockValues; ++i) {
+            perm[i] = i;
+        }
+        std::stable_sort(perm, perm + kBlockValues, [](int a, int b) {
+            return (a & 3) + ((a >> 2) & 3) + (a >> 4) < (b & 3) + ((b >> 2) & 3) + (b >> 4);
+        });
+    }
+};
+
+const SequencyOrder kSequency;
+
+// Non-orthogonal 4-point lifting transform, applied to 16 lines at once so
+// each step is a straight loop over lanes
+void forwardLift(int32_t* x, int32_t* y, int32_t* z, int32_t* w) {
+    for (int l = 0; l < 16; ++l) {
+        x[l] += w[l]; x[l] >>= 1; w[l] -= x[l];
+        z[l] += y[l]; z[l] >>= 1; y[l] -= z[l];
+        x[l] += z[l]; x[l] >>= 1; z[l] -= x[l];
+        w[l] += y[l]; w[l] >>= 1; y[l] -= w[l];
+        w[l] += y[l] >> 1; y[l] -= w[l] >> 1;
+    }
+}
+
+void inverseLift(int32_t* x, int32_t* y, int32_t* z, int32_t* w) {
+    for (int l = 0; l < 16; ++l) {
+        y[l] += w[l] >> 1; w[l] -= y[l] >> 1;
+        y[l] += w[l]; w[l] *= 2; w[l] -= y[l];
+        z[l] += x[l]; x[l] *= 2; x[l] -= z[l];
+        y[l] += z[l]; z[l] *= 2; z[l] -= y[l];
+        w[l] += x[l]; x[l] *= 2; x[l] -= w[l];
+    }
+}
+
+// Applies the lift along one axis (stride 1, 4 or 16) of a 4^3 block
+void transformAxis(int32_t* block, int stride, bool inverse) {
+    int32_t taps[4][16];
+    int lane = 0;
+    for (int i = 0; i < kBlockValues; ++i) {
+        if ((i / stride) % 4 != 0) {
+            continue;
+        }
+        for (int t = 0; t < 4; ++t) {
+            taps[t][lane] = block[i + t * stride];
+        }
+        ++lane;
+    }
+    if (inverse) {
+        inverseLift(taps[0], taps[1], taps[2], taps[3]);
+    } else {
+        forwardLift(taps[0], taps[1], taps[2], taps[3]);
+    }
+    lane = 0;
+    for (int i = 0; i < kBlockValues; ++i) {
+        if ((i / stride) % 4 != 0) {
+            continue;
+        }
+        for (int t = 0; t < 4; ++t) {
+            block[i + t * stride] = taps[t][lane];
+        }
+        ++lane;
+    }
+}
+
+// Embedded coding of 64 negabinary integers, most significant bit plane
+// first, with unary group tests for coefficients not yet significant.
+// Stops after exactly maxbits bits or when all planes are written.
+void encodeInts(BitWriter& out, unsigned maxbits, const uint32_t* data) {
+    unsigned bits = maxbits;
+    unsigned n = 0;
+    for (unsigned k = kIntPrecision; bits && k-- > 0;) {
+        uint64_t x = 0;
+        for (unsigned i = 0; i < kBlockValues; ++i) {
+            x += static_cast<uint64_t>((data[i] >> k) & 1u) << i;
+        }
+        unsigned m = std::min(n, bits);
+        bits -= m;
+        out.writeBits(x, m);
+        x = (m < 64) ? x >> m : 0;
+        for (; n < kBlockValues && bits && (bits--, out.writeBit(x != 0)); x >>= 1, n++) {
+            for (; n < kBlockValues - 1 && bits && (bits--, !out.writeBit(x & 1)); x >>= 1, n++) {
+            }
+        }
+    }
+}
+
+void decodeInts(BitReader& in, unsigned maxbits, uint32_t* data) {
+    std::fill(data, data + kBlockValues, 0u);
+    unsigned bits = maxbits;
+    unsigned n = 0;
+    for (unsigned k = kIntPrecision; bits && k-- > 0;) {
+        unsigned m = std::min(n, bits);
+        bits -= m;
+        uint64_t x = in.readBits(m);
+        for (; n < kBlockValues && bits && (bits--, in.readBit()); x += uint64_t(1) << n++) {
+            for (; n < kBlockValues - 1 && bits && (bits--, !in.readBit()); n++) {
+            }
+        }
+        for (unsigned i = 0; x; ++i, x >>= 1) {
+            data[i] += static_cast<uint32_t>(x & 1u) << k;
+        }
+    }
+}
+
+void encodeBlock(const float* values, uint64_t* words, int rate) {
+    BitWriter out(words);
+    unsigned blockBits = static_cast<unsigned>(rate) * 64;
+
+    float maxAbs = 0.0f;
+    for (int i = 0; i < kBlockValues; ++i) {
+        maxAbs = std::max(maxAbs, std::abs(values[i]));
+    }
+    if (!(maxAbs > 0.0f) || !std::isfinite(maxAbs)) {
+        out.writeBit(false); // Zero block (non-finite blocks are zeroed too)
+        return;
+    }
+    int emax;
+    std::frexp(maxAbs, &emax);
+    emax = std::max(emax, 1 - kExponentBias);
+    out.writeBit(true);
+    out.writeBits(static_cast<uint64_t>(emax + kExponentBias), kExponentBits);
+
+    // Block-floating-point: |v| < 2^emax maps below 2^30
+    int32_t block[kBlockValues];
+    for (int i = 0; i < kBlockValues; ++i) {
+        block[i] = static_cast<int32_t>(std::ldexp(values[i], kIntPrecision - 2 - emax));
+    }
+    transformAxis(block, 1, false);
+    transformAxis(block, 4, false);
+    transformAxis(block, 16, false);
+
+    uint32_t coeffs[kBlockValues];
+    for (int i = 0; i < kBlockValues; ++i) {
+        coeffs[i] = (static_cast<uint32_t>(block[kSequency.perm[i]]) + kNegabinaryMask) ^ kNegabinaryMask;
+    }
+    encodeInts(out, blockBits - 1 - kExponentBits, coeffs);
+}
+
+void decodeBlockWords(const uint64_t* words, int rate, float* values) {
+    BitReader in(words);
+    unsigned blockBits = static_cast<unsigned>(rate) * 64;
+    if (!in.readBit()) {
+        std::fill(values, values + kBlockValues, 0.0f);
+        return;
+    }
+    int emax = static_cast<int>(in.readBits(kExponentBits)) - kExponentBias;
+
+    uint32_t coeffs[kBlockValues];
+    decodeInts(in, blockBits - 1 - kExponentBits, coeffs);
+    int32_t block[kBlockValues];
+    for (int i = 0; i < kBlockValues; ++i) {
+        block[kSequency.perm[i]] = static_cast<int32_t>((coeffs[i] ^ kNegabinaryMask) - kNegabinaryMask);
+    }
+    transformAxis(block, 16, true);
+    transformAxis(block, 4, true);
+    transformAxis(block, 1, true);
+
+    for (int i = 0; i < kBlockValues; ++i) {
+        values[i] = std::ldexp(static_cast<float>(block[i]), emax - (kIntPrecision - 2));
+    }
+}
+
+} // namespace
+
+size_t FixedRateVolume::byteSize() const {
+    return sizeof(kMagic) + 4 * sizeof(int32_t) + sizeof(uint64_t) + words.size() * sizeof(uint64_t);
+}
+
+FixedRateBlockCodec::FixedRateBlockCodec(int bitsPerVoxel) : rate_(bitsPerVoxel) {
+    if (rate_ < 1 || rate_ > 32) {
+        throw std::runtime_error("Fixed rate must be 1 to 32 bits per voxel");
+    }
+}
+
+FixedRateVolume FixedRateBlockCodec::encodeVolume(
+    const std::vector<float>& volumeData, int W, int H, int D) const {
+
+    FixedRateVolume volume;
+    volume.W = W;
+    volume.H = H;
+    volume.D = D;
+    volume.rate = rate_;
+    int bx = volume.blocksX(), by = volume.blocksY();
+    size_t blockCount = static_cast<size_t>(bx) * by * volume.blocksZ();
+    volume.words.assign(blockCount * rate_, 0);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blockCount),
+        [&](const tbb::blocked_range<size_t>& r) {
+            float values[kBlockValues];
+            for (size_t b = r.begin(); b != r.end(); ++b) {
+                int x0 = static_cast<int>(b % bx) * 4;
+                int y0 = static_cast<int>((b / bx) % by) * 4;
+                int z0 = static_cast<int>(b / (static_cast<size_t>(bx) * by)) * 4;
+
+                // Partial blocks at the volume edge repeat the last voxel
+                for (int k = 0; k < 4; ++k) {
+                    size_t zoff = static_cast<size_t>(std::min(z0 + k, D - 1)) * W * H;
+                    for (int j = 0; j < 4; ++j) {
+                        size_t yoff = zoff + static_cast<size_t>(std::min(y0 + j, H - 1)) * W;
+                        for (int i = 0; i < 4; ++i) {
+                            values[(k * 4 + j) * 4 + i] = volumeData[yoff + std::min(x0 + i, W - 1)];
+                        }
+                    }
+                }
+                encodeBlock(values, &volume.words[b * rate_], rate_);
+            }
+        });
+    return volume;
+}
+
+void FixedRateBlockCodec::decodeBlock(const FixedRateVolume& volume, int bx, int by, int bz, float out[64]) {
+    size_t b = (static_cast<size_t>(bz) * volume.blocksY() + by) * volume.blocksX() + bx;
+    decodeBlockWords(&volume.words[b * volume.rate], volume.rate, out);
+}
+
+float FixedRateBlockCodec::decodeVoxel(const FixedRateVolume& volume, int x, int y, int z) {
+    float values[kBlockValues];
+    decodeBlock(volume, x / 4, y / 4, z / 4, values);
+    return values[((z % 4) * 4 + (y % 4)) * 4 + (x % 4)];
+}
+
+void FixedRateBlockCodec::decodeVolume(const FixedRateVolume& volume, std::vector<float>& volumeData) {
+    int W = volume.W, H = volume.H, D = volume.D;
+    int bx = volume.blocksX(), by = volume.blocksY();
+    size_t blockCount = static_cast<size_t>(bx) * by * volume.blocksZ();
+    volumeData.resize(static_cast<size_t>(W) * H * D);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blockCount),
+        [&](const tbb::blocked_range<size_t>& r) {
+            float values[kBlockValues];
+            for (size_t b = r.begin(); b != r.end(); ++b) {
+                int x0 = static_cast<int>(b % bx) * 4;
+                int y0 = static_cast<int>((b / bx) % by) * 4;
+                int z0 = static_cast<int>(b / (static_cast<size_t>(bx) * by)) * 4;
+                decodeBlockWords(&volume.words[b * volume.rate], volume.rate, values);
+
+                int nx = std::min(4, W - x0), ny = std::min(4, H - y0), nz = std::min(4, D - z0);
+                for (int k = 0; k < nz; ++k) {
+                    for (int j = 0; j < ny; ++j) {
+                        std::copy(values + (k * 4 + j) * 4, values + (k * 4 + j) * 4 + nx,
+                                  volumeData.begin() + static_cast<size_t>(z0 + k) * W * H +
+                                  static_cast<size_t>(y0 + j) * W + x0);
+                    }
+                }
+            }
+        });
+}
+
+void FixedRateBlockCodec::write(const FixedRateVolume& volume, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writePod<int32_t>(out, volume.W);
+    writePod<int32_t>(out, volume.H);
+    writePod<int32_t>(out, volume.D);
+    writePod<int32_t>(out, volume.rate);
+    writePod<uint64_t>(out, volume.words.size());
+    out.write(reinterpret_cast<const char*>(volume.words.data()), volume.words.size() * sizeof(uint64_t));
+
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+FixedRateVolume FixedRateBlockCodec::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a fixed-rate stream: " + filename);
+    }
+
+    FixedRateVolume volume;
+    volume.W = readPod<int32_t>(in);
+    volume.H = readPod<int32_t>(in);
+    volume.D = readPod<int32_t>(in);
+    volume.rate = readPod<int32_t>(in);
+    uint64_t count = readPod<uint64_t>(in);
+    if (volume.W <= 0 || volume.H <= 0 || volume.D <= 0 || volume.rate < 1 || volume.rate > 32 ||
+        count != static_cast<uint64_t>(volume.blocksX()) * volume.blocksY() * volume.blocksZ() * volume.rate) {
+        throw std::runtime_error("Invalid fixed-rate header in: " + filename);
+    }
+
+    volume.words.resize(count);
+    in.read(reinterpret_cast<char*>(volume.words.data()), count * sizeof(uint64_t));
+    if (!in) {
+        throw std::runtime_error("Truncated fixed-rate stream: " + filename);
+    }
+    return volume;
+}
@@ -0,0 +1,46 @@
+#ifndef FIXEDRATEBLOCKCODEC_H
+#define FIXEDRATEBLOCKCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Fixed-rate 4^3 block transform codec in the style of ZFP. Each block is
+// converted to block-floating-point integers against its largest exponent,
+// decorrelated with an integer lifting transform along x, y and z,
+// reordered by sequency and coded as embedded bit planes truncated at
+// exactly 64 * rate bits. Every block therefore occupies `rate` 64-bit
+// words at a computable offset, so any voxel is decoded from one block.
+
+struct FixedRateVolume {
+    int W = 0, H = 0, D = 0;
+    int rate = 0;                 // bits per voxel, words per block
+    std::vector<uint64_t> words;  // blocks in x-fastest order
+
+    int blocksX() const { return (W + 3) / 4; }
+    int blocksY() const { return (H + 3) / 4; }
+    int blocksZ() const { return (D + 3) / 4; }
+    size_t byteSize() const;
+};
+
+class FixedRateBlockCodec {
+public:
+    explicit FixedRateBlockCodec(int bitsPerVoxel);
+
+    // Block-parallel encode/decode of a volume indexed [(z * H + y) * W + x]
+    FixedRateVolume encodeVolume(const std::vector<float>& volumeData, int W, int H, int D) const;
+    static void decodeVolume(const FixedRateVolume& volume, std::vector<float>& volumeData);
+
+    // Random access: decodes block (bx, by, bz) into out[(k * 4 + j) * 4 + i],
+    // or the single block holding voxel (x, y, z)
+    static void decodeBlock(const FixedRateVolume& volume, int bx, int by, int bz, float out[64]);
+    static float decodeVoxel(const FixedRateVolume& volume, int x, int y, int z);
+
+    static void write(const FixedRateVolume& volume, const std::string& filename);
+    static FixedRateVolume read(const std::string& filename);
+
+private:
+    int rate_;
+};
+
+#endif
@@ -0,0 +1,497 @@
+#include "LorenzoCodec.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <queue>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = {'V', 'L', 'Z', '1'};
+
+// Quantization codes are q + kRadius; code 0 marks an unpredictable voxel
+const int kRadius = 32768;
+const int kAlphabetSize = 2 * kRadius;
+
+// Longer codes are avoided by flattening the frequencies and rebuilding
+const int kMaxCodeLength = 31;
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated Lorenzo stream");
+    }
+    return value;
+}
+
+template <typename T>
+void appendPod(std::vector<uint8_t>& out, const T& value) {
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template <typename T>
+T takePod(const std::vector<uint8_t>& in, size_t& pos) {
+    if (pos + sizeof(T) > in.size()) {
+        throw std::runtime_error("Truncated Lorenzo chunk");
+    }
+    T value;
+    std::memcpy(&value, &in[pos], sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+// Reconstructed voxels of one chunk with a zero border at x, y, z = -1,
+// so the predictor needs no boundary checks
+class PaddedSlab {
+public:
+    PaddedSlab(int W, int H, int nz)
+        : pw_(W + 1), plane_(static_cast<size_t>(W + 1) * (H + 1)),
+          values_(plane_ * (nz + 1), 0.0f) {}
+
+    size_t index(int x, int y, int z) const {
+        return static_cast<size_t>(z + 1) * plane_ + static_cast<size_t>(y + 1) * pw_ + (x + 1);
+    }
+
+    // 3D Lorenzo prediction of the voxel at padded index i
+    float predict(size_t i) const {
+        const float* f = values_.data();
+        return f[i - 1] + f[i - pw_] + f[i - plane_]
+             - f[i - 1 - pw_] - f[i - 1 - plane_] - f[i - pw_ - plane_]
+             + f[i - 1 - pw_ - plane_];
+    }
+
+    float& operator[](size_t i) { return values_[i]; }
+
+private:
+    size_t pw_;
+    size_t plane_;
+    std::vector<float> values_;
+};
+
+inline float dequantize(float prediction, int q, float step) {
+    return prediction + static_cast<float>(q) * step;
+}
+
+// Huffman code lengths for the symbols with nonzero frequency
+void buildCodeLengths(std::vector<uint64_t> freq, std::vector<uint8_t>& lengths) {
+    std::vector<int> symbols;
+    for (int s = 0; s < kAlphabetSize; ++s) {
+        if (freq[s] > 0) {
+            symbols.push_back(s);
+        }
+    }
+    lengths.assign(kAlphabetSize, 0);
+    if (symbols.size() == 1) {
+        lengths[symbols[0]] = 1;
+        return;
+    }
+
+    for (;;) {
+        typedef std::pair<uint64_t, int> Node;
+        std::priority_queue<Node, std::vector<Node>, std::greater<Node>> heap;
+        std::vector<int> parent(symbols.size(), -1);
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            heap.push(Node(freq[symbols[i]], static_cast<int>(i)));
+        }
+        while (heap.size() > 1) {
+            Node a = heap.top(); heap.pop();
+            Node b = heap.top(); heap.pop();
+            int merged = static_cast<int>(parent.size());
+            parent.push_back(-1);
+            parent[a.second] = merged;
+            parent[b.second] = merged;
+            heap.push(Node(a.first + b.first, merged));
+        }
+
+        // Parents are created after their children, so depths resolve top-down
+        std::vector<int> depth(parent.size(), 0);
+        for (int n = static_cast<int>(parent.size()) - 2; n >= 0; --n) {
+            depth[n] = depth[parent[n]] + 1;
+        }
+        int maxDepth = 0;
+        for (size_t i = 0; i < symbols.size(); ++i) {
+            maxDepth = std::max(maxDepth, depth[i]);
+        }
+        if (maxDepth <= kMaxCodeLength) {
+            for (size_t i = 0; i < symbols.size(); ++i) {
+                lengths[symbols[i]] = static_cast<uint8_t>(depth[i]);
+            }
+            return;
+        }
+        for (int s : symbols) {
+            freq[s] = (freq[s] >> 1) | 1;
+        }
+    }
+}
+
+// Canonical Huffman code: symbols ordered by (length, symbol) get
+// consecutive codes within each length
+struct CanonicalCode {
+    std::vector<int> sorted;                     // symbols in canonical order
+    uint32_t count[kMaxCodeLength + 2] = {};
+    uint32_t first[kMaxCodeLength + 2] = {};     // first code of each length
+    uint32_t offset[kMaxCodeLength + 2] = {};    // index into sorted
+    int maxLength = 0;
+
+    explicit CanonicalCode(const std::vector<std::pair<int, int>>& symbolLengths) {
+        std::vector<std::pair<int, int>> order;
+        for (const auto& sl : symbolLengths) {
+            if (sl.second < 1 || sl.second > kMaxCodeLength) {
+                throw std::runtime_error("Invalid Huffman code length");
+            }
+            order.push_back(std::make_pair(sl.second, sl.first));
+            ++count[sl.second];
+            maxLength = std::max(maxLength, sl.second);
+        }
+        std::sort(order.begin(), order.end());
+        for (const auto& o : order) {
+            sorted.push_back(o.second);
+        }
+        uint32_t code = 0, index = 0;
+        for (int len = 1; len <= maxLength; ++len) {
+            first[len] = code;
+            offset[len] = index;
+            code = (code + count[len]) << 1;
+            index += count[len];
+        }
+    }
+
+    void assign(std::vector<uint32_t>& codes) const {
+        codes.assign(kAlphabetSize, 0);
+        for (int len = 1; len <= maxLength; ++len) {
+            for (uint32_t i = 0; i < count[len]; ++i) {
+                codes[sorted[offset[len] + i]] = first[len] + i;
+            }
+        }
+    }
+};
+
+class BitSink {
+public:
+    explicit BitSink(std::vector<uint8_t>& out) : out_(out), acc_(0), bits_(0) {}
+
+    void put(uint32_t code, int length) {
+        acc_ = (acc_ << length) | code;
+        bits_ += length;
+        while (bits_ >= 8) {
+            bits_ -= 8;
+            out_.push_back(static_cast<uint8_t>(acc_ >> bits_));
+        }
+    }
+
+    void flush() {
+        if (bits_ > 0) {
+            out_.push_back(static_cast<uint8_t>(acc_ << (8 - bits_)));
+            bits_ = 0;
+        }
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    uint64_t acc_;
+    int bits_;
+};
+
+class BitSource {
+public:
+    BitSource(const uint8_t* data, size_t bytes) : data_(data), bits_(bytes * 8), pos_(0) {}
+
+    uint32_t bit() {
+        if (pos_ >= bits_) {
+            throw std::runtime_error("Truncated Lorenzo bitstream");
+        }
+        uint32_t b = (data_[pos_ >> 3] >> (7 - (pos_ & 7))) & 1u;
+        ++pos_;
+        return b;
+    }
+
+private:
+    const uint8_t* data_;
+    size_t bits_;
+    size_t pos_;
+};
+
+int decodeSymbol(const CanonicalCode& code, BitSource& in) {
+    uint32_t value = 0;
+    for (int len = 1; len <= code.maxLength; ++len) {
+        value = (value << 1) | in.bit();
+        if (value - code.first[len] < code.count[len]) {
+            return code.sorted[code.offset[len] + value - code.first[len]];
+        }
+    }
+    throw std::runtime_error("Invalid Huffman code in Lorenzo chunk");
+}
+
+// Chunk payload: code table | Huffman bitstream | unpredictable values
+void encodeChunk(const float* data, int W, int H, int nz, float errorBound, std::vector<uint8_t>& payload) {
+    float step = 2.0f * errorBound;
+    float invStep = 1.0f / step;
+    size_t voxels = static_cast<size_t>(W) * H * nz;
+
+    PaddedSlab rec(W, H, nz);
+    std::vector<uint16_t> codes(voxels);
+    std::vector<float> unpredictable;
+    size_t i = 0;
+    for (int z = 0; z < nz; ++z) {
+        for (int y = 0; y < H; ++y) {
+            size_t p = rec.index(0, y, z);
+            for (int x = 0; x < W; ++x, ++i, ++p) {
+                float v = data[i];
+                float prediction = rec.predict(p);
+                float scaled = (v - prediction) * invStep;
+                if (std::abs(scaled) < kRadius - 1) {
+                    int q = static_cast<int>(std::lround(scaled));
+                    float r = dequantize(prediction, q, step);
+                    if (std::abs(r - v) <= errorBound) {
+                        codes[i] = static_cast<uint16_t>(q + kRadius);
+                        rec[p] = r;
+                        continue;
+                    }
+                }
+                codes[i] = 0;
+                unpredictable.push_back(v);
+                rec[p] = v;
+            }
+        }
+    }
+
+    std::vector<uint64_t> freq(kAlphabetSize, 0);
+    for (uint16_t c : codes) {
+        ++freq[c];
+    }
+    std::vector<uint8_t> lengths;
+    buildCodeLengths(freq, lengths);
+
+    std::vector<std::pair<int, int>> symbolLengths;
+    for (int s = 0; s < kAlphabetSize; ++s) {
+        if (lengths[s] > 0) {
+            symbolLengths.push_back(std::make_pair(s, lengths[s]));
+        }
+    }
+    CanonicalCode canonical(symbolLengths);
+    std::vector<uint32_t> table;
+    canonical.assign(table);
+
+    payload.clear();
+    appendPod<uint32_t>(payload, static_cast<uint32_t>(symbolLengths.size()));
+    for (const auto& sl : symbolLengths) {
+        appendPod<uint16_t>(payload, static_cast<uint16_t>(sl.first));
+        appendPod<uint8_t>(payload, static_cast<uint8_t>(sl.second));
+    }
+
+    std::vector<uint8_t> bits;
+    bits.reserve(voxels / 4);
+    BitSink sink(bits);
+    for (uint16_t c : codes) {
+        sink.put(table[c], lengths[c]);
+    }
+    sink.flush();
+    appendPod<uint64_t>(payload, bits.size());
+    payload.insert(payload.end(), bits.begin(), bits.end());
+
+    appendPod<uint64_t>(payload, unpredictable.size());
+    const uint8_t* raw = reinterpret_cast<const uint8_t*>(unpredictable.data());
+    payload.insert(payload.end(), raw, raw + unpredictable.size() * sizeof(float));
+}
+
+void decodeChunk(const std::vector<uint8_t>& payload, int W, int H, int nz, float errorBound, float* out) {
+    float step = 2.0f * errorBound;
+    size_t pos = 0;
+
+    uint32_t symbolCount = takePod<uint32_t>(payload, pos);
+    std::vector<std::pair<int, int>> symbolLengths(symbolCount);
+    for (auto& sl : symbolLengths) {
+        sl.first = takePod<uint16_t>(payload, pos);
+        sl.second = takePod<uint8_t>(payload, pos);
+    }
+    CanonicalCode canonical(symbolLengths);
+
+    uint64_t bitBytes = takePod<uint64_t>(payload, pos);
+    if (pos + bitBytes > payload.size()) {
+        throw std::runtime_error("Truncated Lorenzo chunk");
+    }
+    BitSource in(payload.data() + pos, bitBytes);
+    pos += bitBytes;
+
+    uint64_t rawCount = takePod<uint64_t>(payload, pos);
+    if (pos + rawCount * sizeof(float) > payload.size()) {
+        throw std::runtime_error("Truncated Lorenzo chunk");
+    }
+    const uint8_t* raw = payload.data() + pos;
+    uint64_t rawIndex = 0;
+
+    PaddedSlab rec(W, H, nz);
+    size_t i = 0;
+    for (int z = 0; z < nz; ++z) {
+        for (int y = 0; y < H; ++y) {
+            size_t p = rec.index(0, y, z);
+            for (int x = 0; x < W; ++x, ++i, ++p) {
+                int code = decodeSymbol(canonical, in);
+                float v;
+                if (code == 0) {
+                    if (rawIndex >= rawCount) {
+                        throw std::runtime_error("Missing unpredictable value in Lorenzo chunk");
+                    }
+                    std::memcpy(&v, raw + rawIndex++ * sizeof(float), sizeof(float));
+                } else {
+                    v = dequantize(rec.predict(p), code - kRadius, step);
+                }
+                rec[p] = v;
+                out[i] = v;
+            }
+        }
+    }
+}
+
+} // namespace
+
+size_t LorenzoVolume::byteSize() const {
+    size_t bytes = sizeof(kMagic) + 3 * sizeof(int32_t) + sizeof(float) + sizeof(uint64_t);
+    for (const auto& chunk : chunks) {
+        bytes += 2 * sizeof(int32_t) + sizeof(uint64_t) + chunk.payload.size();
+    }
+    return bytes;
+}
+
+LorenzoCodec::LorenzoCodec(float errorBound, int chunkSlices)
+    : errorBound_(errorBound), chunkSlices_(chunkSlices) {
+    if (!(errorBound_ > 0.0f)) {
+        throw std::runtime_error("Lorenzo codec needs a positive error bound");
+    }
+    if (chunkSlices_ < 1) {
+        throw std::runtime_error("Lorenzo chunks need at least one slice");
+    }
+}
+
+LorenzoVolume LorenzoCodec::encodeVolume(const std::vector<float>& volumeData, int W, int H, int D) const {
+    LorenzoVolume volume;
+    volume.W = W;
+    volume.H = H;
+    volume.D = D;
+    volume.errorBound = errorBound_;
+
+    int chunkCount = (D + chunkSlices_ - 1) / chunkSlices_;
+    volume.chunks.resize(chunkCount);
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+
+    tbb::parallel_for(tbb::blocked_range<int>(0, chunkCount, 1),
+        [&](const tbb::blocked_range<int>& r) {
+            for (int c = r.begin(); c != r.end(); ++c) {
+                LorenzoChunk& chunk = volume.chunks[c];
+                chunk.z0 = c * chunkSlices_;
+                chunk.nz = std::min(chunkSlices_, D - chunk.z0);
+                encodeChunk(&volumeData[chunk.z0 * sliceVoxels], W, H, chunk.nz, errorBound_, chunk.payload);
+            }
+        });
+    return volume;
+}
+
+void LorenzoCodec::decodeVolume(const LorenzoVolume& volume, std::vector<float>& volumeData) {
+    size_t sliceVoxels = static_cast<size_t>(volume.W) * volume.H;
+    volumeData.resize(sliceVoxels * volume.D);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, volume.chunks.size(), 1),
+        [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t c = r.begin(); c != r.end(); ++c) {
+                const LorenzoChunk& chunk = volume.chunks[c];
+                decodeChunk(chunk.payload, volume.W, volume.H, chunk.nz, volume.errorBound,
+                            &volumeData[chunk.z0 * sliceVoxels]);
+            }
+        });
+}
+
+LorenzoVerifyResult LorenzoCodec::verify(const std::vector<float>& original,
+                                         const std::vector<float>& decoded,
+                                         float errorBound) {
+    if (original.size() != decoded.size()) {
+        throw std::runtime_error("Lorenzo verify: volume sizes differ");
+    }
+    LorenzoVerifyResult result;
+    for (size_t i = 0; i < original.size(); ++i) {
+        float error = std::abs(decoded[i] - original[i]);
+        bool exact = decoded[i] == original[i] ||
+                     (std::isnan(decoded[i]) && std::isnan(original[i]));
+        if (exact) {
+            continue;
+        }
+        if (!(error <= errorBound)) {
+            if (result.violations++ == 0) {
+                result.firstViolation = i;
+            }
+        }
+        if (error > result.maxError) {
+            result.maxError = error;
+        }
+    }
+    return result;
+}
+
+void LorenzoCodec::write(const LorenzoVolume& volume, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writePod<int32_t>(out, volume.W);
+    writePod<int32_t>(out, volume.H);
+    writePod<int32_t>(out, volume.D);
+    writePod<float>(out, volume.errorBound);
+    writePod<uint64_t>(out, volume.chunks.size());
+    for (const auto& chunk : volume.chunks) {
+        writePod<int32_t>(out, chunk.z0);
+        writePod<int32_t>(out, chunk.nz);
+        writePod<uint64_t>(out, chunk.payload.size());
+        out.write(reinterpret_cast<const char*>(chunk.payload.data()), chunk.payload.size());
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+LorenzoVolume LorenzoCodec::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a Lorenzo stream: " + filename);
+    }
+
+    LorenzoVolume volume;
+    volume.W = readPod<int32_t>(in);
+    volume.H = readPod<int32_t>(in);
+    volume.D = readPod<int32_t>(in);
+    volume.errorBound = readPod<float>(in);
+    uint64_t count = readPod<uint64_t>(in);
+
+    volume.chunks.resize(count);
+    for (auto& chunk : volume.chunks) {
+        chunk.z0 = readPod<int32_t>(in);
+        chunk.nz = readPod<int32_t>(in);
+        if (chunk.z0 < 0 || chunk.nz <= 0 || chunk.z0 + chunk.nz > volume.D) {
+            throw std::runtime_error("Chunk outside volume in: " + filename);
+        }
+        chunk.payload.resize(readPod<uint64_t>(in));
+        in.read(reinterpret_cast<char*>(chunk.payload.data()), chunk.payload.size());
+        if (!in) {
+            throw std::runtime_error("Truncated Lorenzo stream: " + filename);
+        }
+    }
+    return volume;
+}
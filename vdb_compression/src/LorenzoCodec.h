@@ -0,0 +1,57 @@
+#ifndef LORENZOCODEC_H
+#define LORENZOCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Error-bounded prediction codec in the style of SZ. Each voxel is
+// predicted by the 3D Lorenzo predictor from already reconstructed
+// neighbours, the residual is quantized linearly in steps of 2 * errorBound
+// and the quantization codes are Huffman coded. Residuals outside the code
+// range (or that would break the bound through float rounding) are stored
+// verbatim, so every voxel is reconstructed within errorBound.
+//
+// The volume is split into Z-slab chunks that predict only from their own
+// voxels, so chunks compress and decompress independently in parallel.
+
+struct LorenzoChunk {
+    int z0, nz;
+    std::vector<uint8_t> payload;
+};
+
+struct LorenzoVolume {
+    int W = 0, H = 0, D = 0;
+    float errorBound = 0.0f;
+    std::vector<LorenzoChunk> chunks;
+
+    size_t byteSize() const;
+};
+
+// Outcome of checking a reconstruction against the bound on every voxel
+struct LorenzoVerifyResult {
+    size_t violations = 0;
+    float maxError = 0.0f;
+    size_t firstViolation = 0;
+};
+
+class LorenzoCodec {
+public:
+    LorenzoCodec(float errorBound, int chunkSlices = 16);
+
+    LorenzoVolume encodeVolume(const std::vector<float>& volumeData, int W, int H, int D) const;
+    static void decodeVolume(const LorenzoVolume& volume, std::vector<float>& volumeData);
+
+    static LorenzoVerifyResult verify(const std::vector<float>& original,
+                                      const std::vector<float>& decoded,
+                                      float errorBound);
+
+    static void write(const LorenzoVolume& volume, const std::string& filename);
+    static LorenzoVolume read(const std::string& filename);
+
+private:
+    float errorBound_;
+    int chunkSlices_;
+};
+
+#endif
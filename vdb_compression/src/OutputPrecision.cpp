@@ -0,0 +1,167 @@
+#include "OutputPrecision.h"
+#include <openvdb/tools/ValueTransformer.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const char* kScaleMeta = "value_scale";
+const char* kOffsetMeta = "value_offset";
+const char* kTypeMeta = "value_type";
+
+// Maps physical values to codes of a narrow grid; tiles stay tiles
+template <typename OutGridT>
+struct EncodeOp {
+    typedef typename OutGridT::ValueType Code;
+    float offset;
+    float invScale;
+    float maxCode;
+
+    void operator()(const openvdb::FloatGrid::ValueOnCIter& it, typename OutGridT::Accessor& acc) const {
+        Code code = encode(*it);
+        if (it.isVoxelValue()) {
+            acc.setValue(it.getCoord(), code);
+        } else {
+            openvdb::CoordBBox bbox;
+            it.getBoundingBox(bbox);
+            acc.tree().fill(bbox, code, true);
+        }
+    }
+
+    Code encode(float v) const {
+        float code = std::round((v - offset) * invScale);
+        return static_cast<Code>(std::max(0.0f, std::min(maxCode, code)));
+    }
+};
+
+template <typename InGridT>
+struct DecodeOp {
+    float offset;
+    float scale;
+
+    void operator()(const typename InGridT::ValueOnCIter& it, openvdb::FloatGrid::Accessor& acc) const {
+        float value = offset + static_cast<float>(*it) * scale;
+        if (it.isVoxelValue()) {
+            acc.setValue(it.getCoord(), value);
+        } else {
+            openvdb::CoordBBox bbox;
+            it.getBoundingBox(bbox);
+            acc.tree().fill(bbox, value, true);
+        }
+    }
+};
+
+void copyGridSettings(const openvdb::GridBase& from, openvdb::GridBase& to) {
+    to.setName(from.getName());
+    to.setGridClass(from.getGridClass());
+    to.setTransform(from.transform().copy());
+    for (auto it = from.beginMeta(); it != from.endMeta(); ++it) {
+        to.insertMeta(it->first, *it->second);
+    }
+}
+
+template <typename OutGridT>
+openvdb::GridBase::Ptr quantizeGrid(openvdb::FloatGrid::Ptr grid, const char* typeName) {
+    // Code range spans the active values and the background
+    float lo = grid->background();
+    float hi = grid->background();
+    for (auto it = grid->cbeginValueOn(); it; ++it) {
+        lo = std::min(lo, *it);
+        hi = std::max(hi, *it);
+    }
+
+    float maxCode = static_cast<float>(std::numeric_limits<typename OutGridT::ValueType>::max());
+    EncodeOp<OutGridT> op;
+    op.offset = lo;
+    op.invScale = (hi > lo) ? maxCode / (hi - lo) : 0.0f;
+    op.maxCode = maxCode;
+    float scale = (hi > lo) ? (hi - lo) / maxCode : 0.0f;
+
+    typename OutGridT::Ptr out = OutGridT::create(op.encode(grid->background()));
+    copyGridSettings(*grid, *out);
+    openvdb::tools::transformValues(grid->cbeginValueOn(), *out, op);
+    out->insertMeta(kScaleMeta, openvdb::FloatMetadata(scale));
+    out->insertMeta(kOffsetMeta, openvdb::FloatMetadata(lo));
+    out->insertMeta(kTypeMeta, openvdb::StringMetadata(typeName));
+
+    std::cout << "Output " << typeName << " grid: scale " << scale << ", offset " << lo
+              << " (max quantization error " << scale / 2 << ")" << std::endl;
+    return out;
+}
+
+template <typename InGridT>
+openvdb::FloatGrid::Ptr dequantizeGrid(typename InGridT::Ptr grid) {
+    DecodeOp<InGridT> op;
+    op.scale = grid->template metaValue<float>(kScaleMeta);
+    op.offset = grid->template metaValue<float>(kOffsetMeta);
+
+    openvdb::FloatGrid::Ptr out = openvdb::FloatGrid::create(
+        op.offset + static_cast<float>(grid->background()) * op.scale);
+    copyGridSettings(*grid, *out);
+    out->removeMeta(kScaleMeta);
+    out->removeMeta(kOffsetMeta);
+    out->removeMeta(kTypeMeta);
+    openvdb::tools::transformValues(grid->cbeginValueOn(), *out, op);
+    return out;
+}
+
+} // namespace
+
+OutputType parseOutputType(const std::string& name) {
+    if (name == "float") return OutputType::Float;
+    if (name == "half") return OutputType::Half;
+    if (name == "uint8") return OutputType::UInt8;
+    if (name == "uint16") return OutputType::UInt16;
+    throw std::runtime_error("Unknown output type: " + name + " (expected float, half, uint8 or uint16)");
+}
+
+const char* outputTypeName(OutputType type) {
+    switch (type) {
+        case OutputType::Float: return "float";
+        case OutputType::Half: return "half";
+        case OutputType::UInt8: return "uint8";
+        case OutputType::UInt16: return "uint16";
+    }
+    return "unknown";
+}
+
+void registerOutputGridTypes() {
+    if (!UInt8Grid::isRegistered()) {
+        UInt8Grid::registerGrid();
+    }
+    if (!UInt16Grid::isRegistered()) {
+        UInt16Grid::registerGrid();
+    }
+}
+
+openvdb::GridBase::Ptr convertOutputGrid(openvdb::FloatGrid::Ptr grid, OutputType type) {
+    switch (type) {
+        case OutputType::Float:
+            grid->setSaveFloatAsHalf(false);
+            return grid;
+        case OutputType::Half:
+            grid->setSaveFloatAsHalf(true);
+            return grid;
+        case OutputType::UInt8:
+            return quantizeGrid<UInt8Grid>(grid, "uint8");
+        case OutputType::UInt16:
+            return quantizeGrid<UInt16Grid>(grid, "uint16");
+    }
+    return grid;
+}
+
+openvdb::FloatGrid::Ptr restorePhysicalGrid(openvdb::GridBase::Ptr grid) {
+    if (auto floatGrid = openvdb::gridPtrCast<openvdb::FloatGrid>(grid)) {
+        return floatGrid;
+    }
+    if (auto narrow = openvdb::gridPtrCast<UInt8Grid>(grid)) {
+        return dequantizeGrid<UInt8Grid>(narrow);
+    }
+    if (auto narrow = openvdb::gridPtrCast<UInt16Grid>(grid)) {
+        return dequantizeGrid<UInt16Grid>(narrow);
+    }
+    return openvdb::FloatGrid::Ptr();
+}
@@ -0,0 +1,37 @@
+#ifndef OUTPUTPRECISION_H
+#define OUTPUTPRECISION_H
+
+#include <openvdb/openvdb.h>
+#include <string>
+
+// Storage type of the written grid. Half keeps the FloatGrid and sets
+// OpenVDB's save-as-half flag; UInt8/UInt16 write a narrow grid of codes
+// with physical value = value_offset + code * value_scale (grid metadata).
+enum class OutputType {
+    Float,
+    Half,
+    UInt8,
+    UInt16
+};
+
+using UInt8Tree = openvdb::tree::Tree4<uint8_t, 5, 4, 3>::Type;
+using UInt16Tree = openvdb::tree::Tree4<uint16_t, 5, 4, 3>::Type;
+using UInt8Grid = openvdb::Grid<UInt8Tree>;
+using UInt16Grid = openvdb::Grid<UInt16Tree>;
+
+OutputType parseOutputType(const std::string& name);
+const char* outputTypeName(OutputType type);
+
+// Registers the narrow grid types with OpenVDB; call after openvdb::initialize()
+// and before reading files that may contain them
+void registerOutputGridTypes();
+
+// Converts a compressed grid to the requested storage type with the same
+// topology (active voxels and tiles), transform, name and metadata
+openvdb::GridBase::Ptr convertOutputGrid(openvdb::FloatGrid::Ptr grid, OutputType type);
+
+// Reader helper: returns a FloatGrid of physical values for any grid written
+// by convertOutputGrid (float and half grids are returned as is), or null
+openvdb::FloatGrid::Ptr restorePhysicalGrid(openvdb::GridBase::Ptr grid);
+
+#endif
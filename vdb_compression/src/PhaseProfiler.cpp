@@ -0,0 +1,230 @@
+#include "PhaseProfiler.h"
+#include <sys/resource.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+namespace {
+
+std::atomic<uint64_t> gAllocations(0);
+std::atomic<uint64_t> gAllocatedBytes(0);
+std::atomic<bool> gCountingAllocations(false);
+
+size_t readStatusField(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::string(field).size();
+    while (std::getline(status, line)) {
+        if (line.compare(0, length, field) == 0) {
+            return static_cast<size_t>(std::atoll(line.c_str() + length)) * 1024;
+        }
+    }
+    return 0;
+}
+
+// Phase names are identifiers chosen in code, but escape quotes anyway
+std::string jsonString(const std::string& text) {
+    std::string escaped = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') escaped += '\\';
+        escaped += c;
+    }
+    return escaped + "\"";
+}
+
+} // namespace
+
+PhaseProfiler::Scope::Scope(PhaseProfiler* profiler, const char* name)
+    : profiler_(profiler), index_(0),
+      allocations_(allocationCount()), allocatedBytes_(allocatedBytes()) {
+    if (profiler_) {
+        index_ = profiler_->begin(name);
+    }
+}
+
+PhaseProfiler::Scope::~Scope() {
+    close();
+}
+
+void PhaseProfiler::Scope::close() {
+    if (profiler_) {
+        profiler_->end(index_, allocationCount() - allocations_, allocatedBytes() - allocatedBytes_);
+        profiler_ = nullptr;
+    }
+}
+
+PhaseProfiler::PhaseProfiler()
+    : origin_(std::chrono::steady_clock::now()), depth_(0), sampling_(false) {
+}
+
+PhaseProfiler::~PhaseProfiler() {
+    stopSampling();
+}
+
+void PhaseProfiler::startSampling(int intervalMs) {
+    if (sampling_.exchange(true)) {
+        return;
+    }
+    samples_.reserve(4096);
+    sampler_ = std::thread([this, intervalMs] {
+        while (sampling_.load()) {
+            size_t rss = currentRSS();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                samples_.push_back(std::make_pair(now(), rss));
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+        }
+    });
+}
+
+void PhaseProfiler::stopSampling() {
+    if (sampling_.exchange(false) && sampler_.joinable()) {
+        sampler_.join();
+    }
+}
+
+double PhaseProfiler::now() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - origin_).count();
+}
+
+size_t PhaseProfiler::begin(const char* name) {
+    Phase phase;
+    phase.name = name;
+    phase.rssStart = currentRSS();
+    std::lock_guard<std::mutex> lock(mutex_);
+    phase.depth = depth_++;
+    phase.startSeconds = now();
+    phases_.push_back(phase);
+    return phases_.size() - 1;
+}
+
+void PhaseProfiler::end(size_t index, uint64_t allocations, uint64_t allocatedBytes) {
+    size_t rss = currentRSS();
+    std::lock_guard<std::mutex> lock(mutex_);
+    Phase& phase = phases_[index];
+    phase.endSeconds = now();
+    phase.rssEnd = rss;
+    phase.rssPeak = std::max(phase.rssStart, rss);
+    for (const auto& sample : samples_) {
+        if (sample.first >= phase.startSeconds && sample.first <= phase.endSeconds) {
+            phase.rssPeak = std::max(phase.rssPeak, sample.second);
+        }
+    }
+    phase.allocations = allocations;
+    phase.allocatedBytes = allocatedBytes;
+    --depth_;
+}
+
+void PhaseProfiler::printSummary(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << "=== Phase Profile ===" << std::endl;
+    for (const auto& phase : phases_) {
+        out << std::string(2 * phase.depth, ' ') << std::left << std::setw(24 - 2 * phase.depth) << phase.name
+            << std::right << std::fixed << std::setprecision(3) << std::setw(10)
+            << phase.endSeconds - phase.startSeconds << " s  RSS " << phase.rssEnd / (1024 * 1024)
+            << " MB (peak " << phase.rssPeak / (1024 * 1024) << " MB)";
+        if (countsAllocations()) {
+            out << "  " << phase.allocations << " allocations";
+        }
+        out << std::defaultfloat << std::endl;
+    }
+    out << "Process peak RSS: " << peakRSS() / (1024 * 1024) << " MB" << std::endl;
+}
+
+void PhaseProfiler::writeReport(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    out << std::setprecision(9);
+    out << "{" << std::endl;
+    out << "  \"peak_rss_bytes\": " << peakRSS() << "," << std::endl;
+    out << "  \"allocations_counted\": " << (countsAllocations() ? "true" : "false") << "," << std::endl;
+    out << "  \"phases\": [" << std::endl;
+    for (size_t i = 0; i < phases_.size(); ++i) {
+        const Phase& phase = phases_[i];
+        out << "    {\"name\": " << jsonString(phase.name) << ", \"depth\": " << phase.depth
+            << ", \"start_s\": " << phase.startSeconds << ", \"duration_s\": " << phase.endSeconds - phase.startSeconds
+            << ", \"rss_start_bytes\": " << phase.rssStart << ", \"rss_end_bytes\": " << phase.rssEnd
+            << ", \"rss_peak_bytes\": " << phase.rssPeak << ", \"allocations\": " << phase.allocations
+            << ", \"allocated_bytes\": " << phase.allocatedBytes << "}"
+            << (i + 1 < phases_.size() ? "," : "") << std::endl;
+    }
+    out << "  ]" << std::endl;
+    out << "}" << std::endl;
+}
+
+void PhaseProfiler::writeChromeTrace(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Trace Event Format (chrome://tracing, Perfetto): complete events for
+    // phases, counter events for the RSS samples; timestamps in microseconds
+    out << std::fixed << std::setprecision(1);
+    out << "{\"traceEvents\": [" << std::endl;
+    bool first = true;
+    for (const auto& phase : phases_) {
+        out << (first ? "" : ",\n") << "{\"name\": " << jsonString(phase.name)
+            << ", \"cat\": \"phase\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": " << phase.startSeconds * 1e6
+            << ", \"dur\": " << (phase.endSeconds - phase.startSeconds) * 1e6
+            << ", \"args\": {\"rss_peak_bytes\": " << phase.rssPeak << ", \"allocations\": " << phase.allocations
+            << ", \"allocated_bytes\": " << phase.allocatedBytes << "}}";
+        first = false;
+    }
+    for (const auto& sample : samples_) {
+        out << (first ? "" : ",\n") << "{\"name\": \"RSS\", \"ph\": \"C\", \"pid\": 1, \"ts\": "
+            << sample.first * 1e6 << ", \"args\": {\"bytes\": " << sample.second << "}}";
+        first = false;
+    }
+    out << std::endl << "]}" << std::endl;
+}
+
+size_t PhaseProfiler::currentRSS() {
+    std::ifstream statm("/proc/self/statm");
+    size_t pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    }
+    return 0;
+}
+
+size_t PhaseProfiler::peakRSS() {
+    size_t peak = readStatusField("VmHWM:");
+    if (peak == 0) {
+        // No /proc: getrusage reports the process high-water mark in KB
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+            peak = static_cast<size_t>(usage.ru_maxrss) * 1024;
+        }
+    }
+    return peak;
+}
+
+bool PhaseProfiler::countsAllocations() {
+    return gCountingAllocations.load(std::memory_order_relaxed);
+}
+
+void PhaseProfiler::enableAllocationCounting() {
+    gCountingAllocations.store(true, std::memory_order_relaxed);
+}
+
+void PhaseProfiler::recordAllocation(size_t bytes) {
+    gAllocations.fetch_add(1, std::memory_order_relaxed);
+    gAllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint64_t PhaseProfiler::allocationCount() {
+    return gAllocations.load(std::memory_order_relaxed);
+}
+
+uint64_t PhaseProfiler::allocatedBytes() {
+    return gAllocatedBytes.load(std::memory_order_relaxed);
+}
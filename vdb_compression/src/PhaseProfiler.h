@@ -0,0 +1,92 @@
+#ifndef PHASEPROFILER_H
+#define PHASEPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Wall time, resident memory and heap allocations per named phase of a
+// compression. Phases nest (a Scope opened inside another is its child).
+// While sampling is on, a background thread records RSS every few
+// milliseconds, giving each phase its own high-water mark and the Chrome
+// trace a memory counter track. Allocation counts cover operator new and
+// are only available in programs linking AllocationHooks.cpp (the
+// command-line tools when built with VDB_COUNT_ALLOCATIONS).
+class PhaseProfiler {
+public:
+    struct Phase {
+        std::string name;
+        int depth = 0;
+        double startSeconds = 0.0;  // since the profiler was created
+        double endSeconds = 0.0;
+        size_t rssStart = 0;
+        size_t rssEnd = 0;
+        size_t rssPeak = 0;
+        uint64_t allocations = 0;
+        uint64_t allocatedBytes = 0;
+    };
+
+    // Records one phase from construction to destruction; a null profiler
+    // makes it a no-op
+    class Scope {
+    public:
+        Scope(PhaseProfiler* profiler, const char* name);
+        ~Scope();
+
+        // Ends the phase before the end of the enclosing block
+        void close();
+
+    private:
+        PhaseProfiler* profiler_;
+        size_t index_;
+        uint64_t allocations_;
+        uint64_t allocatedBytes_;
+    };
+
+    PhaseProfiler();
+    ~PhaseProfiler();
+
+    void startSampling(int intervalMs = 5);
+    void stopSampling();
+
+    const std::vector<Phase>& phases() const { return phases_; }
+
+    void printSummary(std::ostream& out) const;
+    void writeReport(const std::string& filename) const;
+    void writeChromeTrace(const std::string& filename) const;
+
+    static size_t currentRSS();
+    static size_t peakRSS();
+    static bool countsAllocations();
+    static uint64_t allocationCount();
+    static uint64_t allocatedBytes();
+
+    // Called by the operator new replacements of AllocationHooks.cpp
+    static void enableAllocationCounting();
+    static void recordAllocation(size_t bytes);
+
+private:
+    PhaseProfiler(const PhaseProfiler&) = delete;
+    PhaseProfiler& operator=(const PhaseProfiler&) = delete;
+
+    double now() const;
+    size_t begin(const char* name);
+    void end(size_t index, uint64_t allocations, uint64_t allocatedBytes);
+
+    std::chrono::steady_clock::time_point origin_;
+    mutable std::mutex mutex_;
+    std::vector<Phase> phases_;
+    int depth_;
+
+    std::vector<std::pair<double, size_t>> samples_;  // (seconds, RSS bytes)
+    std::atomic<bool> sampling_;
+    std::thread sampler_;
+};
+
+#endif
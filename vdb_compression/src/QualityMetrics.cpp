@@ -0,0 +1,321 @@
+#include "QualityMetrics.h"
+#include "VTKSlabReader.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// SSIM window edge in voxels (non-overlapping windows per slice)
+const int kSSIMWindow = 8;
+
+typedef openvdb::FloatTree::LeafNodeType LeafT;
+
+// JSON has no NaN/infinity; those are written as null
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    std::ostringstream text;
+    text.precision(9);
+    text << value;
+    return text.str();
+}
+
+std::vector<size_t> worstBrickOrder(const QualityReport& report, size_t count) {
+    std::vector<size_t> order(report.bricks.size());
+    std::iota(order.begin(), order.end(), 0);
+    count = std::min(count, order.size());
+    std::partial_sort(order.begin(), order.begin() + count, order.end(), [&](size_t a, size_t b) {
+        return report.bricks[a].maxError > report.bricks[b].maxError;
+    });
+    order.resize(count);
+    return order;
+}
+
+} // namespace
+
+QualityMetrics::QualityMetrics(openvdb::FloatGrid::ConstPtr grid, int brickSize)
+    : grid_(grid), brickSize_(brickSize) {
+    if (!grid_) {
+        throw std::runtime_error("No grid to compare");
+    }
+    if (brickSize_ < 1) {
+        throw std::runtime_error("Invalid brick size for metrics");
+    }
+
+    const openvdb::FloatTree& tree = grid_->tree();
+    tree.getNodes(leaves_);
+    std::sort(leaves_.begin(), leaves_.end(), [](const LeafT* a, const LeafT* b) {
+        return a->origin().z() < b->origin().z();
+    });
+
+    // Tiles above the leaf level, active or not, that differ from the background
+    auto tile = tree.cbeginValueAll();
+    tile.setMaxDepth(tile.getLeafDepth() - 1);
+    for (; tile; ++tile) {
+        if (*tile == grid_->background()) continue;
+        openvdb::CoordBBox bbox;
+        tile.getBoundingBox(bbox);
+        tiles_.push_back(std::make_pair(bbox, *tile));
+    }
+}
+
+QualityReport QualityMetrics::compare(VTKSlabReader& original) const {
+    int W = original.width(), H = original.height(), D = original.depth();
+
+    // Pass 1: value range of the original, needed for PSNR and the SSIM constants
+    float dataMin = std::numeric_limits<float>::max();
+    float dataMax = std::numeric_limits<float>::lowest();
+    std::vector<float> slab;
+    for (int z0 = 0; z0 < D; z0 += brickSize_) {
+        original.readSlab(z0, brickSize_, slab);
+        auto range = std::minmax_element(slab.begin(), slab.end());
+        dataMin = std::min(dataMin, *range.first);
+        dataMax = std::max(dataMax, *range.second);
+    }
+
+    return compareSlabs([&](int z0, int nz, std::vector<float>& out) { original.readSlab(z0, nz, out); },
+                        W, H, D, dataMin, dataMax);
+}
+
+QualityReport QualityMetrics::compare(const std::vector<float>& original, int W, int H, int D) const {
+    if (original.size() != static_cast<size_t>(W) * H * D) {
+        throw std::runtime_error("Original volume size does not match its dimensions");
+    }
+    auto range = std::minmax_element(original.begin(), original.end());
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+    return compareSlabs([&](int z0, int nz, std::vector<float>& out) {
+                            out.assign(original.begin() + z0 * sliceVoxels, original.begin() + (z0 + nz) * sliceVoxels);
+                        },
+                        W, H, D, *range.first, *range.second);
+}
+
+QualityReport QualityMetrics::compareSlabs(const SlabSource& source, int W, int H, int D,
+                                           float dataMin, float dataMax) const {
+    QualityReport report;
+    report.W = W;
+    report.H = H;
+    report.D = D;
+    report.dataMin = dataMin;
+    report.dataMax = dataMax;
+    report.brickSize = brickSize_;
+
+    int bs = brickSize_;
+    int bricksX = (W + bs - 1) / bs;
+    int bricksY = (H + bs - 1) / bs;
+    int bricksZ = (D + bs - 1) / bs;
+    report.bricks.resize(static_cast<size_t>(bricksX) * bricksY * bricksZ);
+    std::vector<openvdb::Coord> brickMaxAt(report.bricks.size());
+    std::vector<double> brickSumSq(report.bricks.size(), 0.0);
+    std::vector<double> sliceSSIMs(D, 1.0);
+    float range = dataMax - dataMin;
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+
+    std::vector<float> original;
+    std::vector<float> decoded;
+    for (int bz = 0; bz < bricksZ; ++bz) {
+        int z0 = bz * bs;
+        int nz = std::min(bs, D - z0);
+        source(z0, nz, original);
+        densifySlab(z0, nz, W, H, decoded);
+
+        size_t slabBricks = static_cast<size_t>(bricksX) * bricksY;
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, slabBricks), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                size_t b = static_cast<size_t>(bz) * slabBricks + i;
+                BrickError& brick = report.bricks[b];
+                brick.x = static_cast<int>(i % bricksX) * bs;
+                brick.y = static_cast<int>(i / bricksX) * bs;
+                brick.z = z0;
+                brick.maxError = 0.0f;
+                int nx = std::min(bs, W - brick.x);
+                int ny = std::min(bs, H - brick.y);
+                double sumSq = 0.0;
+                openvdb::Coord maxAt(brick.x, brick.y, brick.z);
+                for (int k = 0; k < nz; ++k) {
+                    for (int j = 0; j < ny; ++j) {
+                        size_t row = k * sliceVoxels + static_cast<size_t>(brick.y + j) * W + brick.x;
+                        for (int n = 0; n < nx; ++n) {
+                            float diff = std::abs(decoded[row + n] - original[row + n]);
+                            sumSq += static_cast<double>(diff) * diff;
+                            if (diff > brick.maxError) {
+                                brick.maxError = diff;
+                                maxAt = openvdb::Coord(brick.x + n, brick.y + j, z0 + k);
+                            }
+                        }
+                    }
+                }
+                brickSumSq[b] = sumSq;
+                brickMaxAt[b] = maxAt;
+                brick.rmse = std::sqrt(sumSq / (static_cast<double>(nx) * ny * nz));
+            }
+        });
+
+        tbb::parallel_for(tbb::blocked_range<int>(0, nz), [&](const tbb::blocked_range<int>& r) {
+            for (int k = r.begin(); k != r.end(); ++k) {
+                sliceSSIMs[z0 + k] = sliceSSIM(&original[k * sliceVoxels], &decoded[k * sliceVoxels], W, H, range);
+            }
+        });
+    }
+
+    double sumSq = 0.0;
+    for (size_t b = 0; b < report.bricks.size(); ++b) {
+        sumSq += brickSumSq[b];
+        if (report.bricks[b].maxError > report.maxError) {
+            report.maxError = report.bricks[b].maxError;
+            report.maxErrorAt[0] = brickMaxAt[b].x();
+            report.maxErrorAt[1] = brickMaxAt[b].y();
+            report.maxErrorAt[2] = brickMaxAt[b].z();
+        }
+    }
+    report.rmse = std::sqrt(sumSq / (static_cast<double>(sliceVoxels) * D));
+    report.psnr = (report.rmse > 0.0 && range > 0.0) ? 20.0 * std::log10(range / report.rmse)
+                                                      : std::numeric_limits<double>::infinity();
+
+    report.meanSSIM = 0.0;
+    report.minSSIM = std::numeric_limits<double>::max();
+    for (int z = 0; z < D; ++z) {
+        report.meanSSIM += sliceSSIMs[z];
+        if (sliceSSIMs[z] < report.minSSIM) {
+            report.minSSIM = sliceSSIMs[z];
+            report.minSSIMSlice = z;
+        }
+    }
+    report.meanSSIM /= std::max(D, 1);
+    return report;
+}
+
+void QualityMetrics::densifySlab(int z0, int nz, int W, int H, std::vector<float>& slab) const {
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+    slab.assign(sliceVoxels * nz, grid_->background());
+
+    for (const auto& tile : tiles_) {
+        const openvdb::Coord& lo = tile.first.min();
+        const openvdb::Coord& hi = tile.first.max();
+        for (int z = std::max(lo.z(), z0); z <= std::min(hi.z(), z0 + nz - 1); ++z) {
+            for (int y = std::max(lo.y(), 0); y <= std::min(hi.y(), H - 1); ++y) {
+                float* row = &slab[(z - z0) * sliceVoxels + static_cast<size_t>(y) * W];
+                std::fill(row + std::max(lo.x(), 0), row + std::min(hi.x(), W - 1) + 1, tile.second);
+            }
+        }
+    }
+
+    // Leaves overlapping the slab; each writes only its own voxels
+    int dim = static_cast<int>(LeafT::DIM);
+    auto first = std::lower_bound(leaves_.begin(), leaves_.end(), z0 - dim + 1,
+                                  [](const LeafT* leaf, int z) { return leaf->origin().z() < z; });
+    auto last = std::lower_bound(first, leaves_.end(), z0 + nz,
+                                 [](const LeafT* leaf, int z) { return leaf->origin().z() < z; });
+    size_t begin = first - leaves_.begin();
+    size_t end = last - leaves_.begin();
+    tbb::parallel_for(tbb::blocked_range<size_t>(begin, end), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const LeafT* leaf = leaves_[i];
+            const openvdb::Coord& o = leaf->origin();
+            for (int z = std::max(o.z(), z0); z < std::min(o.z() + dim, z0 + nz); ++z) {
+                for (int y = std::max(o.y(), 0); y < std::min(o.y() + dim, H); ++y) {
+                    float* row = &slab[(z - z0) * sliceVoxels + static_cast<size_t>(y) * W];
+                    for (int x = std::max(o.x(), 0); x < std::min(o.x() + dim, W); ++x) {
+                        row[x] = leaf->getValue(LeafT::coordToOffset(openvdb::Coord(x, y, z)));
+                    }
+                }
+            }
+        }
+    });
+}
+
+double QualityMetrics::sliceSSIM(const float* original, const float* decoded, int W, int H, float range) const {
+    // Standard stabilizers for a dynamic range L: (0.01 L)^2 and (0.03 L)^2
+    double L = range > 0.0f ? range : 1.0;
+    double c1 = (0.01 * L) * (0.01 * L);
+    double c2 = (0.03 * L) * (0.03 * L);
+    int wx = std::min(kSSIMWindow, W);
+    int wy = std::min(kSSIMWindow, H);
+    double n = static_cast<double>(wx) * wy;
+
+    double sum = 0.0;
+    size_t windows = 0;
+    for (int y0 = 0; y0 + wy <= H; y0 += wy) {
+        for (int x0 = 0; x0 + wx <= W; x0 += wx) {
+            double sx = 0.0, sy = 0.0, sxx = 0.0, syy = 0.0, sxy = 0.0;
+            for (int y = y0; y < y0 + wy; ++y) {
+                for (int x = x0; x < x0 + wx; ++x) {
+                    double a = original[static_cast<size_t>(y) * W + x];
+                    double b = decoded[static_cast<size_t>(y) * W + x];
+                    sx += a;
+                    sy += b;
+                    sxx += a * a;
+                    syy += b * b;
+                    sxy += a * b;
+                }
+            }
+            double mx = sx / n, my = sy / n;
+            double vx = std::max(0.0, sxx / n - mx * mx);
+            double vy = std::max(0.0, syy / n - my * my);
+            double cxy = sxy / n - mx * my;
+            sum += ((2.0 * mx * my + c1) * (2.0 * cxy + c2)) / ((mx * mx + my * my + c1) * (vx + vy + c2));
+            ++windows;
+        }
+    }
+    return windows > 0 ? sum / windows : 1.0;
+}
+
+void QualityMetrics::print(const QualityReport& report, std::ostream& out, int worstBricks) {
+    out << "Dimensions: " << report.W << " x " << report.H << " x " << report.D << std::endl;
+    out << "Value range: [" << report.dataMin << ", " << report.dataMax << "]" << std::endl;
+    out << "RMSE: " << report.rmse << std::endl;
+    out << "PSNR: " << report.psnr << " dB" << std::endl;
+    out << "Max abs error: " << report.maxError << " at (" << report.maxErrorAt[0] << ", "
+        << report.maxErrorAt[1] << ", " << report.maxErrorAt[2] << ")" << std::endl;
+    out << "SSIM (slices): mean " << report.meanSSIM << ", min " << report.minSSIM
+        << " at z = " << report.minSSIMSlice << std::endl;
+    out << "Worst bricks (" << report.brickSize << "^3):" << std::endl;
+    for (size_t b : worstBrickOrder(report, worstBricks)) {
+        const BrickError& brick = report.bricks[b];
+        out << "  (" << brick.x << ", " << brick.y << ", " << brick.z << "): max error "
+            << brick.maxError << ", RMSE " << brick.rmse << std::endl;
+    }
+}
+
+void QualityMetrics::writeJSON(const QualityReport& report, std::ostream& out, bool allBricks, int worstBricks) {
+    auto writeBrick = [&](const BrickError& brick) {
+        out << "{\"origin\": [" << brick.x << ", " << brick.y << ", " << brick.z << "], \"max_error\": "
+            << jsonNumber(brick.maxError) << ", \"rmse\": " << jsonNumber(brick.rmse) << "}";
+    };
+
+    out << "{" << std::endl;
+    out << "  \"dimensions\": [" << report.W << ", " << report.H << ", " << report.D << "]," << std::endl;
+    out << "  \"range\": [" << jsonNumber(report.dataMin) << ", " << jsonNumber(report.dataMax) << "]," << std::endl;
+    out << "  \"rmse\": " << jsonNumber(report.rmse) << "," << std::endl;
+    out << "  \"psnr\": " << jsonNumber(report.psnr) << "," << std::endl;
+    out << "  \"max_error\": " << jsonNumber(report.maxError) << "," << std::endl;
+    out << "  \"max_error_at\": [" << report.maxErrorAt[0] << ", " << report.maxErrorAt[1] << ", "
+        << report.maxErrorAt[2] << "]," << std::endl;
+    out << "  \"ssim\": {\"mean\": " << jsonNumber(report.meanSSIM) << ", \"min\": " << jsonNumber(report.minSSIM)
+        << ", \"min_slice\": " << report.minSSIMSlice << ", \"window\": " << kSSIMWindow << "}," << std::endl;
+    out << "  \"brick_size\": " << report.brickSize << "," << std::endl;
+
+    std::vector<size_t> order = worstBrickOrder(report, worstBricks);
+    out << "  \"worst_bricks\": [";
+    for (size_t i = 0; i < order.size(); ++i) {
+        out << (i ? ", " : "");
+        writeBrick(report.bricks[order[i]]);
+    }
+    out << "]";
+    if (allBricks) {
+        out << "," << std::endl << "  \"bricks\": [" << std::endl;
+        for (size_t b = 0; b < report.bricks.size(); ++b) {
+            out << "    ";
+            writeBrick(report.bricks[b]);
+            out << (b + 1 < report.bricks.size() ? "," : "") << std::endl;
+        }
+        out << "  ]";
+    }
+    out << std::endl << "}" << std::endl;
+}
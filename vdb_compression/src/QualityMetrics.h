@@ -0,0 +1,68 @@
+#ifndef QUALITYMETRICS_H
+#define QUALITYMETRICS_H
+
+#include <openvdb/openvdb.h>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class VTKSlabReader;
+
+// Compares a compressed grid with the original volume. Both are processed
+// one Z-slab (brickSize slices) at a time: the grid is densified leaf-
+// parallel into the slab, then bricks and slices are scored in parallel,
+// so memory stays at two slabs whatever the volume size.
+
+struct BrickError {
+    int x, y, z;
+    float maxError;
+    double rmse;
+};
+
+struct QualityReport {
+    int W = 0, H = 0, D = 0;
+    float dataMin = 0.0f, dataMax = 0.0f;
+    double rmse = 0.0;
+    double psnr = 0.0;             // infinity for an exact reconstruction
+    float maxError = 0.0f;
+    int maxErrorAt[3] = {0, 0, 0};
+    double meanSSIM = 1.0;         // mean over Z slices
+    double minSSIM = 1.0;
+    int minSSIMSlice = 0;
+    int brickSize = 0;
+    std::vector<BrickError> bricks; // x-fastest brick order
+};
+
+class QualityMetrics {
+public:
+    // grid values are read in index space, voxel (x, y, z) = original [x, y, z]
+    QualityMetrics(openvdb::FloatGrid::ConstPtr grid, int brickSize = 32);
+
+    // Streams the original twice: once for its value range, once to compare
+    QualityReport compare(VTKSlabReader& original) const;
+    QualityReport compare(const std::vector<float>& original, int W, int H, int D) const;
+
+    // Human-readable summary with the worst bricks
+    static void print(const QualityReport& report, std::ostream& out, int worstBricks = 5);
+
+    // JSON report; every brick is listed when allBricks is set, otherwise
+    // only the worstBricks largest max errors
+    static void writeJSON(const QualityReport& report, std::ostream& out,
+                          bool allBricks, int worstBricks = 10);
+
+private:
+    typedef std::function<void(int z0, int nz, std::vector<float>& slab)> SlabSource;
+
+    QualityReport compareSlabs(const SlabSource& source, int W, int H, int D,
+                               float dataMin, float dataMax) const;
+    void densifySlab(int z0, int nz, int W, int H, std::vector<float>& slab) const;
+    double sliceSSIM(const float* original, const float* decoded, int W, int H, float range) const;
+
+    openvdb::FloatGrid::ConstPtr grid_;
+    int brickSize_;
+    std::vector<const openvdb::FloatTree::LeafNodeType*> leaves_; // sorted by origin z
+    std::vector<std::pair<openvdb::CoordBBox, float>> tiles_;     // non-background tiles
+};
+
+#endif
@@ -0,0 +1,268 @@
+#include "QuantizedBrickCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = {'Q', 'B', 'S', '1'};
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated quantized brick stream");
+    }
+    return value;
+}
+
+size_t codeBytes(const QuantizedBrick& brick) {
+    return static_cast<size_t>(brick.nx) * brick.ny * brick.nz * brick.bits / 8;
+}
+
+} // namespace
+
+size_t QuantizedBrickStream::byteSize() const {
+    size_t bytes = sizeof(kMagic) + 5 * sizeof(int32_t) + sizeof(uint64_t);
+    for (const auto& brick : bricks) {
+        bytes += 6 * sizeof(int32_t) + sizeof(uint8_t) + 2 * sizeof(float) + brick.codes.size();
+    }
+    return bytes;
+}
+
+QuantizedBrickCodec::QuantizedBrickCodec(int bits, float maxError)
+    : bits_(bits), maxError_(maxError) {
+    if (bits_ != 0 && bits_ != 8 && bits_ != 16) {
+        throw std::runtime_error("Quantization supports 8 or 16 bits (0 for automatic)");
+    }
+}
+
+QuantizedBrick QuantizedBrickCodec::encode(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int x, int y, int z,
+    int brickSize,
+    float minVal, float maxVal) const {
+
+    QuantizedBrick brick;
+    brick.x = x;
+    brick.y = y;
+    brick.z = z;
+    brick.nx = std::min(brickSize, W - x);
+    brick.ny = std::min(brickSize, H - y);
+    brick.nz = std::min(brickSize, D - z);
+    brick.offset = minVal;
+    brick.scale = 0.0f;
+    brick.bits = 0;
+
+    // Constant brick, no codes needed. A denormal range is treated the same
+    // way, since its step would underflow and give an infinite inverse scale
+    if (!(maxVal - minVal > std::numeric_limits<float>::min())) {
+        return brick;
+    }
+
+    std::vector<float> values(static_cast<size_t>(brick.nx) * brick.ny * brick.nz);
+    for (int k = 0; k < brick.nz; ++k) {
+        for (int j = 0; j < brick.ny; ++j) {
+            const float* row = &volumeData[static_cast<size_t>(z + k) * W * H + static_cast<size_t>(y + j) * W + x];
+            std::copy(row, row + brick.nx, values.begin() + (static_cast<size_t>(k) * brick.ny + j) * brick.nx);
+        }
+    }
+
+    // Escalate the bit depth until the measured error is within the bound
+    std::vector<float> decoded(values.size());
+    for (int bits = (bits_ == 0) ? 8 : bits_; bits <= 16; bits *= 2) {
+        quantize(values, bits, brick);
+        if (maxError_ <= 0.0f) {
+            return brick;
+        }
+        decode(brick, decoded.data());
+        float error = 0.0f;
+        for (size_t i = 0; i < values.size(); ++i) {
+            error = std::max(error, std::abs(decoded[i] - values[i]));
+        }
+        if (error <= maxError_) {
+            return brick;
+        }
+    }
+
+    // Fall back to raw floats when 16 bits cannot meet the bound
+    brick.bits = 32;
+    brick.scale = 1.0f;
+    brick.offset = 0.0f;
+    brick.codes.resize(values.size() * sizeof(float));
+    std::memcpy(brick.codes.data(), values.data(), brick.codes.size());
+    return brick;
+}
+
+void QuantizedBrickCodec::quantize(const std::vector<float>& values, int bits, QuantizedBrick& brick) const {
+    float maxCode = static_cast<float>((1u << bits) - 1);
+    float range = 0.0f;
+    float lo = brick.offset;
+    for (float v : values) {
+        range = std::max(range, v - lo);
+    }
+
+    brick.scale = range / maxCode;
+    if (!(brick.scale >= std::numeric_limits<float>::min())) {
+        brick.bits = 0;
+        brick.scale = 0.0f;
+        brick.codes.clear();
+        return;
+    }
+    brick.bits = static_cast<uint8_t>(bits);
+    brick.codes.resize(values.size() * bits / 8);
+
+    float invScale = 1.0f / brick.scale;
+    if (bits == 8) {
+        uint8_t* codes = brick.codes.data();
+        for (size_t i = 0; i < values.size(); ++i) {
+            codes[i] = static_cast<uint8_t>(std::min(maxCode, std::round((values[i] - lo) * invScale)));
+        }
+    } else {
+        for (size_t i = 0; i < values.size(); ++i) {
+            uint16_t code = static_cast<uint16_t>(std::min(maxCode, std::round((values[i] - lo) * invScale)));
+            std::memcpy(&brick.codes[2 * i], &code, sizeof(code));
+        }
+    }
+}
+
+void QuantizedBrickCodec::decode(const QuantizedBrick& brick, float* out) {
+    size_t count = static_cast<size_t>(brick.nx) * brick.ny * brick.nz;
+    switch (brick.bits) {
+        case 0:
+            std::fill(out, out + count, brick.offset);
+            break;
+        case 8:
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = brick.offset + brick.codes[i] * brick.scale;
+            }
+            break;
+        case 16:
+            for (size_t i = 0; i < count; ++i) {
+                uint16_t code;
+                std::memcpy(&code, &brick.codes[2 * i], sizeof(code));
+                out[i] = brick.offset + code * brick.scale;
+            }
+            break;
+        case 32:
+            std::memcpy(out, brick.codes.data(), count * sizeof(float));
+            break;
+        default:
+            throw std::runtime_error("Invalid quantized brick bit depth");
+    }
+}
+
+void QuantizedBrickCodec::decodeVolume(const QuantizedBrickStream& stream, std::vector<float>& volume) {
+    int W = stream.W, H = stream.H;
+    volume.assign(static_cast<size_t>(W) * H * stream.D, stream.background);
+
+    std::vector<float> values;
+    for (const auto& brick : stream.bricks) {
+        values.resize(static_cast<size_t>(brick.nx) * brick.ny * brick.nz);
+        decode(brick, values.data());
+        for (int k = 0; k < brick.nz; ++k) {
+            for (int j = 0; j < brick.ny; ++j) {
+                const float* src = &values[(static_cast<size_t>(k) * brick.ny + j) * brick.nx];
+                std::copy(src, src + brick.nx,
+                          volume.begin() + static_cast<size_t>(brick.z + k) * W * H +
+                          static_cast<size_t>(brick.y + j) * W + brick.x);
+            }
+        }
+    }
+}
+
+void QuantizedBrickCodec::write(const QuantizedBrickStream& stream, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writePod<int32_t>(out, stream.W);
+    writePod<int32_t>(out, stream.H);
+    writePod<int32_t>(out, stream.D);
+    writePod<int32_t>(out, stream.brickSize);
+    writePod<float>(out, stream.background);
+    writePod<uint64_t>(out, stream.bricks.size());
+
+    for (const auto& brick : stream.bricks) {
+        writePod<int32_t>(out, brick.x);
+        writePod<int32_t>(out, brick.y);
+        writePod<int32_t>(out, brick.z);
+        writePod<int32_t>(out, brick.nx);
+        writePod<int32_t>(out, brick.ny);
+        writePod<int32_t>(out, brick.nz);
+        writePod<uint8_t>(out, brick.bits);
+        writePod<float>(out, brick.offset);
+        writePod<float>(out, brick.scale);
+        out.write(reinterpret_cast<const char*>(brick.codes.data()), brick.codes.size());
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+QuantizedBrickStream QuantizedBrickCodec::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a quantized brick stream: " + filename);
+    }
+
+    QuantizedBrickStream stream;
+    stream.W = readPod<int32_t>(in);
+    stream.H = readPod<int32_t>(in);
+    stream.D = readPod<int32_t>(in);
+    stream.brickSize = readPod<int32_t>(in);
+    stream.background = readPod<float>(in);
+    uint64_t count = readPod<uint64_t>(in);
+    if (stream.W <= 0 || stream.H <= 0 || stream.D <= 0) {
+        throw std::runtime_error("Invalid volume dimensions in: " + filename);
+    }
+
+    stream.bricks.resize(count);
+    for (auto& brick : stream.bricks) {
+        brick.x = readPod<int32_t>(in);
+        brick.y = readPod<int32_t>(in);
+        brick.z = readPod<int32_t>(in);
+        brick.nx = readPod<int32_t>(in);
+        brick.ny = readPod<int32_t>(in);
+        brick.nz = readPod<int32_t>(in);
+        brick.bits = readPod<uint8_t>(in);
+        brick.offset = readPod<float>(in);
+        brick.scale = readPod<float>(in);
+
+        if (brick.nx <= 0 || brick.ny <= 0 || brick.nz <= 0) {
+            throw std::runtime_error("Invalid brick dimensions in: " + filename);
+        }
+        if (brick.bits != 0 && brick.bits != 8 && brick.bits != 16 && brick.bits != 32) {
+            throw std::runtime_error("Invalid quantized brick bit depth in: " + filename);
+        }
+        if (brick.x < 0 || brick.y < 0 || brick.z < 0 ||
+            brick.nx > stream.W - brick.x || brick.ny > stream.H - brick.y || brick.nz > stream.D - brick.z) {
+            throw std::runtime_error("Brick outside volume in: " + filename);
+        }
+        brick.codes.resize(codeBytes(brick));
+        in.read(reinterpret_cast<char*>(brick.codes.data()), brick.codes.size());
+        if (!in) {
+            throw std::runtime_error("Truncated quantized brick stream: " + filename);
+        }
+    }
+    return stream;
+}
@@ -0,0 +1,59 @@
+#ifndef QUANTIZEDBRICKCODEC_H
+#define QUANTIZEDBRICKCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One brick quantized as value = offset + code * scale, with 8- or 16-bit
+// codes (0 bits for constant bricks, 32 for bricks kept as raw floats)
+struct QuantizedBrick {
+    int x, y, z;        // brick origin in voxels
+    int nx, ny, nz;     // brick extent, smaller than brickSize at the volume edge
+    uint8_t bits;
+    float offset;
+    float scale;
+    std::vector<uint8_t> codes;
+};
+
+// Selected bricks of a volume; everything else reads as background
+struct QuantizedBrickStream {
+    int W = 0, H = 0, D = 0;
+    int brickSize = 0;
+    float background = 0.0f;
+    std::vector<QuantizedBrick> bricks;
+
+    size_t byteSize() const;
+};
+
+// Per-brick scale/offset quantization using the brick min/max. Each brick
+// gets the fewest bits (starting at `bits`) whose reconstruction error stays
+// within maxError; maxError <= 0 keeps the requested bit depth.
+class QuantizedBrickCodec {
+public:
+    explicit QuantizedBrickCodec(int bits = 16, float maxError = 0.0f);
+
+    QuantizedBrick encode(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int x, int y, int z,
+        int brickSize,
+        float minVal, float maxVal) const;
+
+    // Decodes a brick into out[(z * ny + y) * nx + x]
+    static void decode(const QuantizedBrick& brick, float* out);
+
+    // Reconstructs the dense volume, background outside the stored bricks
+    static void decodeVolume(const QuantizedBrickStream& stream, std::vector<float>& volume);
+
+    static void write(const QuantizedBrickStream& stream, const std::string& filename);
+    static QuantizedBrickStream read(const std::string& filename);
+
+private:
+    void quantize(const std::vector<float>& values, int bits, QuantizedBrick& brick) const;
+
+    int bits_;
+    float maxError_;
+};
+
+#endif
@@ -1,85 +1,1042 @@
 #include "VDBCompressor.h"
+#include "BrickMetrics.h"
+#include "VTKSlabReader.h"
 #include <openvdb/openvdb.h>
-#include <vtkSmartPointer.h>
-#include <vtkStructuredPointsReader.h>
-#include <vtkImageData.h>
-#include <vtkDataArray.h>
-#include <vtkPointData.h>
-#include <vtkStructuredPoints.h>
+#include <openvdb/io/Stream.h>
+#include <openvdb/tools/ChangeBackground.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <limits>
+#include <sstream>
+#include <unordered_map>
 
-VDBCompressor::VDBCompressor() {
+namespace {
+
+// OpenVDB FloatTree node sizes: 8^3 leaves under 128^3 internal nodes
+const int kLeafDim = openvdb::FloatTree::LeafNodeType::DIM;
+const int kInternalDim = openvdb::FloatTree::RootNodeType::ChildNodeType::ChildNodeType::DIM;
+
+// Brick sizes tried by autotuning, all leaf- and internal-node-aligned
+const int kCandidateBrickSizes[] = {8, 16, 32, 64};
+
+// Bricks sampled when calibrating the per-voxel cost of the output file
+const int kCalibrationBricks = 32;
+
+// Accepted deviation from --target-bytes before the selection is corrected
+const double kTargetSizeTolerance = 0.03;
+
+// Largest per-axis sample of a region when estimating its background
+const int kRegionSampleDim = 64;
+
+// Voxels within this fraction of the data range of the background count as
+// background in the brick statistics
+const float kNearBackgroundFraction = 0.01f;
+
+// Rounds a brick size up to a power of two between the leaf and internal
+// node sizes, or to a multiple of the internal node size, so that bricks
+// starting at multiples of it never straddle a leaf or internal node
+int alignBrickSize(int brickSize) {
+    if (brickSize > kInternalDim) {
+        return (brickSize + kInternalDim - 1) / kInternalDim * kInternalDim;
+    }
+    int aligned = kLeafDim;
+    while (aligned < brickSize) {
+        aligned *= 2;
+    }
+    return aligned;
+}
+
+// 64-bit multiply/rotate mix for brick content hashing
+inline uint64_t mixHash(uint64_t h, uint64_t v) {
+    h ^= v * 0x9E3779B97F4A7C15ull;
+    h = (h << 31) | (h >> 33);
+    return h * 0xBF58476D1CE4E5B9ull;
+}
+
+// Content hash of a whole volume, hashed in blocks in parallel and combined
+// in order; identifies the volume a brick statistics cache belongs to
+uint64_t volumeFingerprint(const std::vector<float>& data) {
+    const size_t kBlock = size_t(1) << 20;
+    std::vector<uint64_t> blockHashes((data.size() + kBlock - 1) / kBlock);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blockHashes.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t b = r.begin(); b != r.end(); ++b) {
+            uint64_t h = b;
+            for (size_t i = b * kBlock; i < std::min(data.size(), (b + 1) * kBlock); ++i) {
+                uint32_t bits;
+                std::memcpy(&bits, &data[i], sizeof(bits));
+                h = mixHash(h, bits);
+            }
+            blockHashes[b] = h;
+        }
+    });
+    uint64_t h = data.size();
+    for (uint64_t blockHash : blockHashes) {
+        h = mixHash(h, blockHash);
+    }
+    return h;
+}
+
+// Sorted indices as comma-separated ranges, e.g. "3,7-12", and back; the
+// cleared-brick list of a sequence delta step is stored this way
+std::string encodeIndexRanges(const std::vector<size_t>& indices) {
+    std::ostringstream out;
+    for (size_t i = 0; i < indices.size();) {
+        size_t j = i;
+        while (j + 1 < indices.size() && indices[j + 1] == indices[j] + 1) {
+            ++j;
+        }
+        out << (i > 0 ? "," : "") << indices[i];
+        if (j > i) out << "-" << indices[j];
+        i = j + 1;
+    }
+    return out.str();
+}
+
+std::vector<size_t> decodeIndexRanges(const std::string& text) {
+    std::vector<size_t> indices;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        size_t dash = item.find('-');
+        size_t first = std::stoull(item.substr(0, dash));
+        size_t last = (dash == std::string::npos) ? first : std::stoull(item.substr(dash + 1));
+        for (size_t i = first; i <= last; ++i) {
+            indices.push_back(i);
+        }
+    }
+    return indices;
+}
+
+size_t serializedGridSize(openvdb::FloatGrid::Ptr grid) {
+    std::ostringstream ostr(std::ios_base::binary);
+    openvdb::GridPtrVec grids;
+    grids.push_back(grid);
+    openvdb::io::Stream(ostr).write(grids);
+    return static_cast<size_t>(ostr.tellp());
+}
+
+} // namespace
+
+VDBCompressor::VDBCompressor()
+    : maxAbsError_(0.0f), targetPSNR_(0.0f), targetBytes_(0), tileTolerance_(0.0f),
+      nearBackgroundTolerance_(0.0f), adaptiveBackground_(false), quantizeBits_(-1), quantizeError_(0.0f),
+      containerEnabled_(false), containerCompression_(BrickCompression::None) {
     openvdb::initialize();
 }
 
-openvdb::FloatGrid::Ptr VDBCompressor::compressVTKVolume(
-    const std::string& vtkFilename, 
-    float quality, 
+void VDBCompressor::setErrorBound(float maxAbsError, float targetPSNR) {
+    maxAbsError_ = maxAbsError;
+    targetPSNR_ = targetPSNR;
+}
+
+void VDBCompressor::setTargetBytes(size_t targetBytes) {
+    targetBytes_ = targetBytes;
+}
+
+void VDBCompressor::setTileTolerance(float tolerance) {
+    tileTolerance_ = tolerance;
+}
+
+void VDBCompressor::setAdaptiveBackground(bool enabled) {
+    adaptiveBackground_ = enabled;
+}
+
+void VDBCompressor::setQuantization(int bits, float maxError) {
+    quantizeBits_ = bits;
+    quantizeError_ = maxError;
+}
+
+void VDBCompressor::validateOptions(int brickSize) const {
+    bool errorBounded = maxAbsError_ > 0.0f || targetPSNR_ > 0.0f;
+    if (errorBounded && targetBytes_ > 0) {
+        throw std::runtime_error("Target size cannot be combined with an error bound");
+    }
+    if (brickSize <= 0 && !errorBounded) {
+        throw std::runtime_error("Brick size autotuning needs an error target (--max-error or --psnr)");
+    }
+    if (adaptiveBackground_ && (quantizeBits_ >= 0 || containerEnabled_)) {
+        throw std::runtime_error("Adaptive background cannot be combined with quantized bricks or a brick container");
+    }
+    if (targetPSNR_ > 0.0f && tileTolerance_ > 0.0f) {
+        // Tile error is not part of the PSNR budget of the brick selection
+        throw std::runtime_error("A PSNR target cannot be combined with a positive tile tolerance");
+    }
+}
+
+void VDBCompressor::setBrickMetric(std::shared_ptr<const BrickMetric> metric) {
+    metric_ = metric;
+}
+
+std::shared_ptr<const BrickMetric> VDBCompressor::resolveMetric(int metricType) const {
+    return metric_ ? metric_ : BrickMetric::create(metricType);
+}
+
+void VDBCompressor::enableBrickContainer(BrickCompression compression) {
+    containerEnabled_ = true;
+    containerCompression_ = compression;
+}
+
+openvdb::FloatGrid::Ptr VDBCompressor::compressVolume(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    float quality,
     int brickSize,
     int metricType) {
     
-    // Load VTK data
-    auto reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
-    reader->SetFileName(vtkFilename.c_str());
-    reader->Update();
+    validateOptions(brickSize);
+    
+    // Create empty OpenVDB grid
+    openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create();
+    grid->setGridClass(openvdb::GRID_FOG_VOLUME);
+    grid->setName("compressed_volume");
+    
+    // Compute background value using histogram
+    backgroundMap_ = BackgroundMap();
+    float background;
+    {
+        PhaseProfiler::Scope phase(&profiler_, "background");
+        float dataRange;
+        background = computeBackgroundValue(volumeData, dataRange);
+        nearBackgroundTolerance_ = kNearBackgroundFraction * dataRange;
+    }
+    
+    std::shared_ptr<const BrickMetric> metric = resolveMetric(metricType);
+    std::cout << "Ranking metric: " << metric->name() << std::endl;
+    
+    if (brickSize <= 0) {
+        PhaseProfiler::Scope phase(&profiler_, "autotune");
+        brickSize = autotuneBrickSize(volumeData, W, H, D, background, *metric);
+    } else if (alignBrickSize(brickSize) != brickSize) {
+        std::cout << "Brick size " << brickSize << " aligned to " << alignBrickSize(brickSize) << std::endl;
+        brickSize = alignBrickSize(brickSize);
+    }
+    
+    if (adaptiveBackground_) {
+        PhaseProfiler::Scope phase(&profiler_, "region_background");
+        estimateRegionBackgrounds(volumeData, W, H, D, brickSize, background);
+    }
+    
+    // FIX: Use insertMeta("background", ...) instead of setBackground()
+    // The background is automatically set when we create the grid
+    // We'll handle background during the compression algorithm
+    
+    // Apply fixed-rate compression algorithm
+    applyCompressionAlgorithm(grid, volumeData, W, H, D, background, quality, brickSize, *metric);
+    
+    return grid;
+}
+
+std::vector<openvdb::FloatGrid::Ptr> VDBCompressor::compressSweep(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    const std::vector<float>& qualities,
+    const std::vector<int>& metricTypes,
+    int brickSize,
+    const std::string& statsCache) {
     
-    // Use auto to avoid type casting issues
-    auto vtkData = reader->GetOutput();
+    if (maxAbsError_ > 0.0f || targetPSNR_ > 0.0f || targetBytes_ > 0 || adaptiveBackground_) {
+        throw std::runtime_error("Sweep mode does not support error bounds, target size or adaptive background");
+    }
+    if (quantizeBits_ >= 0 || containerEnabled_) {
+        throw std::runtime_error("Sweep mode does not support quantized bricks or a brick container");
+    }
+    if (brickSize <= 0) {
+        throw std::runtime_error("Sweep mode needs a fixed brick size");
+    }
+    if (alignBrickSize(brickSize) != brickSize) {
+        std::cout << "Brick size " << brickSize << " aligned to " << alignBrickSize(brickSize) << std::endl;
+        brickSize = alignBrickSize(brickSize);
+    }
     
-    if (!vtkData) {
-        throw std::runtime_error("Failed to load VTK file: " + vtkFilename);
+    std::vector<std::shared_ptr<const BrickMetric>> metrics;
+    bool full = false;
+    for (int type : metricTypes) {
+        metrics.push_back(BrickMetric::create(type));
+        full = full || metrics.back()->needsFullStats();
     }
     
-    // Get volume dimensions and data
-    int dims[3];
-    vtkData->GetDimensions(dims);
-    int W = dims[0], H = dims[1], D = dims[2];
+    backgroundMap_ = BackgroundMap();
+    BrickStatsTable table = loadBrickStats(volumeData, W, H, D, brickSize, full, statsCache);
+    float background = table.background;
+    nearBackgroundTolerance_ = kNearBackgroundFraction * table.dataRange;
     
-    vtkPointData* pointData = vtkData->GetPointData();
-    if (!pointData) {
-        throw std::runtime_error("No point data in VTK file");
+    // Qualities are built smallest first so each extends the previous one
+    std::vector<size_t> order(qualities.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
     }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return qualities[a] < qualities[b]; });
+    
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int totalBricks = static_cast<int>(table.stats.size());
+    std::vector<openvdb::FloatGrid::Ptr> grids(metrics.size() * qualities.size());
     
-    vtkDataArray* scalarData = pointData->GetScalars();
-    if (!scalarData) {
-        throw std::runtime_error("No scalar data in VTK file");
+    for (size_t m = 0; m < metrics.size(); ++m) {
+        const BrickMetric& metric = *metrics[m];
+        std::cout << "Ranking metric: " << metric.name() << std::endl;
+        
+        std::vector<Brick> bricks(table.stats.size());
+        {
+            PhaseProfiler::Scope phase(&profiler_, "sort");
+            for (size_t b = 0; b < bricks.size(); ++b) {
+                Brick& brick = bricks[b];
+                brick.x = static_cast<int>(b % bricksX) * brickSize;
+                brick.y = static_cast<int>((b / bricksX) % bricksY) * brickSize;
+                brick.z = static_cast<int>(b / (static_cast<size_t>(bricksX) * bricksY)) * brickSize;
+                brick.background = background;
+                brick.minVal = table.stats[b].minVal;
+                brick.maxVal = table.stats[b].maxVal;
+                brick.similarity = metric.score(table.stats[b], background);
+            }
+            if (metric.highestFirst()) {
+                std::sort(bricks.rbegin(), bricks.rend());
+            } else {
+                std::sort(bricks.begin(), bricks.end());
+            }
+        }
+        
+        // One working grid per metric; every quality activates the bricks
+        // past the previous one and is saved as a pruned copy
+        openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create();
+        grid->setGridClass(openvdb::GRID_FOG_VOLUME);
+        auto& tree = grid->tree();
+        tileStats_ = TileStats();
+        activateExtremeCorners(tree, volumeData, W, H, D);
+        int activated = 0;
+        
+        for (size_t q : order) {
+            int bricksToActivate = std::min(static_cast<int>(totalBricks * qualities[q]), totalBricks);
+            {
+                PhaseProfiler::Scope phase(&profiler_, "activation");
+                // Nodes whose bricks are all selected only now replace the
+                // leaves written for them at lower qualities
+                std::vector<char> covered(totalBricks, 0);
+                activateNodeTiles(tree, bricks, bricksToActivate, volumeData, W, H, D, brickSize, covered);
+                for (int i = activated; i < bricksToActivate; ++i) {
+                    if (!covered[i]) {
+                        activateBrick(tree, bricks[i], volumeData, W, H, D, brickSize);
+                    }
+                }
+                activated = std::max(activated, bricksToActivate);
+            }
+            
+            openvdb::FloatGrid::Ptr output;
+            {
+                PhaseProfiler::Scope phase(&profiler_, "prune");
+                output = grid->deepCopy();
+                output->tree().prune();
+            }
+            std::ostringstream name;
+            name << "compressed_volume_" << metric.name() << "_q" << qualities[q];
+            output->setName(name.str());
+            output->insertMeta("brick_size", openvdb::Int32Metadata(brickSize));
+            output->insertMeta("sweep_metric", openvdb::StringMetadata(metric.name()));
+            output->insertMeta("sweep_quality", openvdb::FloatMetadata(qualities[q]));
+            std::cout << "  quality " << qualities[q] << ": " << bricksToActivate << " of " << totalBricks
+                      << " bricks, grid memory " << output->memUsage() << " bytes" << std::endl;
+            grids[m * qualities.size() + q] = output;
+        }
     }
     
-    int totalVoxels = W * H * D;
+    std::cout << "Background value: " << background << std::endl;
+    return grids;
+}
+
+BrickStatsTable VDBCompressor::loadBrickStats(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize,
+    bool full,
+    const std::string& statsCache) {
     
-    std::vector<float> volumeData(totalVoxels);
-    for (int i = 0; i < totalVoxels; ++i) {
-        volumeData[i] = static_cast<float>(scalarData->GetComponent(i, 0));
+    uint64_t fingerprint = 0;
+    if (!statsCache.empty()) {
+        PhaseProfiler::Scope phase(&profiler_, "stats_cache");
+        fingerprint = volumeFingerprint(volumeData);
+        if (std::ifstream(statsCache).good()) {
+            try {
+                BrickStatsTable table = BrickStatsTable::read(statsCache);
+                if (table.W == W && table.H == H && table.D == D && table.brickSize == brickSize &&
+                    table.fingerprint == fingerprint && (table.full || !full)) {
+                    std::cout << "Brick statistics read from: " << statsCache << std::endl;
+                    return table;
+                }
+                std::cout << "Brick statistics cache does not match this volume, recomputing" << std::endl;
+            } catch (const std::exception& e) {
+                std::cout << "Ignoring brick statistics cache: " << e.what() << std::endl;
+            }
+        }
     }
     
-    // Create empty OpenVDB grid
+    BrickStatsTable table;
+    table.W = W;
+    table.H = H;
+    table.D = D;
+    table.brickSize = brickSize;
+    table.full = full;
+    table.fingerprint = fingerprint;
+    {
+        PhaseProfiler::Scope phase(&profiler_, "background");
+        table.background = computeBackgroundValue(volumeData, table.dataRange);
+    }
+    
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int bricksZ = (D + brickSize - 1) / brickSize;
+    table.stats.resize(static_cast<size_t>(bricksX) * bricksY * bricksZ);
+    float nearTolerance = kNearBackgroundFraction * table.dataRange;
+    {
+        PhaseProfiler::Scope phase(&profiler_, "decomposition");
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, table.stats.size()), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t b = r.begin(); b != r.end(); ++b) {
+                int x = static_cast<int>(b % bricksX) * brickSize;
+                int y = static_cast<int>((b / bricksX) % bricksY) * brickSize;
+                int z = static_cast<int>(b / (static_cast<size_t>(bricksX) * bricksY)) * brickSize;
+                table.stats[b] = computeBrickStats(
+                    volumeData.data(), W, H, x, y, z,
+                    std::min(brickSize, W - x), std::min(brickSize, H - y), std::min(brickSize, D - z),
+                    table.background, nearTolerance, full);
+            }
+        });
+    }
+    
+    if (!statsCache.empty()) {
+        table.write(statsCache);
+        std::cout << "Brick statistics saved to: " << statsCache << std::endl;
+    }
+    return table;
+}
+
+openvdb::FloatGrid::Ptr VDBCompressor::compressVTKVolumeStreaming(
+    const std::string& vtkFilename,
+    float quality,
+    int brickSize,
+    int metricType,
+    size_t maxMemoryBytes) {
+    
+    if (brickSize <= 0) {
+        throw std::runtime_error("Brick size autotuning is not available in streaming mode");
+    }
+    brickSize = alignBrickSize(brickSize);
+    if (adaptiveBackground_) {
+        throw std::runtime_error("Adaptive background is not available in streaming mode");
+    }
+    backgroundMap_ = BackgroundMap();
+    
+    // The background is only known after the first pass, so streaming ranks
+    // by the brick value range alone
+    std::shared_ptr<const BrickMetric> metric = resolveMetric(metricType);
+    if (metric->needsFullStats()) {
+        throw std::runtime_error(std::string("Metric '") + metric->name() + "' is not available in streaming mode");
+    }
+    
+    VTKSlabReader reader(vtkFilename);
+    int W = reader.width(), H = reader.height(), D = reader.depth();
+    
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int bricksZ = (D + brickSize - 1) / brickSize;
+    size_t totalBricks = static_cast<size_t>(bricksX) * bricksY * bricksZ;
+    size_t sliceVoxels = static_cast<size_t>(W) * H;
+    size_t totalVoxels = sliceVoxels * D;
+    
+    // Fixed working set: one float slab, the raw read buffer (which holds every
+    // component of each voxel) and the brick table
+    size_t rawVoxelBytes = reader.bytesPerValue() * reader.numComponents();
+    size_t slabBytes = sliceVoxels * brickSize * (sizeof(float) + rawVoxelBytes);
+    size_t tableBytes = totalBricks * (sizeof(Brick) + 1);
+    size_t fixedBytes = slabBytes + tableBytes;
+    if (maxMemoryBytes > 0 && fixedBytes > maxMemoryBytes) {
+        throw std::runtime_error("--max-memory too small: streaming needs at least " +
+                                 std::to_string(fixedBytes) + " bytes for brick size " +
+                                 std::to_string(brickSize));
+    }
+    
+    // The median background is estimated from a strided sample that fills
+    // whatever budget is left (capped at 16M values when unbounded)
+    size_t sampleCapacity = static_cast<size_t>(1) << 24;
+    if (maxMemoryBytes > 0) {
+        sampleCapacity = std::min(sampleCapacity, (maxMemoryBytes - fixedBytes) / sizeof(float));
+    }
+    sampleCapacity = std::max<size_t>(sampleCapacity, 1);
+    size_t sampleStride = (totalVoxels + sampleCapacity - 1) / sampleCapacity;
+    
+    std::cout << "Streaming " << W << "x" << H << "x" << D << " volume in "
+              << bricksZ << " slabs of " << brickSize << " slices" << std::endl;
+    
+    // Pass 1: brick ranges, background sample and corner values
+    PhaseProfiler::Scope statisticsPhase(&profiler_, "statistics_pass");
+    std::vector<Brick> bricks;
+    bricks.reserve(totalBricks);
+    std::vector<float> sample;
+    sample.reserve(totalVoxels / sampleStride + 1);
+    std::vector<float> slab;
+    float corners[8];
+    
+    for (int bz = 0; bz < bricksZ; ++bz) {
+        int z0 = bz * brickSize;
+        reader.readSlab(z0, brickSize, slab);
+        
+        for (int by = 0; by < bricksY; ++by) {
+            for (int bx = 0; bx < bricksX; ++bx) {
+                Brick brick;
+                brick.x = bx * brickSize;
+                brick.y = by * brickSize;
+                brick.z = z0;
+                BrickStats stats = computeBrickStats(
+                    slab.data(), W, H, brick.x, brick.y, 0,
+                    std::min(brickSize, W - brick.x), std::min(brickSize, H - brick.y),
+                    std::min(brickSize, D - z0), 0.0f, 0.0f, false);
+                brick.minVal = stats.minVal;
+                brick.maxVal = stats.maxVal;
+                bricks.push_back(brick);
+            }
+        }
+        
+        size_t base = sliceVoxels * z0;
+        size_t first = (sampleStride - base % sampleStride) % sampleStride;
+        for (size_t i = first; i < slab.size(); i += sampleStride) {
+            sample.push_back(slab[i]);
+        }
+        
+        size_t lastSlice = slab.size() - sliceVoxels;
+        if (z0 == 0) {
+            corners[0] = slab[0];
+            corners[1] = slab[W - 1];
+            corners[2] = slab[sliceVoxels - W];
+            corners[3] = slab[sliceVoxels - 1];
+        }
+        if (z0 + brickSize >= D) {
+            corners[4] = slab[lastSlice];
+            corners[5] = slab[lastSlice + W - 1];
+            corners[6] = slab[slab.size() - W];
+            corners[7] = slab[slab.size() - 1];
+        }
+    }
+    
+    statisticsPhase.close();
+    
+    // Median of the sample, selected in place to avoid a second copy
+    std::nth_element(sample.begin(), sample.begin() + sample.size() / 2, sample.end());
+    float background = sample[sample.size() / 2];
+    size_t peakBytes = fixedBytes + sample.capacity() * sizeof(float);
+    std::vector<float>().swap(sample);
+    
+    for (auto& brick : bricks) {
+        BrickStats stats;
+        stats.minVal = brick.minVal;
+        stats.maxVal = brick.maxVal;
+        brick.background = background;
+        brick.similarity = metric->score(stats, background);
+    }
+    
+    // Rank bricks and mark the selected ones by their position in the brick grid
+    if (metric->highestFirst()) {
+        std::sort(bricks.rbegin(), bricks.rend());
+    } else {
+        std::sort(bricks.begin(), bricks.end());
+    }
+    size_t bricksToActivate = std::min(totalBricks, static_cast<size_t>(totalBricks * quality));
+    std::vector<char> selected(totalBricks, 0);
+    std::vector<int> selectedPerSlab(bricksZ, 0);
+    for (size_t i = 0; i < bricksToActivate; ++i) {
+        int bx = bricks[i].x / brickSize, by = bricks[i].y / brickSize, bz = bricks[i].z / brickSize;
+        selected[(static_cast<size_t>(bz) * bricksY + by) * bricksX + bx] = 1;
+        selectedPerSlab[bz]++;
+    }
+    
+    std::cout << "Activating " << bricksToActivate << " out of " << totalBricks << " bricks" << std::endl;
+    std::cout << "Background value: " << background << std::endl;
+    
     openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create();
     grid->setGridClass(openvdb::GRID_FOG_VOLUME);
     grid->setName("compressed_volume");
+    grid->insertMeta("brick_size", openvdb::Int32Metadata(brickSize));
+    auto& tree = grid->tree();
+    
+    int cornerCoords[8][3] = {
+        {0, 0, 0}, {W-1, 0, 0}, {0, H-1, 0}, {W-1, H-1, 0},
+        {0, 0, D-1}, {W-1, 0, D-1}, {0, H-1, D-1}, {W-1, H-1, D-1}
+    };
+    for (int i = 0; i < 8; ++i) {
+        tree.setValue(openvdb::Coord(cornerCoords[i][0], cornerCoords[i][1], cornerCoords[i][2]), corners[i]);
+    }
+    
+    // Pass 2: re-read only the slabs that contain selected bricks
+    PhaseProfiler::Scope activationPhase(&profiler_, "activation_pass");
+    tileStats_ = TileStats();
+    for (int bz = 0; bz < bricksZ; ++bz) {
+        if (selectedPerSlab[bz] == 0) continue;
+        
+        int z0 = bz * brickSize;
+        reader.readSlab(z0, brickSize, slab);
+        
+        for (int by = 0; by < bricksY; ++by) {
+            for (int bx = 0; bx < bricksX; ++bx) {
+                if (!selected[(static_cast<size_t>(bz) * bricksY + by) * bricksX + bx]) continue;
+                
+                Brick brick;
+                brick.x = bx * brickSize;
+                brick.y = by * brickSize;
+                brick.z = z0;
+                activateBrick(tree, brick, slab, W, H, D, brickSize, z0);
+            }
+        }
+    }
+    
+    activationPhase.close();
+    
+    {
+        PhaseProfiler::Scope phase(&profiler_, "prune");
+        tree.prune();
+    }
+    std::cout << "Streaming working set: " << peakBytes << " bytes";
+    if (maxMemoryBytes > 0) {
+        std::cout << " (limit " << maxMemoryBytes << ")";
+    }
+    std::cout << std::endl;
+    std::cout << "Grid memory: " << grid->memUsage() << " bytes" << std::endl;
+    
+    return grid;
+}
+
+std::vector<openvdb::FloatGrid::Ptr> VDBCompressor::compressSequence(
+    size_t stepCount,
+    const VolumeSource& source,
+    float quality,
+    int brickSize,
+    int metricType,
+    int keyframeInterval,
+    float changeTolerance) {
+    
+    if (maxAbsError_ > 0.0f || targetPSNR_ > 0.0f) {
+        throw std::runtime_error("Sequence mode does not support error bounds");
+    }
+    std::vector<openvdb::FloatGrid::Ptr> steps;
+    std::shared_ptr<const BrickMetric> metric = resolveMetric(metricType);
+    SequenceState state;
+    int sinceKeyframe = 0;
+    size_t keyframes = 0;
+    size_t storedBricks = 0;
+    size_t totalBricks = 0;
+    
+    for (size_t t = 0; t < stepCount; ++t) {
+        int W, H, D;
+        std::vector<float> volumeData;
+        source(t, volumeData, W, H, D);
+        
+        bool keyframe = t == 0 || W != state.W || H != state.H || D != state.D ||
+                        (keyframeInterval > 0 && sinceKeyframe >= keyframeInterval);
+        openvdb::FloatGrid::Ptr grid;
+        size_t changed = 0;
+        if (keyframe) {
+            grid = compressVolume(volumeData, W, H, D, quality, brickSize, metricType);
+            
+            // Every brick of a keyframe is stored; remember what it holds
+            state.W = W;
+            state.H = H;
+            state.D = D;
+            state.brickSize = grid->metaValue<int>("brick_size");
+            state.fillValue = grid->background();
+            std::vector<Brick> bricks;
+            decomposeIntoBricks(bricks, volumeData, W, H, D, state.brickSize, selection_.background, *metric);
+            state.hashes.resize(bricks.size());
+            for (size_t i = 0; i < bricks.size(); ++i) {
+                state.hashes[i] = bricks[i].hash;
+            }
+            state.reference.swap(volumeData);
+            changed = bricks.size();
+            sinceKeyframe = 0;
+            ++keyframes;
+        } else {
+            grid = compressDeltaStep(state, volumeData, *metric, changeTolerance, changed);
+        }
+        ++sinceKeyframe;
+        storedBricks += changed;
+        totalBricks += state.hashes.size();
+        
+        std::string index = std::to_string(t);
+        grid->setName("compressed_volume_t" + std::string(index.size() < 4 ? 4 - index.size() : 0, '0') + index);
+        grid->insertMeta("sequence_step", openvdb::Int32Metadata(static_cast<int>(t)));
+        grid->insertMeta("sequence_keyframe", openvdb::BoolMetadata(keyframe));
+        grid->insertMeta("sequence_changed_bricks", openvdb::Int32Metadata(static_cast<int>(changed)));
+        steps.push_back(grid);
+    }
+    
+    for (auto& grid : steps) {
+        grid->insertMeta("sequence_length", openvdb::Int32Metadata(static_cast<int>(steps.size())));
+    }
+    std::cout << "Sequence: " << steps.size() << " steps, " << keyframes << " keyframes, "
+              << storedBricks << " of " << totalBricks << " bricks stored" << std::endl;
+    return steps;
+}
+
+openvdb::FloatGrid::Ptr VDBCompressor::compressDeltaStep(
+    SequenceState& state,
+    const std::vector<float>& volumeData,
+    const BrickMetric& metric,
+    float changeTolerance,
+    size_t& changedBricks) {
+    
+    PhaseProfiler::Scope phase(&profiler_, "delta_step");
+    int W = state.W, H = state.H, D = state.D;
+    int brickSize = state.brickSize;
+    
+    std::vector<Brick> bricks;
+    decomposeIntoBricks(bricks, volumeData, W, H, D, brickSize, selection_.background, metric);
+    
+    // Bricks are compared with the version last stored rather than the
+    // previous step, so slow drift cannot accumulate past the tolerance
+    std::vector<char> changed(bricks.size(), 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, bricks.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            const Brick& brick = bricks[i];
+            if (brick.hash == state.hashes[i]) {
+                continue;
+            }
+            if (changeTolerance > 0.0f &&
+                maxBrickDifference(brick, volumeData, state.reference, W, H, D, brickSize) <= changeTolerance) {
+                continue;
+            }
+            changed[i] = 1;
+            state.hashes[i] = brick.hash;
+            int nx = std::min(brickSize, W - brick.x);
+            for (int z = brick.z; z < std::min(brick.z + brickSize, D); ++z) {
+                for (int y = brick.y; y < std::min(brick.y + brickSize, H); ++y) {
+                    size_t row = static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W + brick.x;
+                    std::copy(&volumeData[row], &volumeData[row] + nx, &state.reference[row]);
+                }
+            }
+        }
+    });
+    
+    openvdb::FloatGrid::Ptr grid = openvdb::FloatGrid::create(state.fillValue);
+    grid->setGridClass(openvdb::GRID_FOG_VOLUME);
+    auto& tree = grid->tree();
+    
+    tileStats_ = TileStats();
+    float requestedTolerance = tileTolerance_;
+    if (maxAbsError_ > 0.0f) {
+        tileTolerance_ = std::min(tileTolerance_, maxAbsError_);
+    }
+    if (targetPSNR_ > 0.0f) {
+        // The brick selection has spent the error budget; only exactly
+        // constant regions may still become tiles
+        tileTolerance_ = std::min(tileTolerance_, 0.0f);
+    }
+    size_t activated = 0;
+    changedBricks = 0;
+    std::vector<size_t> cleared;
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        if (!changed[i]) continue;
+        
+        const Brick& brick = bricks[i];
+        ++changedBricks;
+        if (selection_.selects(brick.similarity)) {
+            activateBrick(tree, brick, volumeData, W, H, D, brickSize);
+            ++activated;
+        } else {
+            cleared.push_back(i);
+            openvdb::Coord hi(std::min(brick.x + brickSize, W) - 1, std::min(brick.y + brickSize, H) - 1,
+                              std::min(brick.z + brickSize, D) - 1);
+            float fill = backgroundMap_.empty() ? state.fillValue : brick.background;
+            tree.fill(openvdb::CoordBBox(openvdb::Coord(brick.x, brick.y, brick.z), hi), fill, true);
+        }
+    }
+    tileTolerance_ = requestedTolerance;
+    
+    // Extreme corners stay active as in the keyframe
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int corners[8][3] = {
+        {0, 0, 0}, {W-1, 0, 0}, {0, H-1, 0}, {W-1, H-1, 0},
+        {0, 0, D-1}, {W-1, 0, D-1}, {0, H-1, D-1}, {W-1, H-1, D-1}
+    };
+    for (int i = 0; i < 8; ++i) {
+        int x = corners[i][0], y = corners[i][1], z = corners[i][2];
+        size_t brick = (static_cast<size_t>(z / brickSize) * bricksY + y / brickSize) * bricksX + x / brickSize;
+        if (changed[brick]) {
+            tree.setValue(openvdb::Coord(x, y, z), volumeData[static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W + x]);
+        }
+    }
+    
+    tree.prune();
+    grid->insertMeta("brick_size", openvdb::Int32Metadata(brickSize));
+    grid->insertMeta("sequence_volume_size", openvdb::Vec3IMetadata(openvdb::Vec3i(W, H, D)));
+    grid->insertMeta("sequence_cleared", openvdb::StringMetadata(encodeIndexRanges(cleared)));
+    std::cout << "Changed bricks: " << changedBricks << " of " << bricks.size() << " (" << activated
+              << " active, " << (changedBricks - activated) << " cleared)" << std::endl;
+    std::cout << "Grid memory: " << grid->memUsage() << " bytes" << std::endl;
+    return grid;
+}
+
+float VDBCompressor::maxBrickDifference(
+    const Brick& brick,
+    const std::vector<float>& volumeData,
+    const std::vector<float>& referenceData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    float maxDiff = 0.0f;
+    int nx = std::min(brickSize, W - brick.x);
+    for (int z = brick.z; z < std::min(brick.z + brickSize, D); ++z) {
+        for (int y = brick.y; y < std::min(brick.y + brickSize, H); ++y) {
+            size_t row = static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W + brick.x;
+            for (int x = 0; x < nx; ++x) {
+                maxDiff = std::max(maxDiff, std::abs(volumeData[row + x] - referenceData[row + x]));
+            }
+        }
+    }
+    return maxDiff;
+}
+
+openvdb::FloatGrid::Ptr VDBCompressor::composeSequenceStep(
+    const std::vector<openvdb::FloatGrid::Ptr>& steps,
+    size_t step) {
+    
+    if (step >= steps.size()) {
+        throw std::runtime_error("Sequence step " + std::to_string(step) + " out of range");
+    }
+    size_t keyframe = step;
+    while (keyframe > 0 && !steps[keyframe]->metaValue<bool>("sequence_keyframe")) {
+        --keyframe;
+    }
+    
+    openvdb::FloatGrid::Ptr grid = steps[keyframe]->deepCopy();
+    openvdb::FloatTree& tree = grid->tree();
+    openvdb::tree::ValueAccessor<openvdb::FloatTree> acc(tree);
+    for (size_t t = keyframe + 1; t <= step; ++t) {
+        const openvdb::FloatTree& delta = steps[t]->tree();
+        for (auto it = delta.cbeginValueOn(); it; ++it) {
+            if (it.isVoxelValue()) {
+                acc.setValueOn(it.getCoord(), *it);
+            } else {
+                openvdb::CoordBBox bbox;
+                it.getBoundingBox(bbox);
+                tree.fill(bbox, *it, true);
+            }
+        }
+        
+        // Cleared bricks are stored as active fill so that they overwrite
+        // the older values; the step lists them so they read back inactive
+        if (!steps[t]->getMetadata<openvdb::StringMetadata>("sequence_cleared")) {
+            continue;
+        }
+        int brickSize = steps[t]->metaValue<int>("brick_size");
+        openvdb::Vec3i size = steps[t]->metaValue<openvdb::Vec3i>("sequence_volume_size");
+        int bricksX = (size.x() + brickSize - 1) / brickSize;
+        int bricksY = (size.y() + brickSize - 1) / brickSize;
+        for (size_t b : decodeIndexRanges(steps[t]->metaValue<std::string>("sequence_cleared"))) {
+            openvdb::Coord lo(static_cast<int>(b % bricksX) * brickSize,
+                              static_cast<int>((b / bricksX) % bricksY) * brickSize,
+                              static_cast<int>(b / (static_cast<size_t>(bricksX) * bricksY)) * brickSize);
+            openvdb::Coord hi(std::min(lo.x() + brickSize, size.x()) - 1, std::min(lo.y() + brickSize, size.y()) - 1,
+                              std::min(lo.z() + brickSize, size.z()) - 1);
+            tree.fill(openvdb::CoordBBox(lo, hi), delta.getValue(lo), false);
+        }
+    }
+    tree.prune();
+    grid->setName(steps[step]->getName());
+    return grid;
+}
+
+std::vector<openvdb::FloatGrid::Ptr> VDBCompressor::buildLodPyramid(
+    openvdb::FloatGrid::Ptr grid,
+    int levels) {
+    
+    std::vector<openvdb::FloatGrid::Ptr> pyramid;
+    pyramid.push_back(grid);
+    for (int level = 1; level <= levels; ++level) {
+        openvdb::FloatGrid::Ptr coarse = restrictGrid(*pyramid.back());
+        if (coarse->activeVoxelCount() == 0) {
+            break;
+        }
+        coarse->setName(grid->getName() + "_lod" + std::to_string(level));
+        pyramid.push_back(coarse);
+    }
+    
+    int count = static_cast<int>(pyramid.size());
+    for (int level = 0; level < count; ++level) {
+        pyramid[level]->insertMeta("lod_level", openvdb::Int32Metadata(level));
+        pyramid[level]->insertMeta("lod_scale", openvdb::Int32Metadata(1 << level));
+        pyramid[level]->insertMeta("lod_levels", openvdb::Int32Metadata(count));
+        std::cout << "LOD " << level << ": " << pyramid[level]->activeVoxelCount() << " active voxels, "
+                  << pyramid[level]->memUsage() << " bytes" << std::endl;
+    }
+    return pyramid;
+}
+
+openvdb::FloatGrid::Ptr VDBCompressor::restrictGrid(const openvdb::FloatGrid& fine) {
+    typedef openvdb::FloatTree::LeafNodeType LeafT;
+    const int leafMask = ~(static_cast<int>(LeafT::DIM) - 1);
+    const openvdb::FloatTree& fineTree = fine.tree();
     
-    // Compute background value using histogram
-    float background = computeBackgroundValue(volumeData);
+    openvdb::FloatGrid::Ptr coarse = openvdb::FloatGrid::create(fine.background());
+    coarse->setGridClass(fine.getGridClass());
+    for (auto it = fine.beginMeta(); it != fine.endMeta(); ++it) {
+        coarse->insertMeta(it->first, *it->second);
+    }
+    // Coarse voxel c covers fine voxels 2c and 2c + 1, centred at 2c + 0.5
+    openvdb::math::Transform::Ptr xform = fine.transform().copy();
+    xform->preScale(2.0);
+    xform->preTranslate(openvdb::Vec3d(0.25, 0.25, 0.25));
+    coarse->setTransform(xform);
     
-    // FIX: Use insertMeta("background", ...) instead of setBackground()
-    // The background is automatically set when we create the grid
-    // We'll handle background during the compression algorithm
+    // Group the (up to 8) fine leaves that restrict into each coarse leaf
+    std::vector<const LeafT*> fineLeaves;
+    fineTree.getNodes(fineLeaves);
+    auto coarseOrigin = [leafMask](const LeafT* leaf) {
+        const openvdb::Coord& o = leaf->origin();
+        return openvdb::Coord((o.x() >> 1) & leafMask, (o.y() >> 1) & leafMask, (o.z() >> 1) & leafMask);
+    };
+    std::sort(fineLeaves.begin(), fineLeaves.end(), [&](const LeafT* a, const LeafT* b) {
+        return coarseOrigin(a) < coarseOrigin(b);
+    });
+    std::vector<size_t> groupStart;
+    for (size_t i = 0; i < fineLeaves.size(); ++i) {
+        if (i == 0 || coarseOrigin(fineLeaves[i]) != coarseOrigin(fineLeaves[i - 1])) {
+            groupStart.push_back(i);
+        }
+    }
+    groupStart.push_back(fineLeaves.size());
     
-    // Apply fixed-rate compression algorithm
-    applyCompressionAlgorithm(grid, volumeData, W, H, D, background, quality, brickSize, metricType);
+    // Each coarse leaf averages the active fine voxels of its 2^3 cells
+    std::vector<LeafT*> coarseLeaves(groupStart.size() - 1, nullptr);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, coarseLeaves.size()), [&](const tbb::blocked_range<size_t>& r) {
+        std::vector<float> sum(LeafT::SIZE);
+        std::vector<int> count(LeafT::SIZE);
+        for (size_t g = r.begin(); g != r.end(); ++g) {
+            openvdb::Coord origin = coarseOrigin(fineLeaves[groupStart[g]]);
+            std::fill(sum.begin(), sum.end(), 0.0f);
+            std::fill(count.begin(), count.end(), 0);
+            for (size_t i = groupStart[g]; i < groupStart[g + 1]; ++i) {
+                const LeafT* leaf = fineLeaves[i];
+                for (auto v = leaf->cbeginValueOn(); v; ++v) {
+                    const openvdb::Coord xyz = v.getCoord();
+                    openvdb::Coord c((xyz.x() >> 1) - origin.x(), (xyz.y() >> 1) - origin.y(), (xyz.z() >> 1) - origin.z());
+                    openvdb::Index offset = LeafT::coordToOffset(c);
+                    sum[offset] += *v;
+                    count[offset]++;
+                }
+            }
+            LeafT* leaf = new LeafT(origin, fine.background(), false);
+            for (openvdb::Index n = 0; n < LeafT::SIZE; ++n) {
+                if (count[n] > 0) {
+                    leaf->setValueOn(n, sum[n] / count[n]);
+                }
+            }
+            coarseLeaves[g] = leaf;
+        }
+    });
     
-    return grid;
+    openvdb::FloatTree& coarseTree = coarse->tree();
+    for (LeafT* leaf : coarseLeaves) {
+        coarseTree.addLeaf(leaf);
+    }
+    
+    // Active tiles (leaf and internal node sized) stay tiles at half extent
+    openvdb::FloatTree::ValueOnCIter tile = fineTree.cbeginValueOn();
+    tile.setMaxDepth(openvdb::FloatTree::ValueOnCIter::LEAF_DEPTH - 1);
+    for (; tile; ++tile) {
+        openvdb::CoordBBox bbox;
+        tile.getBoundingBox(bbox);
+        const openvdb::Coord& lo = bbox.min();
+        const openvdb::Coord& hi = bbox.max();
+        coarseTree.fill(openvdb::CoordBBox(openvdb::Coord(lo.x() >> 1, lo.y() >> 1, lo.z() >> 1),
+                                           openvdb::Coord(hi.x() >> 1, hi.y() >> 1, hi.z() >> 1)),
+                        *tile, true);
+    }
+    coarseTree.prune();
+    return coarse;
 }
 
-float VDBCompressor::computeBackgroundValue(const std::vector<float>& data) {
+float VDBCompressor::computeBackgroundValue(const std::vector<float>& data, float& dataRange) {
     std::vector<float> sortedData = data;
     std::sort(sortedData.begin(), sortedData.end());
+    dataRange = sortedData.back() - sortedData.front();
     return sortedData[sortedData.size() / 2];
 }
 
+void VDBCompressor::estimateRegionBackgrounds(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize,
+    float background) {
+    
+    // Regions are internal nodes, or whole bricks when those are larger, so
+    // every brick has exactly one local background
+    BackgroundMap& map = backgroundMap_;
+    map.regionDim = std::max(kInternalDim, brickSize);
+    map.regionsX = (W + map.regionDim - 1) / map.regionDim;
+    map.regionsY = (H + map.regionDim - 1) / map.regionDim;
+    map.regionsZ = (D + map.regionDim - 1) / map.regionDim;
+    map.values.assign(static_cast<size_t>(map.regionsX) * map.regionsY * map.regionsZ, background);
+    
+    // Median of a strided sample per region; medians within the near-
+    // background tolerance of the global one keep the global value
+    int stride = std::max(1, map.regionDim / kRegionSampleDim);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, map.values.size()), [&](const tbb::blocked_range<size_t>& r) {
+        std::vector<float> sample;
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            int x0 = static_cast<int>(i % map.regionsX) * map.regionDim;
+            int y0 = static_cast<int>((i / map.regionsX) % map.regionsY) * map.regionDim;
+            int z0 = static_cast<int>(i / (static_cast<size_t>(map.regionsX) * map.regionsY)) * map.regionDim;
+            sample.clear();
+            for (int z = z0; z < std::min(z0 + map.regionDim, D); z += stride) {
+                for (int y = y0; y < std::min(y0 + map.regionDim, H); y += stride) {
+                    const float* row = &volumeData[static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W];
+                    for (int x = x0; x < std::min(x0 + map.regionDim, W); x += stride) {
+                        sample.push_back(row[x]);
+                    }
+                }
+            }
+            std::nth_element(sample.begin(), sample.begin() + sample.size() / 2, sample.end());
+            float median = sample[sample.size() / 2];
+            if (std::abs(median - background) > nearBackgroundTolerance_) {
+                map.values[i] = median;
+            }
+        }
+    });
+    
+    size_t local = 0;
+    for (float value : map.values) {
+        local += value != background;
+    }
+    auto range = std::minmax_element(map.values.begin(), map.values.end());
+    std::cout << "Adaptive background: " << local << " of " << map.values.size() << " regions of "
+              << map.regionDim << "^3 use a local value (" << *range.first << " to " << *range.second << ")" << std::endl;
+}
+
+void VDBCompressor::addRegionBackgroundTiles(openvdb::FloatTree& tree, float background) {
+    // One inactive internal-node tile per 128^3 block of a region; voxels
+    // activated later are inserted below it and their leaves start out
+    // filled with the local background
+    const BackgroundMap& map = backgroundMap_;
+    for (int rz = 0; rz < map.regionsZ; ++rz) {
+        for (int ry = 0; ry < map.regionsY; ++ry) {
+            for (int rx = 0; rx < map.regionsX; ++rx) {
+                float value = map.values[(static_cast<size_t>(rz) * map.regionsY + ry) * map.regionsX + rx];
+                if (value == background) continue;
+                for (int z = 0; z < map.regionDim; z += kInternalDim) {
+                    for (int y = 0; y < map.regionDim; y += kInternalDim) {
+                        for (int x = 0; x < map.regionDim; x += kInternalDim) {
+                            tree.addTile(2, openvdb::Coord(rx * map.regionDim + x, ry * map.regionDim + y,
+                                                           rz * map.regionDim + z), value, false);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
 void VDBCompressor::applyCompressionAlgorithm(
     openvdb::FloatGrid::Ptr grid,
     const std::vector<float>& volumeData,
@@ -87,35 +1044,434 @@ void VDBCompressor::applyCompressionAlgorithm(
     float background,
     float quality,
     int brickSize,
-    int metricType) {
+    const BrickMetric& metric) {
     
     auto& tree = grid->tree();
     
     // Phase 1: Create brick decomposition
     std::vector<Brick> bricks;
-    decomposeIntoBricks(bricks, volumeData, W, H, D, brickSize, background, metricType);
+    {
+        PhaseProfiler::Scope phase(&profiler_, "decomposition");
+        decomposeIntoBricks(bricks, volumeData, W, H, D, brickSize, background, metric);
+    }
+    
+    bool errorBounded = maxAbsError_ > 0.0f || targetPSNR_ > 0.0f;
+    bool sizeTargeted = targetBytes_ > 0;
     
     // Phase 2: Sort bricks by similarity to background
-    std::sort(bricks.begin(), bricks.end());
+    {
+        PhaseProfiler::Scope phase(&profiler_, "sort");
+        if (errorBounded || sizeTargeted) {
+            // Least background-like first, so every activation removes the most error
+            if (errorBounded) {
+                for (auto& brick : bricks) {
+                    computeBrickError(brick, volumeData, W, H, D, brickSize);
+                }
+            }
+            std::sort(bricks.rbegin(), bricks.rend());
+        } else if (metric.highestFirst()) {
+            std::sort(bricks.rbegin(), bricks.rend());
+        } else {
+            std::sort(bricks.begin(), bricks.end());
+        }
+    }
     
-    // Phase 3: Activate bricks based on quality parameter
+    // Phase 3: Activate bricks based on quality parameter or error bound
     int totalBricks = bricks.size();
     int bricksToActivate = static_cast<int>(totalBricks * quality);
     
-    std::cout << "Activating " << bricksToActivate << " out of " << totalBricks << " bricks" << std::endl;
-    std::cout << "Background value: " << background << std::endl;
+    size_t totalVoxels = static_cast<size_t>(W) * H * D;
+    float dataMin = std::numeric_limits<float>::max();
+    float dataMax = std::numeric_limits<float>::lowest();
+    for (const auto& brick : bricks) {
+        dataMin = std::min(dataMin, brick.minVal);
+        dataMax = std::max(dataMax, brick.maxVal);
+    }
+    if (errorBounded) {
+        bricksToActivate = selectBricksForErrorBound(bricks, totalVoxels, dataMax - dataMin);
+    }
+    if (errorBounded || !backgroundMap_.empty()) {
+        // Inactive voxels must read back as the background the ranking assumed
+        openvdb::tools::changeBackground(tree, background);
+        if (!backgroundMap_.empty()) {
+            addRegionBackgroundTiles(tree, background);
+        }
+    }
     
+    PhaseProfiler::Scope activationPhase(&profiler_, "activation");
     // Always activate extreme corners first
     activateExtremeCorners(tree, volumeData, W, H, D);
     
-    // Activate selected bricks
+    SizeModel sizeModel;
+    if (sizeTargeted) {
+        sizeModel = buildSizeModel(grid, bricks, volumeData, W, H, D, brickSize);
+        bricksToActivate = sizeModel.count(targetBytes_);
+    }
+    
+    std::cout << "Activating " << bricksToActivate << " out of " << totalBricks << " bricks" << std::endl;
+    std::cout << "Background value: " << background << std::endl;
+    
+    // Activate selected bricks, near-constant regions as tiles
+    tileStats_ = TileStats();
+    float requestedTolerance = tileTolerance_;
+    if (maxAbsError_ > 0.0f) {
+        tileTolerance_ = std::min(tileTolerance_, maxAbsError_);
+    }
+    if (targetPSNR_ > 0.0f) {
+        // The brick selection has spent the error budget; only exactly
+        // constant regions may still become tiles
+        tileTolerance_ = std::min(tileTolerance_, 0.0f);
+    }
+    std::vector<char> covered(totalBricks, 0);
+    activateNodeTiles(tree, bricks, bricksToActivate, volumeData, W, H, D, brickSize, covered);
     for (int i = 0; i < bricksToActivate && i < totalBricks; ++i) {
-        activateBrick(tree, bricks[i], volumeData, W, H, D, brickSize);
+        if (!covered[i]) {
+            activateBrick(tree, bricks[i], volumeData, W, H, D, brickSize);
+        }
+    }
+    
+    if (sizeTargeted) {
+        bricksToActivate = refineToTargetSize(grid, sizeModel, bricks, bricksToActivate,
+                                              volumeData, W, H, D, brickSize);
+    }
+    
+    tileTolerance_ = requestedTolerance;
+    activationPhase.close();
+    
+    int lastActive = std::min(bricksToActivate, totalBricks) - 1;
+    selection_.background = background;
+    selection_.highFirst = errorBounded || sizeTargeted || metric.highestFirst();
+    if (lastActive >= 0) {
+        selection_.threshold = bricks[lastActive].similarity;
+    } else {
+        selection_.threshold = selection_.highFirst ? std::numeric_limits<double>::infinity()
+                                                    : -std::numeric_limits<double>::infinity();
+    }
+    
+    {
+        PhaseProfiler::Scope phase(&profiler_, "brick_codecs");
+        if (quantizeBits_ >= 0) {
+            encodeQuantizedBricks(bricks, bricksToActivate, volumeData, W, H, D, brickSize,
+                                  errorBounded ? background : tree.background());
+        }
+        if (containerEnabled_) {
+            // Only the container shares payloads between identical bricks
+            std::vector<int> duplicateOf = findDuplicateBricks(bricks, bricksToActivate, volumeData, W, H, D, brickSize);
+            buildBrickContainer(bricks, bricksToActivate, duplicateOf, volumeData, W, H, D, brickSize,
+                                errorBounded ? background : tree.background());
+        }
     }
     
     // Optimize memory
-    tree.prune();
+    {
+        PhaseProfiler::Scope phase(&profiler_, "prune");
+        tree.prune();
+    }
+    grid->insertMeta("brick_size", openvdb::Int32Metadata(brickSize));
+    if (!backgroundMap_.empty()) {
+        grid->insertMeta("adaptive_background_region", openvdb::Int32Metadata(backgroundMap_.regionDim));
+    }
+    if (tileStats_.leafTiles > 0 || tileStats_.nodeTiles > 0) {
+        std::cout << "Constant regions as tiles: " << tileStats_.leafTiles << " leaf, "
+                  << tileStats_.nodeTiles << " internal node (max error " << tileStats_.maxError << ")" << std::endl;
+    }
     std::cout << "Grid memory: " << grid->memUsage() << " bytes" << std::endl;
+    
+    if (errorBounded) {
+        // Activated voxels are exact, so the error comes from the rest and tiles
+        float maxError = tileStats_.maxError;
+        double sumSqError = tileStats_.sumSqError;
+        for (int i = bricksToActivate; i < totalBricks; ++i) {
+            maxError = std::max(maxError, bricks[i].maxError);
+            sumSqError += bricks[i].sumSqError;
+        }
+        double rmse = std::sqrt(sumSqError / totalVoxels);
+        double range = dataMax - dataMin;
+        double psnr = (rmse > 0.0 && range > 0.0) ? 20.0 * std::log10(range / rmse)
+                                                  : std::numeric_limits<double>::infinity();
+        double ratio = static_cast<double>(totalVoxels * sizeof(float)) / grid->memUsage();
+        
+        std::cout << "=== Error Report ===" << std::endl;
+        std::cout << "Max abs error: " << maxError;
+        if (maxAbsError_ > 0.0f) std::cout << " (bound " << maxAbsError_ << ")";
+        std::cout << std::endl;
+        std::cout << "RMSE: " << rmse << std::endl;
+        std::cout << "PSNR: " << psnr << " dB";
+        if (targetPSNR_ > 0.0f) std::cout << " (target " << targetPSNR_ << " dB)";
+        std::cout << std::endl;
+        std::cout << "Compression ratio: " << ratio << ":1 (vs dense float)" << std::endl;
+        
+        grid->insertMeta("background", openvdb::FloatMetadata(background));
+        grid->insertMeta("max_abs_error", openvdb::FloatMetadata(maxError));
+        grid->insertMeta("psnr", openvdb::FloatMetadata(static_cast<float>(psnr)));
+    }
+}
+
+int VDBCompressor::SizeModel::count(size_t targetBytes) const {
+    if (targetBytes <= baseBytes || cumulativeVoxels.empty()) {
+        return 0;
+    }
+    size_t voxelBudget = static_cast<size_t>((targetBytes - baseBytes) / bytesPerVoxel);
+    // Largest prefix of the ranking whose voxels fit in the budget
+    auto it = std::upper_bound(cumulativeVoxels.begin(), cumulativeVoxels.end(), voxelBudget);
+    return static_cast<int>(it - cumulativeVoxels.begin()) - 1;
+}
+
+size_t VDBCompressor::SizeModel::predict(int count) const {
+    return baseBytes + static_cast<size_t>(cumulativeVoxels[count] * bytesPerVoxel);
+}
+
+VDBCompressor::SizeModel VDBCompressor::buildSizeModel(
+    openvdb::FloatGrid::Ptr grid,
+    const std::vector<Brick>& bricks,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    SizeModel model;
+    model.cumulativeVoxels.resize(bricks.size() + 1, 0);
+    for (size_t i = 0; i < bricks.size(); ++i) {
+        const Brick& b = bricks[i];
+        size_t voxels = static_cast<size_t>(std::min(brickSize, W - b.x)) *
+                        std::min(brickSize, H - b.y) * std::min(brickSize, D - b.z);
+        model.cumulativeVoxels[i + 1] = model.cumulativeVoxels[i] + voxels;
+    }
+    model.baseBytes = serializedGridSize(grid);
+    
+    // Calibrate bytes per voxel (file compression, node overhead) by writing
+    // a trial grid holding a spread-out sample of the bricks likely selected
+    int estimate = model.count(targetBytes_);
+    if (estimate > 0) {
+        openvdb::FloatGrid::Ptr trial = grid->deepCopy();
+        int step = std::max(1, estimate / kCalibrationBricks);
+        size_t sampledVoxels = 0;
+        for (int i = 0; i < estimate; i += step) {
+            activateBrick(trial->tree(), bricks[i], volumeData, W, H, D, brickSize);
+            sampledVoxels += model.cumulativeVoxels[i + 1] - model.cumulativeVoxels[i];
+        }
+        trial->tree().prune();
+        size_t trialBytes = serializedGridSize(trial);
+        if (trialBytes > model.baseBytes && sampledVoxels > 0) {
+            model.bytesPerVoxel = static_cast<double>(trialBytes - model.baseBytes) / sampledVoxels;
+        }
+    }
+    return model;
+}
+
+int VDBCompressor::refineToTargetSize(
+    openvdb::FloatGrid::Ptr grid,
+    SizeModel& model,
+    const std::vector<Brick>& bricks,
+    int activeBricks,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    auto& tree = grid->tree();
+    size_t predicted = model.predict(activeBricks);
+    size_t actual = 0;
+    bool measured = false;
+    
+    // Refit the model to the measured size and add or remove ranked bricks in
+    // place; the tree is never rebuilt from scratch
+    for (int iteration = 0; iteration < 4; ++iteration) {
+        tree.prune();
+        actual = serializedGridSize(grid);
+        measured = true;
+        double deviation = std::abs(static_cast<double>(actual) - targetBytes_) / targetBytes_;
+        if (deviation <= kTargetSizeTolerance || model.cumulativeVoxels[activeBricks] == 0) {
+            break;
+        }
+        
+        if (actual > model.baseBytes) {
+            model.bytesPerVoxel = static_cast<double>(actual - model.baseBytes) /
+                                  model.cumulativeVoxels[activeBricks];
+        }
+        int corrected = model.count(targetBytes_);
+        if (corrected == activeBricks) {
+            break;
+        }
+        
+        for (int i = activeBricks; i < corrected; ++i) {
+            activateBrick(tree, bricks[i], volumeData, W, H, D, brickSize);
+        }
+        for (int i = corrected; i < activeBricks; ++i) {
+            const Brick& b = bricks[i];
+            openvdb::CoordBBox bbox(
+                openvdb::Coord(b.x, b.y, b.z),
+                openvdb::Coord(std::min(b.x + brickSize, W) - 1,
+                               std::min(b.y + brickSize, H) - 1,
+                               std::min(b.z + brickSize, D) - 1));
+            // Regions with a local background keep it where the brick was
+            tree.fill(bbox, backgroundMap_.empty() ? tree.background() : b.background, false);
+        }
+        activateExtremeCorners(tree, volumeData, W, H, D);
+        activeBricks = corrected;
+        measured = false;
+    }
+    if (!measured) {
+        // The last correction has not been measured yet
+        tree.prune();
+        actual = serializedGridSize(grid);
+    }
+    
+    double deviation = 100.0 * (static_cast<double>(actual) - targetBytes_) / targetBytes_;
+    std::cout << "Target size: " << targetBytes_ << " bytes, predicted " << predicted
+              << ", written " << actual << " (" << (deviation >= 0 ? "+" : "") << deviation
+              << "%)" << std::endl;
+    return activeBricks;
+}
+
+void VDBCompressor::encodeQuantizedBricks(
+    const std::vector<Brick>& bricks,
+    int bricksToActivate,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize,
+    float background) {
+    
+    QuantizedBrickCodec codec(quantizeBits_, quantizeError_);
+    int count = std::min(bricksToActivate, static_cast<int>(bricks.size()));
+    
+    quantizedStream_ = QuantizedBrickStream();
+    quantizedStream_.W = W;
+    quantizedStream_.H = H;
+    quantizedStream_.D = D;
+    quantizedStream_.brickSize = brickSize;
+    quantizedStream_.background = background;
+    quantizedStream_.bricks.resize(count);
+    
+    // Bricks are independent, so encode them in parallel
+    tbb::parallel_for(tbb::blocked_range<int>(0, count), [&](const tbb::blocked_range<int>& r) {
+        for (int i = r.begin(); i != r.end(); ++i) {
+            const Brick& b = bricks[i];
+            quantizedStream_.bricks[i] = codec.encode(volumeData, W, H, D, b.x, b.y, b.z,
+                                                      brickSize, b.minVal, b.maxVal);
+        }
+    });
+    
+    size_t byBits[4] = {0, 0, 0, 0};
+    size_t floatBytes = 0;
+    for (const auto& qb : quantizedStream_.bricks) {
+        byBits[qb.bits / 8 > 2 ? 3 : qb.bits / 8]++;
+        floatBytes += static_cast<size_t>(qb.nx) * qb.ny * qb.nz * sizeof(float);
+    }
+    size_t streamBytes = quantizedStream_.byteSize();
+    std::cout << "Quantized bricks: " << byBits[0] << " constant, " << byBits[1] << " 8-bit, "
+              << byBits[2] << " 16-bit, " << byBits[3] << " raw" << std::endl;
+    std::cout << "Quantized stream: " << streamBytes << " bytes ("
+              << (streamBytes > 0 ? static_cast<double>(floatBytes) / streamBytes : 0.0)
+              << ":1 vs float bricks)" << std::endl;
+}
+
+void VDBCompressor::buildBrickContainer(
+    const std::vector<Brick>& bricks,
+    int bricksToActivate,
+    const std::vector<int>& duplicateOf,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize,
+    float background) {
+    
+    int count = std::min(bricksToActivate, static_cast<int>(bricks.size()));
+    
+    // Store bricks in z/y/x order so neighbouring bricks are close in the file
+    std::vector<int> order(count);
+    for (int i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&bricks](int a, int b) {
+        const Brick& ba = bricks[a];
+        const Brick& bb = bricks[b];
+        if (ba.z != bb.z) return ba.z < bb.z;
+        if (ba.y != bb.y) return ba.y < bb.y;
+        return ba.x < bb.x;
+    });
+    
+    // The first occurrence of each content in file order carries the
+    // payload; later copies reference it from the directory
+    std::vector<int> payloadSlot(count, -1);
+    std::vector<int> unique;
+    std::vector<int> copies;
+    for (int i = 0; i < count; ++i) {
+        int& slot = payloadSlot[duplicateOf[order[i]]];
+        if (slot < 0) {
+            slot = i;
+            unique.push_back(i);
+        } else {
+            copies.push_back(i);
+        }
+    }
+    
+    container_ = std::make_shared<BrickContainerWriter>(W, H, D, brickSize, background, containerCompression_);
+    container_->resize(count);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, unique.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t u = r.begin(); u != r.end(); ++u) {
+            int i = unique[u];
+            const Brick& b = bricks[order[i]];
+            container_->setBrick(i, volumeData, b.x, b.y, b.z, b.minVal, b.maxVal);
+        }
+    });
+    for (int i : copies) {
+        const Brick& b = bricks[order[i]];
+        container_->setDuplicate(i, payloadSlot[duplicateOf[order[i]]], b.x, b.y, b.z);
+    }
+    
+    std::cout << "Brick container: " << count << " bricks (" << unique.size() << " payloads), "
+              << container_->byteSize() << " bytes (" << brickCompressionName(containerCompression_) << ")" << std::endl;
+}
+
+void VDBCompressor::computeBrickError(
+    Brick& brick,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    float background = brick.background;
+    brick.maxError = std::max(std::abs(brick.minVal - background), std::abs(brick.maxVal - background));
+    brick.sumSqError = 0.0;
+    
+    for (int z = brick.z; z < std::min(brick.z + brickSize, D); ++z) {
+        for (int y = brick.y; y < std::min(brick.y + brickSize, H); ++y) {
+            for (int x = brick.x; x < std::min(brick.x + brickSize, W); ++x) {
+                size_t idx = static_cast<size_t>(z) * W * H + y * W + x;
+                double diff = volumeData[idx] - background;
+                brick.sumSqError += diff * diff;
+            }
+        }
+    }
+}
+
+int VDBCompressor::selectBricksForErrorBound(
+    const std::vector<Brick>& bricks,
+    size_t totalVoxels,
+    float dataRange) {
+    
+    int totalBricks = bricks.size();
+    
+    // remainingMax[i] is the max error if bricks [0, i) are activated
+    std::vector<float> remainingMax(totalBricks + 1, 0.0f);
+    double remainingSqError = 0.0;
+    for (int i = totalBricks - 1; i >= 0; --i) {
+        remainingMax[i] = std::max(remainingMax[i + 1], bricks[i].maxError);
+        remainingSqError += bricks[i].sumSqError;
+    }
+    
+    // Walk the ranking, removing each brick's error contribution as it is activated
+    for (int i = 0; i < totalBricks; ++i) {
+        bool maxOk = maxAbsError_ <= 0.0f || remainingMax[i] <= maxAbsError_;
+        bool psnrOk = true;
+        if (targetPSNR_ > 0.0f && remainingSqError > 0.0) {
+            double mse = remainingSqError / totalVoxels;
+            psnrOk = dataRange > 0.0f &&
+                     10.0 * std::log10(static_cast<double>(dataRange) * dataRange / mse) >= targetPSNR_;
+        }
+        if (maxOk && psnrOk) {
+            return i;
+        }
+        remainingSqError = std::max(0.0, remainingSqError - bricks[i].sumSqError);
+    }
+    return totalBricks;
 }
 
 void VDBCompressor::decomposeIntoBricks(
@@ -124,61 +1480,132 @@ void VDBCompressor::decomposeIntoBricks(
     int W, int H, int D,
     int brickSize,
     float background,
-    int metricType) {
+    const BrickMetric& metric) {
     
+    bool full = metric.needsFullStats();
     int bricksX = (W + brickSize - 1) / brickSize;
     int bricksY = (H + brickSize - 1) / brickSize;
     int bricksZ = (D + brickSize - 1) / brickSize;
     
-    for (int bz = 0; bz < bricksZ; ++bz) {
-        for (int by = 0; by < bricksY; ++by) {
-            for (int bx = 0; bx < bricksX; ++bx) {
-                Brick brick;
-                brick.x = bx * brickSize;
-                brick.y = by * brickSize;
-                brick.z = bz * brickSize;
-                
-                computeBrickRange(brick, volumeData, W, H, D, brickSize);
-                brick.similarity = computeSimilarity(brick.minVal, brick.maxVal, background, metricType);
-                
-                bricks.push_back(brick);
+    size_t first = bricks.size();
+    bricks.resize(first + static_cast<size_t>(bricksX) * bricksY * bricksZ);
+    
+    // Statistics, score and content hash per brick; bricks are independent
+    tbb::parallel_for(tbb::blocked_range<size_t>(first, bricks.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            size_t b = i - first;
+            Brick& brick = bricks[i];
+            brick.x = static_cast<int>(b % bricksX) * brickSize;
+            brick.y = static_cast<int>((b / bricksX) % bricksY) * brickSize;
+            brick.z = static_cast<int>(b / (static_cast<size_t>(bricksX) * bricksY)) * brickSize;
+            
+            brick.background = backgroundMap_.empty() ? background : backgroundMap_.at(brick.x, brick.y, brick.z);
+            BrickStats stats = computeBrickStats(
+                volumeData.data(), W, H, brick.x, brick.y, brick.z,
+                std::min(brickSize, W - brick.x), std::min(brickSize, H - brick.y),
+                std::min(brickSize, D - brick.z), brick.background, nearBackgroundTolerance_, full);
+            brick.minVal = stats.minVal;
+            brick.maxVal = stats.maxVal;
+            brick.similarity = metric.score(stats, brick.background);
+            brick.hash = computeBrickHash(brick, volumeData, W, H, D, brickSize);
+        }
+    });
+}
+
+uint64_t VDBCompressor::computeBrickHash(
+    const Brick& brick,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    int nx = std::min(brickSize, W - brick.x);
+    int ny = std::min(brickSize, H - brick.y);
+    int nz = std::min(brickSize, D - brick.z);
+    
+    // Extents are part of the key so clipped edge bricks never match full ones
+    uint64_t h = mixHash(0, (static_cast<uint64_t>(nx) << 40) | (static_cast<uint64_t>(ny) << 20) | nz);
+    for (int z = brick.z; z < brick.z + nz; ++z) {
+        for (int y = brick.y; y < brick.y + ny; ++y) {
+            const float* row = &volumeData[static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W + brick.x];
+            for (int x = 0; x < nx; ++x) {
+                uint32_t bits;
+                std::memcpy(&bits, &row[x], sizeof(bits));
+                h = mixHash(h, bits);
             }
         }
     }
+    return h;
 }
 
-void VDBCompressor::computeBrickRange(
-    Brick& brick,
+bool VDBCompressor::sameBrickContents(
+    const Brick& a,
+    const Brick& b,
     const std::vector<float>& volumeData,
     int W, int H, int D,
     int brickSize) {
     
-    brick.minVal = std::numeric_limits<float>::max();
-    brick.maxVal = std::numeric_limits<float>::lowest();
-    
-    for (int z = brick.z; z < std::min(brick.z + brickSize, D); ++z) {
-        for (int y = brick.y; y < std::min(brick.y + brickSize, H); ++y) {
-            for (int x = brick.x; x < std::min(brick.x + brickSize, W); ++x) {
-                int idx = z * W * H + y * W + x;
-                float val = volumeData[idx];
-                
-                brick.minVal = std::min(brick.minVal, val);
-                brick.maxVal = std::max(brick.maxVal, val);
+    int nx = std::min(brickSize, W - a.x);
+    int ny = std::min(brickSize, H - a.y);
+    int nz = std::min(brickSize, D - a.z);
+    if (nx != std::min(brickSize, W - b.x) || ny != std::min(brickSize, H - b.y) ||
+        nz != std::min(brickSize, D - b.z)) {
+        return false;
+    }
+    for (int k = 0; k < nz; ++k) {
+        for (int j = 0; j < ny; ++j) {
+            const float* ra = &volumeData[static_cast<size_t>(a.z + k) * W * H + static_cast<size_t>(a.y + j) * W + a.x];
+            const float* rb = &volumeData[static_cast<size_t>(b.z + k) * W * H + static_cast<size_t>(b.y + j) * W + b.x];
+            if (std::memcmp(ra, rb, nx * sizeof(float)) != 0) {
+                return false;
             }
         }
     }
+    return true;
 }
 
-float VDBCompressor::computeSimilarity(float lo, float hi, float background, int metricType) {
-    switch (metricType) {
-        case 1:
-            return std::min(std::abs(lo - background), std::abs(hi - background));
-        case 2:
-            return std::max(std::abs(lo - background), std::abs(hi - background));
-        case 3:
-        default:
-            return std::abs((lo + hi) / 2.0f - background);
+std::vector<int> VDBCompressor::findDuplicateBricks(
+    const std::vector<Brick>& bricks,
+    int bricksToActivate,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize) {
+    
+    int count = std::min(bricksToActivate, static_cast<int>(bricks.size()));
+    std::vector<int> duplicateOf(count);
+    
+    // Hash -> first brick of each distinct content with that hash; equal
+    // hashes are verified voxel by voxel before a brick is shared
+    std::unordered_map<uint64_t, std::vector<int>> byHash;
+    size_t duplicates = 0;
+    size_t collisions = 0;
+    size_t sharedVoxels = 0;
+    for (int i = 0; i < count; ++i) {
+        duplicateOf[i] = i;
+        std::vector<int>& candidates = byHash[bricks[i].hash];
+        for (int c : candidates) {
+            if (bricks[c].minVal == bricks[i].minVal && bricks[c].maxVal == bricks[i].maxVal &&
+                sameBrickContents(bricks[c], bricks[i], volumeData, W, H, D, brickSize)) {
+                duplicateOf[i] = c;
+                break;
+            }
+        }
+        if (duplicateOf[i] == i) {
+            if (!candidates.empty()) {
+                ++collisions;
+            }
+            candidates.push_back(i);
+        } else {
+            ++duplicates;
+            sharedVoxels += static_cast<size_t>(std::min(brickSize, W - bricks[i].x)) *
+                            std::min(brickSize, H - bricks[i].y) * std::min(brickSize, D - bricks[i].z);
+        }
     }
+    
+    std::cout << "Brick dedup: " << count << " selected, " << (count - duplicates) << " unique, "
+              << duplicates << " duplicates (" << sharedVoxels * sizeof(float) << " bytes of voxels shared";
+    if (collisions > 0) std::cout << ", " << collisions << " hash collisions";
+    std::cout << ")" << std::endl;
+    return duplicateOf;
 }
 
 void VDBCompressor::activateExtremeCorners(
@@ -206,17 +1633,212 @@ void VDBCompressor::activateBrick(
     const Brick& brick,
     const std::vector<float>& volumeData,
     int W, int H, int D,
-    int brickSize) {
+    int brickSize,
+    int zOffset) {
     
-    for (int z = brick.z; z < std::min(brick.z + brickSize, D); ++z) {
-        for (int y = brick.y; y < std::min(brick.y + brickSize, H); ++y) {
-            for (int x = brick.x; x < std::min(brick.x + brickSize, W); ++x) {
-                int idx = z * W * H + y * W + x;
-                float val = volumeData[idx];
+    using LeafT = openvdb::FloatTree::LeafNodeType;
+    openvdb::tree::ValueAccessor<openvdb::FloatTree> acc(tree);
+    
+    int x1 = std::min(brick.x + brickSize, W);
+    int y1 = std::min(brick.y + brickSize, H);
+    int z1 = std::min(brick.z + brickSize, D);
+    
+    // Write leaf by leaf instead of descending the tree for every voxel
+    for (int lz = brick.z & ~(kLeafDim - 1); lz < z1; lz += kLeafDim) {
+        for (int ly = brick.y & ~(kLeafDim - 1); ly < y1; ly += kLeafDim) {
+            for (int lx = brick.x & ~(kLeafDim - 1); lx < x1; lx += kLeafDim) {
+                bool fullLeaf = lx >= brick.x && lx + kLeafDim <= x1 &&
+                                ly >= brick.y && ly + kLeafDim <= y1 &&
+                                lz >= brick.z && lz + kLeafDim <= z1;
+                if (fullLeaf && tryActivateTile(acc, 1, openvdb::Coord(lx, ly, lz), kLeafDim,
+                                                volumeData, W, H, zOffset)) {
+                    tileStats_.leafTiles++;
+                    continue;
+                }
+                
+                LeafT* leaf = acc.touchLeaf(openvdb::Coord(lx, ly, lz));
                 
-                openvdb::Coord coord(x, y, z);
-                tree.setValue(coord, val);
+                for (int z = std::max(lz, brick.z); z < std::min(lz + kLeafDim, z1); ++z) {
+                    for (int y = std::max(ly, brick.y); y < std::min(ly + kLeafDim, y1); ++y) {
+                        for (int x = std::max(lx, brick.x); x < std::min(lx + kLeafDim, x1); ++x) {
+                            size_t idx = static_cast<size_t>(z - zOffset) * W * H + y * W + x;
+                            leaf->setValueOn(LeafT::coordToOffset(openvdb::Coord(x, y, z)), volumeData[idx]);
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool VDBCompressor::tryActivateTile(
+    openvdb::tree::ValueAccessor<openvdb::FloatTree>& acc,
+    openvdb::Index level,
+    const openvdb::Coord& origin,
+    int dim,
+    const std::vector<float>& volumeData,
+    int W, int H,
+    int zOffset) {
+    
+    if (tileTolerance_ < 0.0f) {
+        return false;
+    }
+    
+    float lo = std::numeric_limits<float>::max();
+    float hi = std::numeric_limits<float>::lowest();
+    for (int z = origin.z(); z < origin.z() + dim; ++z) {
+        for (int y = origin.y(); y < origin.y() + dim; ++y) {
+            const float* row = &volumeData[static_cast<size_t>(z - zOffset) * W * H + static_cast<size_t>(y) * W + origin.x()];
+            for (int x = 0; x < dim; ++x) {
+                lo = std::min(lo, row[x]);
+                hi = std::max(hi, row[x]);
+            }
+            if (hi - lo > 2.0f * tileTolerance_) {
+                return false;
+            }
+        }
+    }
+    
+    float mid = 0.5f * (lo + hi);
+    double sumSq = 0.0;
+    for (int z = origin.z(); z < origin.z() + dim; ++z) {
+        for (int y = origin.y(); y < origin.y() + dim; ++y) {
+            const float* row = &volumeData[static_cast<size_t>(z - zOffset) * W * H + static_cast<size_t>(y) * W + origin.x()];
+            for (int x = 0; x < dim; ++x) {
+                double diff = row[x] - mid;
+                sumSq += diff * diff;
+            }
+        }
+    }
+    
+    acc.addTile(level, origin, mid, true);
+    tileStats_.maxError = std::max(tileStats_.maxError, hi - mid);
+    tileStats_.sumSqError += sumSq;
+    return true;
+}
+
+void VDBCompressor::activateNodeTiles(
+    openvdb::FloatTree& tree,
+    const std::vector<Brick>& bricks,
+    int bricksToActivate,
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    int brickSize,
+    std::vector<char>& covered) {
+    
+    // Larger bricks contain whole nodes and are only tiled per leaf
+    if (tileTolerance_ < 0.0f || brickSize > kInternalDim) {
+        return;
+    }
+    
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int bricksZ = (D + brickSize - 1) / brickSize;
+    std::vector<int> rank(static_cast<size_t>(bricksX) * bricksY * bricksZ, -1);
+    for (int i = 0; i < bricksToActivate && i < static_cast<int>(bricks.size()); ++i) {
+        const Brick& b = bricks[i];
+        rank[(static_cast<size_t>(b.z / brickSize) * bricksY + b.y / brickSize) * bricksX + b.x / brickSize] = i;
+    }
+    
+    // A node qualifies when it lies inside the volume, all of its bricks are
+    // selected and their combined range is within tolerance
+    int perNode = kInternalDim / brickSize;
+    openvdb::tree::ValueAccessor<openvdb::FloatTree> acc(tree);
+    for (int nz = 0; nz + kInternalDim <= D; nz += kInternalDim) {
+        for (int ny = 0; ny + kInternalDim <= H; ny += kInternalDim) {
+            for (int nx = 0; nx + kInternalDim <= W; nx += kInternalDim) {
+                float lo = std::numeric_limits<float>::max();
+                float hi = std::numeric_limits<float>::lowest();
+                std::vector<int> members;
+                bool allSelected = true;
+                for (int bz = nz / brickSize; allSelected && bz < nz / brickSize + perNode; ++bz) {
+                    for (int by = ny / brickSize; allSelected && by < ny / brickSize + perNode; ++by) {
+                        for (int bx = nx / brickSize; bx < nx / brickSize + perNode; ++bx) {
+                            int r = rank[(static_cast<size_t>(bz) * bricksY + by) * bricksX + bx];
+                            if (r < 0) {
+                                allSelected = false;
+                                break;
+                            }
+                            lo = std::min(lo, bricks[r].minVal);
+                            hi = std::max(hi, bricks[r].maxVal);
+                            members.push_back(r);
+                        }
+                    }
+                }
+                if (!allSelected || hi - lo > 2.0f * tileTolerance_) {
+                    continue;
+                }
+                if (tryActivateTile(acc, 2, openvdb::Coord(nx, ny, nz), kInternalDim, volumeData, W, H, 0)) {
+                    tileStats_.nodeTiles++;
+                    for (int r : members) {
+                        covered[r] = 1;
+                    }
+                }
             }
         }
     }
 }
+
+int VDBCompressor::autotuneBrickSize(
+    const std::vector<float>& volumeData,
+    int W, int H, int D,
+    float background,
+    const BrickMetric& metric) {
+    
+    if (maxAbsError_ <= 0.0f && targetPSNR_ <= 0.0f) {
+        throw std::runtime_error("Brick size autotuning needs an error target (--max-error or --psnr)");
+    }
+    
+    // Subsample: a central crop of up to two internal nodes per axis,
+    // aligned so its brick grid matches the one of the full volume
+    int dims[3] = {W, H, D};
+    int crop0[3], cropDims[3];
+    for (int a = 0; a < 3; ++a) {
+        crop0[a] = std::max(0, (dims[a] - 2 * kInternalDim) / 2) / kInternalDim * kInternalDim;
+        cropDims[a] = std::min(2 * kInternalDim, dims[a] - crop0[a]);
+    }
+    int cW = cropDims[0], cH = cropDims[1], cD = cropDims[2];
+    
+    std::vector<float> crop(static_cast<size_t>(cW) * cH * cD);
+    for (int z = 0; z < cD; ++z) {
+        for (int y = 0; y < cH; ++y) {
+            size_t src = static_cast<size_t>(z + crop0[2]) * W * H + static_cast<size_t>(y + crop0[1]) * W + crop0[0];
+            std::copy(volumeData.begin() + src, volumeData.begin() + src + cW,
+                      crop.begin() + (static_cast<size_t>(z) * cH + y) * cW);
+        }
+    }
+    
+    auto range = std::minmax_element(volumeData.begin(), volumeData.end());
+    float dataRange = *range.second - *range.first;
+    
+    std::cout << "Autotuning brick size on a " << cW << "x" << cH << "x" << cD << " subsample" << std::endl;
+    
+    int bestSize = kCandidateBrickSizes[0];
+    size_t bestBytes = std::numeric_limits<size_t>::max();
+    for (int candidate : kCandidateBrickSizes) {
+        std::vector<Brick> bricks;
+        decomposeIntoBricks(bricks, crop, cW, cH, cD, candidate, background, metric);
+        for (auto& brick : bricks) {
+            computeBrickError(brick, crop, cW, cH, cD, candidate);
+        }
+        std::sort(bricks.rbegin(), bricks.rend());
+        int count = selectBricksForErrorBound(bricks, crop.size(), dataRange);
+        
+        openvdb::FloatGrid::Ptr trial = openvdb::FloatGrid::create(background);
+        for (int i = 0; i < count; ++i) {
+            activateBrick(trial->tree(), bricks[i], crop, cW, cH, cD, candidate);
+        }
+        trial->tree().prune();
+        size_t bytes = serializedGridSize(trial);
+        
+        std::cout << "  brick size " << candidate << ": " << count << "/" << bricks.size()
+                  << " bricks, " << bytes << " bytes" << std::endl;
+        if (bytes < bestBytes) {
+            bestBytes = bytes;
+            bestSize = candidate;
+        }
+    }
+    
+    std::cout << "Selected brick size: " << bestSize << std::endl;
+    return bestSize;
+}
@@ -1,7 +1,13 @@
 #ifndef VDBCOMPRESSOR_H
 #define VDBCOMPRESSOR_H
 
+#include "BrickContainer.h"
+#include "BrickMetrics.h"
+#include "PhaseProfiler.h"
+#include "QuantizedBrickCodec.h"
 #include <openvdb/openvdb.h>
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -11,22 +17,245 @@ private:
         int x, y, z;
         float minVal, maxVal;
         double similarity;
+        float background = 0.0f;   // value the brick reads as when left inactive
+        float maxError = 0.0f;     // max |v - background| if left inactive
+        double sumSqError = 0.0;   // sum of (v - background)^2 if left inactive
+        uint64_t hash = 0;         // content hash of the brick voxels
         
         bool operator<(const Brick& other) const {
             return similarity < other.similarity;
         }
     };
 
+    // Predicts the written .vdb size for the first k ranked bricks as a
+    // fixed cost plus a calibrated number of bytes per activated voxel
+    struct SizeModel {
+        size_t baseBytes = 0;
+        double bytesPerVoxel = sizeof(float);
+        std::vector<size_t> cumulativeVoxels;  // voxels in bricks [0, i)
+
+        int count(size_t targetBytes) const;
+        size_t predict(int count) const;
+    };
+
 public:
     VDBCompressor();
-    openvdb::FloatGrid::Ptr compressVTKVolume(
-        const std::string& vtkFilename, 
-        float quality = 0.5f, 
+
+    // Per-step volume provider of compressSequence: fills the dense float
+    // volume of a step, indexed [(z * H + y) * W + x], and its dimensions
+    using VolumeSource = std::function<void(size_t step, std::vector<float>& volumeData, int& W, int& H, int& D)>;
+
+    // Bricks are aligned to OpenVDB leaf (8^3) and internal node (128^3)
+    // boundaries, so brickSize is rounded up to 8, 16, 32, 64, 128 or a
+    // multiple of 128. A brickSize <= 0 autotunes it, which requires an
+    // error bound (see setErrorBound).
+    openvdb::FloatGrid::Ptr compressVolume(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        float quality = 0.5f,
         int brickSize = 32,
         int metricType = 3);
 
+    // Time-series mode: one grid per step. Keyframes (the first step, every
+    // keyframeInterval steps and on a change of dimensions; 0 = first only)
+    // are compressed as usual. Other steps are deltas holding only the bricks
+    // whose content differs from the version last stored by more than
+    // changeTolerance: active bricks as values, bricks that became inactive
+    // as active tiles of the background. Changed bricks are activated with
+    // the keyframe's ranking threshold. Grids are named
+    // "compressed_volume_t<step>" and carry sequence_step, sequence_keyframe,
+    // sequence_changed_bricks and sequence_length metadata; delta steps also
+    // list the bricks they clear as index ranges over the x-fastest brick
+    // grid (sequence_cleared, sequence_volume_size). Error bounds are not
+    // supported, as delta steps use the keyframe's threshold.
+    std::vector<openvdb::FloatGrid::Ptr> compressSequence(
+        size_t stepCount,
+        const VolumeSource& source,
+        float quality = 0.5f,
+        int brickSize = 32,
+        int metricType = 3,
+        int keyframeInterval = 16,
+        float changeTolerance = 0.0f);
+
+    // Sweep mode: one grid per (metric, quality) pair from one brick
+    // decomposition. Brick statistics are computed once for all metrics,
+    // bricks are ranked once per metric, and qualities are built in
+    // ascending order, each extending the selection of the previous one.
+    // Each grid matches what compressVolume produces for its pair.
+    // With a statsCache file, statistics are read from it when it matches
+    // the volume and brick size, and written to it otherwise, so later runs
+    // also skip the background estimate and the decomposition. Grids are
+    // returned metric-major in the given order, named
+    // "compressed_volume_<metric>_q<quality>", with sweep_metric and
+    // sweep_quality metadata. Error bounds, target size, adaptive
+    // background, quantization and brick containers are not supported.
+    std::vector<openvdb::FloatGrid::Ptr> compressSweep(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        const std::vector<float>& qualities,
+        const std::vector<int>& metricTypes,
+        int brickSize = 32,
+        const std::string& statsCache = "");
+
+    // Reader helper for compressSequence output: the full grid of a step,
+    // i.e. its keyframe with every later delta up to the step applied
+    static openvdb::FloatGrid::Ptr composeSequenceStep(
+        const std::vector<openvdb::FloatGrid::Ptr>& steps,
+        size_t step);
+
+    // Out-of-core variant of compressVTKVolume (VDBCompressorVTK.h): streams brick-thick Z-slabs
+    // twice (statistics, then activation) instead of loading the whole volume.
+    // Working memory (slabs, background sample, brick table) is kept within
+    // maxMemoryBytes; 0 means no limit.
+    openvdb::FloatGrid::Ptr compressVTKVolumeStreaming(
+        const std::string& vtkFilename,
+        float quality = 0.5f,
+        int brickSize = 32,
+        int metricType = 3,
+        size_t maxMemoryBytes = 0);
+
+    // Error-bounded mode: instead of activating a fixed fraction of bricks,
+    // activate the least background-like bricks until the reconstruction
+    // (inactive voxels read as background) has a max absolute error of at
+    // most maxAbsError and a PSNR of at least targetPSNR. A bound <= 0 is
+    // ignored; passing both <= 0 restores the quality fraction.
+    void setErrorBound(float maxAbsError, float targetPSNR);
+
+    // Target-size mode: activate as many of the least background-like bricks
+    // as fit in a written .vdb of about targetBytes (0 disables).
+    void setTargetBytes(size_t targetBytes);
+
+    // Leaves (8^3) and internal nodes (128^3) of selected bricks whose values
+    // span at most 2 * tolerance are stored as a single active tile holding
+    // the mid-range value, bounding the added error by tolerance. 0 (the
+    // default) only tiles exactly constant regions; < 0 disables tiling.
+    // Capped by the max error bound; must not be positive with a PSNR target.
+    void setTileTolerance(float tolerance);
+
+    // Estimate the background per region (an internal node, 128^3, or a
+    // brick when bricks are larger) instead of once for the whole volume.
+    // Regions whose median differs from the global one store it as inactive
+    // tiles, and their bricks are ranked against it, so a drifting or
+    // material-dependent background no longer forces bricks active.
+    void setAdaptiveBackground(bool enabled);
+
+    // Codec stage: also encode the selected bricks as a quantized brick
+    // stream (8/16 bits, 0 = fewest bits meeting maxError; < 0 disables)
+    void setQuantization(int bits, float maxError);
+    const QuantizedBrickStream& quantizedBricks() const { return quantizedStream_; }
+
+    // Level-of-detail pyramid for a compressed grid: level 0 is the grid
+    // itself, each further level halves the resolution by averaging the
+    // active voxels of 2^3 cells of the previous one (leaves in parallel).
+    // Coarse grids are named "<name>_lod<k>" and carry lod_level,
+    // lod_scale (2^k) and lod_levels metadata.
+    std::vector<openvdb::FloatGrid::Ptr> buildLodPyramid(openvdb::FloatGrid::Ptr grid, int levels);
+
+    // Throws std::runtime_error for option combinations compressVolume
+    // cannot honour; compressVolume checks them itself, callers may check
+    // before loading any data
+    void validateOptions(int brickSize) const;
+
+    // Ranks bricks with this metric instead of the built-in one selected by
+    // metricType (null restores metricType)
+    void setBrickMetric(std::shared_ptr<const BrickMetric> metric);
+
+    // Phase timings, memory and allocations of every compression so far
+    PhaseProfiler& profiler() { return profiler_; }
+
+    // Also pack the selected bricks into a random-access brick container
+    void enableBrickContainer(BrickCompression compression);
+    const BrickContainerWriter* brickContainer() const { return container_.get(); }
+
 private:
-    float computeBackgroundValue(const std::vector<float>& data);
+    // Ranking threshold of the last compression: bricks are active when their
+    // similarity is <= threshold (>= when the least background-like go first)
+    struct Selection {
+        float background = 0.0f;
+        double threshold = 0.0;
+        bool highFirst = false;
+
+        bool selects(double similarity) const {
+            return highFirst ? similarity >= threshold : similarity <= threshold;
+        }
+    };
+
+    // Per-brick state of a time series: the voxels of every brick as last
+    // stored (keyframe or delta) and their content hashes
+    struct SequenceState {
+        int W = 0, H = 0, D = 0;
+        int brickSize = 0;
+        float fillValue = 0.0f;
+        std::vector<float> reference;
+        std::vector<uint64_t> hashes;
+    };
+
+    // Per-region background of the last compression (empty when adaptive
+    // background is off); regions are regionDim^3 voxels from the origin
+    struct BackgroundMap {
+        int regionDim = 0;
+        int regionsX = 0, regionsY = 0, regionsZ = 0;
+        std::vector<float> values;
+
+        bool empty() const { return values.empty(); }
+        float at(int x, int y, int z) const {
+            return values[(static_cast<size_t>(z / regionDim) * regionsY + y / regionDim) * regionsX + x / regionDim];
+        }
+    };
+
+    // Tiles emitted by the last compression and the error they introduced
+    struct TileStats {
+        size_t leafTiles = 0;
+        size_t nodeTiles = 0;
+        float maxError = 0.0f;
+        double sumSqError = 0.0;
+    };
+
+    float maxAbsError_;
+    float targetPSNR_;
+    size_t targetBytes_;
+    float tileTolerance_;
+    TileStats tileStats_;
+    Selection selection_;
+    std::shared_ptr<const BrickMetric> metric_;
+    float nearBackgroundTolerance_;
+    bool adaptiveBackground_;
+    BackgroundMap backgroundMap_;
+    int quantizeBits_;
+    float quantizeError_;
+    QuantizedBrickStream quantizedStream_;
+    bool containerEnabled_;
+    BrickCompression containerCompression_;
+    std::shared_ptr<BrickContainerWriter> container_;
+    PhaseProfiler profiler_;
+
+    std::shared_ptr<const BrickMetric> resolveMetric(int metricType) const;
+    float computeBackgroundValue(const std::vector<float>& data, float& dataRange);
+    void estimateRegionBackgrounds(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize,
+        float background);
+    void addRegionBackgroundTiles(openvdb::FloatTree& tree, float background);
+    BrickStatsTable loadBrickStats(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize,
+        bool full,
+        const std::string& statsCache);
+    openvdb::FloatGrid::Ptr restrictGrid(const openvdb::FloatGrid& fine);
+    openvdb::FloatGrid::Ptr compressDeltaStep(
+        SequenceState& state,
+        const std::vector<float>& volumeData,
+        const BrickMetric& metric,
+        float changeTolerance,
+        size_t& changedBricks);
+    float maxBrickDifference(
+        const Brick& brick,
+        const std::vector<float>& volumeData,
+        const std::vector<float>& referenceData,
+        int W, int H, int D,
+        int brickSize);
     void applyCompressionAlgorithm(
         openvdb::FloatGrid::Ptr grid,
         const std::vector<float>& volumeData,
@@ -34,20 +263,90 @@ private:
         float background,
         float quality,
         int brickSize,
-        int metricType);
+        const BrickMetric& metric);
     void decomposeIntoBricks(
         std::vector<Brick>& bricks,
         const std::vector<float>& volumeData,
         int W, int H, int D,
         int brickSize,
         float background,
-        int metricType);
-    void computeBrickRange(
+        const BrickMetric& metric);
+    uint64_t computeBrickHash(
+        const Brick& brick,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize);
+    void computeBrickError(
         Brick& brick,
         const std::vector<float>& volumeData,
         int W, int H, int D,
         int brickSize);
-    float computeSimilarity(float lo, float hi, float background, int metricType);
+    int selectBricksForErrorBound(
+        const std::vector<Brick>& bricks,
+        size_t totalVoxels,
+        float dataRange);
+    SizeModel buildSizeModel(
+        openvdb::FloatGrid::Ptr grid,
+        const std::vector<Brick>& bricks,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize);
+    int refineToTargetSize(
+        openvdb::FloatGrid::Ptr grid,
+        SizeModel& model,
+        const std::vector<Brick>& bricks,
+        int activeBricks,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize);
+    int autotuneBrickSize(
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        float background,
+        const BrickMetric& metric);
+    void activateNodeTiles(
+        openvdb::FloatTree& tree,
+        const std::vector<Brick>& bricks,
+        int bricksToActivate,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize,
+        std::vector<char>& covered);
+    bool tryActivateTile(
+        openvdb::tree::ValueAccessor<openvdb::FloatTree>& acc,
+        openvdb::Index level,
+        const openvdb::Coord& origin,
+        int dim,
+        const std::vector<float>& volumeData,
+        int W, int H,
+        int zOffset);
+    void encodeQuantizedBricks(
+        const std::vector<Brick>& bricks,
+        int bricksToActivate,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize,
+        float background);
+    std::vector<int> findDuplicateBricks(
+        const std::vector<Brick>& bricks,
+        int bricksToActivate,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize);
+    bool sameBrickContents(
+        const Brick& a,
+        const Brick& b,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize);
+    void buildBrickContainer(
+        const std::vector<Brick>& bricks,
+        int bricksToActivate,
+        const std::vector<int>& duplicateOf,
+        const std::vector<float>& volumeData,
+        int W, int H, int D,
+        int brickSize,
+        float background);
     void activateExtremeCorners(
         openvdb::FloatTree& tree,
         const std::vector<float>& volumeData,
@@ -57,7 +356,8 @@ private:
         const Brick& brick,
         const std::vector<float>& volumeData,
         int W, int H, int D,
-        int brickSize);
+        int brickSize,
+        int zOffset = 0);
 };
 
 #endif
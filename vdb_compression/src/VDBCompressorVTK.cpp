@@ -0,0 +1,93 @@
+// VTK front end of VDBCompressor: everything that reads legacy VTK files
+// through the VTK library. Kept out of VDBCompressor.cpp so that
+// libvdbcompress does not depend on VTK.
+
+#include "VDBCompressorVTK.h"
+#include <vtkSmartPointer.h>
+#include <vtkStructuredPointsReader.h>
+#include <vtkImageData.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkStructuredPoints.h>
+#include <iostream>
+#include <stdexcept>
+
+void loadVTKVolume(
+    const std::string& vtkFilename,
+    std::vector<float>& volumeData,
+    int& W, int& H, int& D,
+    PhaseProfiler* profiler) {
+    
+    // Load VTK data
+    auto reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
+    reader->SetFileName(vtkFilename.c_str());
+    {
+        PhaseProfiler::Scope phase(profiler, "vtk_read");
+        reader->Update();
+    }
+    
+    // Use auto to avoid type casting issues
+    auto vtkData = reader->GetOutput();
+    
+    if (!vtkData) {
+        throw std::runtime_error("Failed to load VTK file: " + vtkFilename);
+    }
+    
+    // Get volume dimensions and data
+    int dims[3];
+    vtkData->GetDimensions(dims);
+    W = dims[0];
+    H = dims[1];
+    D = dims[2];
+    
+    vtkPointData* pointData = vtkData->GetPointData();
+    if (!pointData) {
+        throw std::runtime_error("No point data in VTK file");
+    }
+    
+    vtkDataArray* scalarData = pointData->GetScalars();
+    if (!scalarData) {
+        throw std::runtime_error("No scalar data in VTK file");
+    }
+    
+    size_t totalVoxels = static_cast<size_t>(W) * H * D;
+    
+    PhaseProfiler::Scope phase(profiler, "float_conversion");
+    volumeData.resize(totalVoxels);
+    for (size_t i = 0; i < totalVoxels; ++i) {
+        volumeData[i] = static_cast<float>(scalarData->GetComponent(static_cast<vtkIdType>(i), 0));
+    }
+}
+
+openvdb::FloatGrid::Ptr compressVTKVolume(
+    VDBCompressor& compressor,
+    const std::string& vtkFilename,
+    float quality, 
+    int brickSize,
+    int metricType) {
+    
+    PhaseProfiler::Scope phase(&compressor.profiler(), "compress_vtk_volume");
+    int W, H, D;
+    std::vector<float> volumeData;
+    loadVTKVolume(vtkFilename, volumeData, W, H, D, &compressor.profiler());
+    
+    return compressor.compressVolume(volumeData, W, H, D, quality, brickSize, metricType);
+}
+
+std::vector<openvdb::FloatGrid::Ptr> compressVTKSequence(
+    VDBCompressor& compressor,
+    const std::vector<std::string>& vtkFilenames,
+    float quality,
+    int brickSize,
+    int metricType,
+    int keyframeInterval,
+    float changeTolerance) {
+    
+    return compressor.compressSequence(
+        vtkFilenames.size(),
+        [&](size_t step, std::vector<float>& volumeData, int& W, int& H, int& D) {
+            std::cout << "--- Step " << step << ": " << vtkFilenames[step] << " ---" << std::endl;
+            loadVTKVolume(vtkFilenames[step], volumeData, W, H, D, &compressor.profiler());
+        },
+        quality, brickSize, metricType, keyframeInterval, changeTolerance);
+}
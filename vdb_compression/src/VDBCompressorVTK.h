@@ -0,0 +1,37 @@
+#ifndef VDBCOMPRESSORVTK_H
+#define VDBCOMPRESSORVTK_H
+
+#include "VDBCompressor.h"
+#include <string>
+#include <vector>
+
+// VTK front end of VDBCompressor, defined in VDBCompressorVTK.cpp. Needs the
+// VTK library and is not part of libvdbcompress.
+
+// Loads the scalars of a legacy VTK structured points file as a dense float
+// volume; the read and the float conversion are recorded as phases when a
+// profiler is given
+void loadVTKVolume(
+    const std::string& vtkFilename,
+    std::vector<float>& volumeData,
+    int& W, int& H, int& D,
+    PhaseProfiler* profiler = nullptr);
+
+// Load their inputs with loadVTKVolume, then compress as
+// VDBCompressor::compressVolume and VDBCompressor::compressSequence
+openvdb::FloatGrid::Ptr compressVTKVolume(
+    VDBCompressor& compressor,
+    const std::string& vtkFilename,
+    float quality = 0.5f,
+    int brickSize = 32,
+    int metricType = 3);
+std::vector<openvdb::FloatGrid::Ptr> compressVTKSequence(
+    VDBCompressor& compressor,
+    const std::vector<std::string>& vtkFilenames,
+    float quality = 0.5f,
+    int brickSize = 32,
+    int metricType = 3,
+    int keyframeInterval = 16,
+    float changeTolerance = 0.0f);
+
+#endif
@@ -0,0 +1,295 @@
+#include "VQCodec.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = {'V', 'V', 'Q', '1'};
+
+// Fixed seed so repeated runs produce identical codebooks
+const unsigned kSeed = 12345;
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated VQ stream");
+    }
+    return value;
+}
+
+template <typename T>
+void writeArray(std::ofstream& out, const std::vector<T>& values) {
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template <typename T>
+void readArray(std::ifstream& in, std::vector<T>& values, size_t count) {
+    values.resize(count);
+    in.read(reinterpret_cast<char*>(values.data()), count * sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated VQ stream");
+    }
+}
+
+// Nearest codebook entry by squared distance, abandoning an entry as soon
+// as its partial distance exceeds the best so far
+int nearestEntry(const float* v, const std::vector<float>& codebook, int entries, int length) {
+    int best = 0;
+    float bestDist = std::numeric_limits<float>::max();
+    for (int c = 0; c < entries; ++c) {
+        const float* e = &codebook[static_cast<size_t>(c) * length];
+        float dist = 0.0f;
+        for (int i = 0; i < length; i += 8) {
+            int end = std::min(i + 8, length);
+            for (int j = i; j < end; ++j) {
+                float d = v[j] - e[j];
+                dist += d * d;
+            }
+            if (dist >= bestDist) {
+                break;
+            }
+        }
+        if (dist < bestDist) {
+            bestDist = dist;
+            best = c;
+        }
+    }
+    return best;
+}
+
+} // namespace
+
+size_t VQVolume::byteSize() const {
+    size_t indexBytes = codebookSize > 256 ? sizeof(uint16_t) : sizeof(uint8_t);
+    return sizeof(kMagic) + 6 * sizeof(int32_t) +
+           codebook.size() * sizeof(float) +
+           indices.size() * indexBytes +
+           (offsets.size() + scales.size()) * sizeof(float);
+}
+
+float VQVolume::sample(int x, int y, int z) const {
+    size_t block = (static_cast<size_t>(z / blockDim) * blocksY() + y / blockDim) * blocksX() + x / blockDim;
+    int voxel = ((z % blockDim) * blockDim + (y % blockDim)) * blockDim + (x % blockDim);
+    float code = codebook[static_cast<size_t>(indices[block]) * blockDim * blockDim * blockDim + voxel];
+    return scaled ? offsets[block] + scales[block] * code : code;
+}
+
+VQCodec::VQCodec(int codebookSize, int blockDim, bool scaled, int iterations, int batchSize)
+    : codebookSize_(codebookSize), blockDim_(blockDim), scaled_(scaled),
+      iterations_(iterations), batchSize_(batchSize) {
+    if (codebookSize_ < 1 || codebookSize_ > 65536) {
+        throw std::runtime_error("VQ codebook size must be 1 to 65536");
+    }
+    if (blockDim_ != 2 && blockDim_ != 4) {
+        throw std::runtime_error("VQ blocks must be 2^3 or 4^3");
+    }
+}
+
+VQVolume VQCodec::encodeVolume(const std::vector<float>& volumeData, int W, int H, int D) const {
+    VQVolume volume;
+    volume.W = W;
+    volume.H = H;
+    volume.D = D;
+    volume.blockDim = blockDim_;
+    volume.scaled = scaled_;
+
+    int b = blockDim_;
+    int length = b * b * b;
+    int bx = volume.blocksX(), by = volume.blocksY();
+    size_t blocks = static_cast<size_t>(bx) * by * volume.blocksZ();
+    if (scaled_) {
+        volume.offsets.resize(blocks);
+        volume.scales.resize(blocks);
+    }
+
+    // Block vectors, edge blocks padded by repeating the last voxel; in
+    // scaled mode each is normalized to zero mean and unit max deviation
+    std::vector<float> vectors(blocks * length);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blocks), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            int x0 = static_cast<int>(i % bx) * b;
+            int y0 = static_cast<int>((i / bx) % by) * b;
+            int z0 = static_cast<int>(i / (static_cast<size_t>(bx) * by)) * b;
+            float* v = &vectors[i * length];
+            for (int k = 0; k < b; ++k) {
+                for (int j = 0; j < b; ++j) {
+                    for (int n = 0; n < b; ++n) {
+                        v[(k * b + j) * b + n] = volumeData[
+                            static_cast<size_t>(std::min(z0 + k, D - 1)) * W * H +
+                            static_cast<size_t>(std::min(y0 + j, H - 1)) * W + std::min(x0 + n, W - 1)];
+                    }
+                }
+            }
+            if (scaled_) {
+                float mean = 0.0f;
+                for (int n = 0; n < length; ++n) mean += v[n];
+                mean /= length;
+                float scale = 0.0f;
+                for (int n = 0; n < length; ++n) scale = std::max(scale, std::abs(v[n] - mean));
+                float inv = scale > 0.0f ? 1.0f / scale : 0.0f;
+                for (int n = 0; n < length; ++n) v[n] = (v[n] - mean) * inv;
+                volume.offsets[i] = mean;
+                volume.scales[i] = scale;
+            }
+        }
+    });
+
+    // Initial codebook: distinct random blocks
+    int entries = static_cast<int>(std::min<size_t>(codebookSize_, blocks));
+    volume.codebookSize = entries;
+    std::mt19937_64 rng(kSeed);
+    std::vector<size_t> pick(blocks);
+    for (size_t i = 0; i < blocks; ++i) {
+        pick[i] = i;
+    }
+    for (int c = 0; c < entries; ++c) {
+        std::uniform_int_distribution<size_t> dist(c, blocks - 1);
+        std::swap(pick[c], pick[dist(rng)]);
+    }
+    volume.codebook.resize(static_cast<size_t>(entries) * length);
+    for (int c = 0; c < entries; ++c) {
+        std::copy(&vectors[pick[c] * length], &vectors[pick[c] * length] + length,
+                  &volume.codebook[static_cast<size_t>(c) * length]);
+    }
+
+    // Mini-batch k-means: assign a random batch in parallel, then move each
+    // winning entry towards its samples with a per-entry learning rate 1/n
+    std::vector<size_t> counts(entries, 0);
+    size_t batch = std::min<size_t>(batchSize_, blocks);
+    std::vector<size_t> samples(batch);
+    std::vector<int> nearest(batch);
+    std::uniform_int_distribution<size_t> anyBlock(0, blocks - 1);
+    for (int it = 0; it < iterations_; ++it) {
+        for (auto& s : samples) {
+            s = anyBlock(rng);
+        }
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, batch), [&](const tbb::blocked_range<size_t>& r) {
+            for (size_t s = r.begin(); s != r.end(); ++s) {
+                nearest[s] = nearestEntry(&vectors[samples[s] * length], volume.codebook, entries, length);
+            }
+        });
+        for (size_t s = 0; s < batch; ++s) {
+            int c = nearest[s];
+            float eta = 1.0f / static_cast<float>(++counts[c]);
+            float* e = &volume.codebook[static_cast<size_t>(c) * length];
+            const float* v = &vectors[samples[s] * length];
+            for (int n = 0; n < length; ++n) {
+                e[n] += eta * (v[n] - e[n]);
+            }
+        }
+    }
+
+    volume.indices.resize(blocks);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, blocks), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            volume.indices[i] = static_cast<uint16_t>(
+                nearestEntry(&vectors[i * length], volume.codebook, entries, length));
+        }
+    });
+    return volume;
+}
+
+void VQCodec::decodeVolume(const VQVolume& volume, std::vector<float>& volumeData) {
+    int W = volume.W, H = volume.H, D = volume.D;
+    volumeData.resize(static_cast<size_t>(W) * H * D);
+    tbb::parallel_for(tbb::blocked_range<int>(0, D), [&](const tbb::blocked_range<int>& r) {
+        for (int z = r.begin(); z != r.end(); ++z) {
+            for (int y = 0; y < H; ++y) {
+                float* row = &volumeData[static_cast<size_t>(z) * W * H + static_cast<size_t>(y) * W];
+                for (int x = 0; x < W; ++x) {
+                    row[x] = volume.sample(x, y, z);
+                }
+            }
+        }
+    });
+}
+
+void VQCodec::write(const VQVolume& volume, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writePod<int32_t>(out, volume.W);
+    writePod<int32_t>(out, volume.H);
+    writePod<int32_t>(out, volume.D);
+    writePod<int32_t>(out, volume.blockDim);
+    writePod<int32_t>(out, volume.codebookSize);
+    writePod<int32_t>(out, volume.scaled ? 1 : 0);
+    writeArray(out, volume.codebook);
+    if (volume.codebookSize > 256) {
+        writeArray(out, volume.indices);
+    } else {
+        std::vector<uint8_t> narrow(volume.indices.begin(), volume.indices.end());
+        writeArray(out, narrow);
+    }
+    if (volume.scaled) {
+        writeArray(out, volume.offsets);
+        writeArray(out, volume.scales);
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+VQVolume VQCodec::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a VQ stream: " + filename);
+    }
+
+    VQVolume volume;
+    volume.W = readPod<int32_t>(in);
+    volume.H = readPod<int32_t>(in);
+    volume.D = readPod<int32_t>(in);
+    volume.blockDim = readPod<int32_t>(in);
+    volume.codebookSize = readPod<int32_t>(in);
+    volume.scaled = readPod<int32_t>(in) != 0;
+    if (volume.W <= 0 || volume.H <= 0 || volume.D <= 0 || (volume.blockDim != 2 && volume.blockDim != 4) ||
+        volume.codebookSize < 1 || volume.codebookSize > 65536) {
+        throw std::runtime_error("Invalid VQ header in: " + filename);
+    }
+
+    size_t length = static_cast<size_t>(volume.blockDim) * volume.blockDim * volume.blockDim;
+    size_t blocks = static_cast<size_t>(volume.blocksX()) * volume.blocksY() * volume.blocksZ();
+    readArray(in, volume.codebook, volume.codebookSize * length);
+    if (volume.codebookSize > 256) {
+        readArray(in, volume.indices, blocks);
+    } else {
+        std::vector<uint8_t> narrow;
+        readArray(in, narrow, blocks);
+        volume.indices.assign(narrow.begin(), narrow.end());
+    }
+    for (uint16_t index : volume.indices) {
+        if (index >= volume.codebookSize) {
+            throw std::runtime_error("VQ index outside codebook in: " + filename);
+        }
+    }
+    if (volume.scaled) {
+        readArray(in, volume.offsets, blocks);
+        readArray(in, volume.scales, blocks);
+    }
+    return volume;
+}
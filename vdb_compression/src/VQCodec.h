@@ -0,0 +1,54 @@
+#ifndef VQCODEC_H
+#define VQCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Vector quantization of 2^3 or 4^3 voxel blocks against a k-means
+// codebook. Every block stores one codebook index (8 bits for up to 256
+// entries, else 16), optionally with a per-block offset and scale, so a
+// voxel decodes with a single table lookup:
+//   value = offset[b] + scale[b] * codebook[index[b] * blockVoxels + v]
+// The codebook is a contiguous float table and the index volume a dense
+// bx * by * bz array, both directly usable as GPU textures.
+
+struct VQVolume {
+    int W = 0, H = 0, D = 0;
+    int blockDim = 4;
+    int codebookSize = 0;
+    bool scaled = false;
+    std::vector<float> codebook;   // codebookSize * blockDim^3
+    std::vector<uint16_t> indices; // one per block, x-fastest
+    std::vector<float> offsets;    // per block when scaled
+    std::vector<float> scales;
+
+    int blocksX() const { return (W + blockDim - 1) / blockDim; }
+    int blocksY() const { return (H + blockDim - 1) / blockDim; }
+    int blocksZ() const { return (D + blockDim - 1) / blockDim; }
+    size_t byteSize() const;
+
+    float sample(int x, int y, int z) const;
+};
+
+class VQCodec {
+public:
+    VQCodec(int codebookSize = 256, int blockDim = 4, bool scaled = false,
+            int iterations = 100, int batchSize = 4096);
+
+    // Trains the codebook with mini-batch k-means and assigns every block
+    VQVolume encodeVolume(const std::vector<float>& volumeData, int W, int H, int D) const;
+    static void decodeVolume(const VQVolume& volume, std::vector<float>& volumeData);
+
+    static void write(const VQVolume& volume, const std::string& filename);
+    static VQVolume read(const std::string& filename);
+
+private:
+    int codebookSize_;
+    int blockDim_;
+    bool scaled_;
+    int iterations_;
+    int batchSize_;
+};
+
+#endif
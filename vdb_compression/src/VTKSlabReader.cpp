@@ -0,0 +1,194 @@
+#include "VTKSlabReader.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Legacy VTK binary data is always big-endian.
+template <typename T>
+float readBigEndian(const char* src) {
+    unsigned char bytes[sizeof(T)];
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        bytes[i] = static_cast<unsigned char>(src[sizeof(T) - 1 - i]);
+    }
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return static_cast<float>(value);
+}
+
+template <typename T>
+void convertBigEndian(const char* src, size_t count, size_t stride, float* dst) {
+    for (size_t i = 0; i < count; ++i, src += stride) {
+        dst[i] = readBigEndian<T>(src);
+    }
+}
+
+size_t scalarSize(const std::string& type) {
+    if (type == "bit") {
+        // Packed eight values per byte, so slabs are not byte-addressable
+        throw std::runtime_error("Unsupported VTK scalar type: bit (bit-packed)");
+    }
+    if (type == "unsigned_char" || type == "uint8" || type == "char") return 1;
+    if (type == "unsigned_short" || type == "uint16" || type == "short") return 2;
+    if (type == "unsigned_int" || type == "int" || type == "float") return 4;
+    if (type == "unsigned_long" || type == "long" || type == "double") return 8;
+    throw std::runtime_error("Unsupported VTK scalar type: " + type);
+}
+
+} // namespace
+
+VTKSlabReader::VTKSlabReader(const std::string& filename)
+    : filename_(filename), binary_(false), W_(0), H_(0), D_(0),
+      numComponents_(1), scalarType_("float"), bytesPerValue_(4),
+      dataOffset_(0), nextASCIISlice_(0) {
+    origin_[0] = origin_[1] = origin_[2] = 0.0;
+    spacing_[0] = spacing_[1] = spacing_[2] = 1.0;
+    open();
+}
+
+void VTKSlabReader::open() {
+    file_.close();
+    file_.clear();
+    file_.open(filename_, std::ios::binary);
+    if (!file_.is_open()) {
+        throw std::runtime_error("Failed to open VTK file: " + filename_);
+    }
+    parseHeader();
+    nextASCIISlice_ = 0;
+}
+
+void VTKSlabReader::parseHeader() {
+    std::string line;
+    std::getline(file_, line); // version
+    std::getline(file_, line); // title
+    std::getline(file_, line); // format (ASCII/BINARY)
+    if (line.find("BINARY") != std::string::npos) {
+        binary_ = true;
+    } else if (line.find("ASCII") != std::string::npos) {
+        binary_ = false;
+    } else {
+        throw std::runtime_error("Unsupported VTK format: " + line);
+    }
+
+    bool haveScalars = false;
+    while (std::getline(file_, line)) {
+        std::stringstream ss(line);
+        std::string keyword;
+        ss >> keyword;
+
+        if (keyword == "DATASET") {
+            std::string type;
+            ss >> type;
+            if (type != "STRUCTURED_POINTS") {
+                throw std::runtime_error("Streaming requires STRUCTURED_POINTS, got: " + type);
+            }
+        } else if (keyword == "DIMENSIONS") {
+            ss >> W_ >> H_ >> D_;
+        } else if (keyword == "ORIGIN") {
+            ss >> origin_[0] >> origin_[1] >> origin_[2];
+        } else if (keyword == "SPACING" || keyword == "ASPECT_RATIO") {
+            ss >> spacing_[0] >> spacing_[1] >> spacing_[2];
+        } else if (keyword == "SCALARS") {
+            std::string name;
+            ss >> name >> scalarType_;
+            if (!(ss >> numComponents_)) numComponents_ = 1;
+            haveScalars = true;
+        } else if (keyword == "LOOKUP_TABLE") {
+            break; // Scalar values start on the next line
+        }
+    }
+
+    if (!haveScalars) {
+        throw std::runtime_error("No scalar data in VTK file: " + filename_);
+    }
+    if (W_ <= 0 || H_ <= 0 || D_ <= 0) {
+        throw std::runtime_error("Invalid dimensions in VTK file: " + filename_);
+    }
+
+    bytesPerValue_ = scalarSize(scalarType_);
+    dataOffset_ = file_.tellg();
+}
+
+void VTKSlabReader::readSlab(int z0, int nz, std::vector<float>& slab) {
+    if (z0 < 0 || z0 >= D_) {
+        throw std::runtime_error("Slab start outside volume");
+    }
+    nz = std::min(nz, D_ - z0);
+    slab.resize(static_cast<size_t>(W_) * H_ * nz);
+
+    if (binary_) {
+        readBinary(z0, nz, slab);
+    } else {
+        readASCII(z0, nz, slab);
+    }
+}
+
+void VTKSlabReader::readBinary(int z0, int nz, std::vector<float>& slab) {
+    size_t sliceValues = static_cast<size_t>(W_) * H_;
+    size_t stride = bytesPerValue_ * numComponents_;
+    size_t slabValues = sliceValues * nz;
+
+    rawBuffer_.resize(slabValues * stride);
+    std::streamoff offset = dataOffset_ +
+        static_cast<std::streamoff>(sliceValues * z0 * stride);
+    file_.clear();
+    file_.seekg(offset);
+    file_.read(rawBuffer_.data(), rawBuffer_.size());
+    if (static_cast<size_t>(file_.gcount()) != rawBuffer_.size()) {
+        throw std::runtime_error("Unexpected end of VTK data in: " + filename_);
+    }
+
+    const char* src = rawBuffer_.data();
+    float* dst = slab.data();
+    if (scalarType_ == "unsigned_char" || scalarType_ == "uint8") {
+        convertBigEndian<uint8_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "char") {
+        convertBigEndian<int8_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "unsigned_short" || scalarType_ == "uint16") {
+        convertBigEndian<uint16_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "short") {
+        convertBigEndian<int16_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "unsigned_int") {
+        convertBigEndian<uint32_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "int") {
+        convertBigEndian<int32_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "float") {
+        convertBigEndian<float>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "unsigned_long") {
+        convertBigEndian<uint64_t>(src, slabValues, stride, dst);
+    } else if (scalarType_ == "long") {
+        convertBigEndian<int64_t>(src, slabValues, stride, dst);
+    } else {
+        convertBigEndian<double>(src, slabValues, stride, dst);
+    }
+}
+
+void VTKSlabReader::readASCII(int z0, int nz, std::vector<float>& slab) {
+    size_t sliceValues = static_cast<size_t>(W_) * H_ * numComponents_;
+
+    // ASCII data cannot be seeked; rewind if an earlier slab is requested
+    if (z0 < nextASCIISlice_) {
+        open();
+    }
+
+    double val;
+    for (size_t i = 0; i < sliceValues * (z0 - nextASCIISlice_); ++i) {
+        if (!(file_ >> val)) {
+            throw std::runtime_error("Unexpected end of VTK data in: " + filename_);
+        }
+    }
+
+    size_t slabValues = static_cast<size_t>(W_) * H_ * nz;
+    for (size_t i = 0; i < slabValues; ++i) {
+        for (int c = 0; c < numComponents_; ++c) {
+            if (!(file_ >> val)) {
+                throw std::runtime_error("Unexpected end of VTK data in: " + filename_);
+            }
+            if (c == 0) slab[i] = static_cast<float>(val);
+        }
+    }
+    nextASCIISlice_ = z0 + nz;
+}
@@ -0,0 +1,53 @@
+#ifndef VTKSLABREADER_H
+#define VTKSLABREADER_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Reads a legacy VTK STRUCTURED_POINTS file one Z-slab at a time, so volumes
+// larger than RAM can be processed without materializing the full dataset.
+// BINARY files are read with random access; ASCII files are read forward and
+// rewound (reopened) when an earlier slab is requested.
+class VTKSlabReader {
+public:
+    explicit VTKSlabReader(const std::string& filename);
+
+    int width() const { return W_; }
+    int height() const { return H_; }
+    int depth() const { return D_; }
+    const double* origin() const { return origin_; }
+    const double* spacing() const { return spacing_; }
+    const std::string& scalarType() const { return scalarType_; }
+
+    // Size in bytes of one stored scalar component (e.g. 1 for unsigned_char)
+    size_t bytesPerValue() const { return bytesPerValue_; }
+    int numComponents() const { return numComponents_; }
+
+    // Reads slices [z0, z0 + nz) (clamped to the volume depth) as floats into
+    // `slab`, indexed (z - z0) * W * H + y * W + x. Only the first component
+    // of multi-component scalars is kept.
+    void readSlab(int z0, int nz, std::vector<float>& slab);
+
+private:
+    void open();
+    void parseHeader();
+    void readBinary(int z0, int nz, std::vector<float>& slab);
+    void readASCII(int z0, int nz, std::vector<float>& slab);
+
+    std::string filename_;
+    std::ifstream file_;
+    bool binary_;
+    int W_, H_, D_;
+    int numComponents_;
+    double origin_[3];
+    double spacing_[3];
+    std::string scalarType_;
+    size_t bytesPerValue_;
+    std::streamoff dataOffset_;
+    int nextASCIISlice_;
+    std::vector<char> rawBuffer_;
+};
+
+#endif
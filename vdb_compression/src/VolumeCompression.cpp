@@ -0,0 +1,125 @@
+#include "VolumeCompression.h"
+#include "VDBCompressor.h"
+#include <openvdb/io/Stream.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+template <typename T>
+void convertToFloat(const void* data, std::vector<float>& out) {
+    const T* in = static_cast<const T*>(data);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, out.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            out[i] = static_cast<float>(in[i]);
+        }
+    });
+}
+
+// Widens the caller's buffer to the float volume the compressor works on
+void loadBuffer(const VolumeBuffer& volume, std::vector<float>& out) {
+    out.resize(static_cast<size_t>(volume.dims[0]) * volume.dims[1] * volume.dims[2]);
+    switch (volume.type) {
+        case VoxelType::UInt8: convertToFloat<uint8_t>(volume.data, out); break;
+        case VoxelType::Int8: convertToFloat<int8_t>(volume.data, out); break;
+        case VoxelType::UInt16: convertToFloat<uint16_t>(volume.data, out); break;
+        case VoxelType::Int16: convertToFloat<int16_t>(volume.data, out); break;
+        case VoxelType::UInt32: convertToFloat<uint32_t>(volume.data, out); break;
+        case VoxelType::Int32: convertToFloat<int32_t>(volume.data, out); break;
+        case VoxelType::Float32: convertToFloat<float>(volume.data, out); break;
+        case VoxelType::Float64: convertToFloat<double>(volume.data, out); break;
+    }
+}
+
+void configure(VDBCompressor& compressor, const CompressionSettings& settings) {
+    compressor.setErrorBound(settings.maxError, settings.targetPSNR);
+    compressor.setTargetBytes(settings.targetBytes);
+    compressor.setTileTolerance(settings.tileTolerance);
+    compressor.setAdaptiveBackground(settings.adaptiveBackground);
+}
+
+} // namespace
+
+size_t voxelTypeSize(VoxelType type) {
+    switch (type) {
+        case VoxelType::UInt8:
+        case VoxelType::Int8: return 1;
+        case VoxelType::UInt16:
+        case VoxelType::Int16: return 2;
+        case VoxelType::UInt32:
+        case VoxelType::Int32:
+        case VoxelType::Float32: return 4;
+        case VoxelType::Float64: return 8;
+    }
+    return 0;
+}
+
+void validateSettings(const CompressionSettings& settings, int lodLevels) {
+    VDBCompressor compressor;
+    configure(compressor, settings);
+    compressor.validateOptions(settings.brickSize);
+
+    // Per-region backgrounds are inactive tiles that the LOD pyramid and the
+    // uint8/uint16 conversion do not carry over
+    bool narrow = settings.outputType == OutputType::UInt8 || settings.outputType == OutputType::UInt16;
+    if (settings.adaptiveBackground && (narrow || lodLevels > 0)) {
+        throw std::runtime_error("Adaptive background does not support LOD levels or uint8/uint16 output");
+    }
+    // Half and code conversion round the values after the bound was met
+    if ((settings.maxError > 0.0f || settings.targetPSNR > 0.0f) && settings.outputType != OutputType::Float) {
+        throw std::runtime_error("Error-bounded mode (max error/PSNR) needs float output");
+    }
+    // The target-size model is calibrated on the single float grid
+    if (settings.targetBytes > 0 && (settings.outputType != OutputType::Float || lodLevels > 0)) {
+        throw std::runtime_error("Target size does not support LOD levels or non-float output types");
+    }
+}
+
+openvdb::GridBase::Ptr compressBuffer(const VolumeBuffer& volume, const CompressionSettings& settings) {
+    if (!volume.data) {
+        throw std::runtime_error("No volume data to compress");
+    }
+    if (volume.dims[0] < 1 || volume.dims[1] < 1 || volume.dims[2] < 1) {
+        throw std::runtime_error("Invalid volume dimensions");
+    }
+    for (int a = 0; a < 3; ++a) {
+        if (!(volume.spacing[a] > 0.0)) {
+            throw std::runtime_error("Voxel spacing must be positive");
+        }
+    }
+
+    validateSettings(settings);
+
+    openvdb::initialize();
+    registerOutputGridTypes();
+
+    std::vector<float> volumeData;
+    loadBuffer(volume, volumeData);
+
+    VDBCompressor compressor;
+    configure(compressor, settings);
+    openvdb::FloatGrid::Ptr grid = compressor.compressVolume(
+        volumeData, volume.dims[0], volume.dims[1], volume.dims[2],
+        settings.quality, settings.brickSize, settings.metricType);
+    std::vector<float>().swap(volumeData);
+
+    openvdb::math::Transform::Ptr xform = openvdb::math::Transform::createLinearTransform(1.0);
+    xform->preScale(openvdb::Vec3d(volume.spacing[0], volume.spacing[1], volume.spacing[2]));
+    xform->postTranslate(openvdb::Vec3d(volume.origin[0], volume.origin[1], volume.origin[2]));
+    grid->setTransform(xform);
+    grid->setName(settings.gridName);
+
+    return convertOutputGrid(grid, settings.outputType);
+}
+
+std::string compressBufferToBytes(const VolumeBuffer& volume, const CompressionSettings& settings) {
+    openvdb::GridPtrVec grids;
+    grids.push_back(compressBuffer(volume, settings));
+    std::ostringstream ostr(std::ios_base::binary);
+    openvdb::io::Stream(ostr).write(grids);
+    return ostr.str();
+}
@@ -0,0 +1,70 @@
+#ifndef VOLUMECOMPRESSION_H
+#define VOLUMECOMPRESSION_H
+
+#include "OutputPrecision.h"
+#include <openvdb/openvdb.h>
+#include <cstddef>
+#include <string>
+
+// In-memory entry point of libvdbcompress: compresses a dense scalar volume
+// the caller already holds, without files or VTK. The returned grid has a
+// linear transform mapping voxel (i, j, k) to origin + (i, j, k) * spacing,
+// so it lines up with the source volume in world space.
+
+enum class VoxelType {
+    UInt8,
+    Int8,
+    UInt16,
+    Int16,
+    UInt32,
+    Int32,
+    Float32,
+    Float64
+};
+
+// A borrowed view of the caller's volume, x fastest:
+// value (x, y, z) is at element (z * dims[1] + y) * dims[0] + x
+struct VolumeBuffer {
+    const void* data = nullptr;
+    VoxelType type = VoxelType::Float32;
+    int dims[3] = {0, 0, 0};
+    double origin[3] = {0.0, 0.0, 0.0};
+    double spacing[3] = {1.0, 1.0, 1.0};
+};
+
+// The vdb_compressor options that apply to a single in-memory volume
+struct CompressionSettings {
+    float quality = 0.5f;
+    int brickSize = 32;          // <= 0 autotunes (needs maxError or targetPSNR)
+    int metricType = 3;
+    float maxError = 0.0f;
+    float targetPSNR = 0.0f;
+    size_t targetBytes = 0;
+    float tileTolerance = 0.0f;
+    bool adaptiveBackground = false;
+    OutputType outputType = OutputType::Float;
+    std::string gridName = "compressed_volume";
+};
+
+size_t voxelTypeSize(VoxelType type);
+
+// Throws std::runtime_error for settings the compressor cannot honour, e.g.
+// a target size together with an error bound; lodLevels is the number of
+// coarser levels the caller builds from the result (0 = none)
+void validateSettings(const CompressionSettings& settings, int lodLevels = 0);
+
+// Compresses the volume; the grid is a FloatGrid, or a narrow grid of codes
+// for the UInt8/UInt16 output types (see convertOutputGrid). Progress is
+// reported on std::cout as by vdb_compressor. Throws std::runtime_error on
+// invalid input.
+openvdb::GridBase::Ptr compressBuffer(
+    const VolumeBuffer& volume,
+    const CompressionSettings& settings = CompressionSettings());
+
+// compressBuffer, serialized as an OpenVDB stream: the bytes a .vdb file
+// would hold, readable with openvdb::io::Stream
+std::string compressBufferToBytes(
+    const VolumeBuffer& volume,
+    const CompressionSettings& settings = CompressionSettings());
+
+#endif
@@ -0,0 +1,620 @@
+#include "WaveletBrickCodec.h"
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+const char kMagic[4] = {'V', 'W', 'C', '1'};
+
+// Decomposition depth; 5 levels take a 32^3 brick down to a single DC value
+const int kMaxLevels = 5;
+
+// Bisection steps when searching the float quantization step
+const int kStepSearchIterations = 24;
+
+template <typename T>
+void writePod(std::ofstream& out, const T& value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+T readPod(std::ifstream& in) {
+    T value;
+    in.read(reinterpret_cast<char*>(&value), sizeof(T));
+    if (!in) {
+        throw std::runtime_error("Truncated wavelet stream");
+    }
+    return value;
+}
+
+// Lifting arithmetic; the integer forms floor so that the inverse replays
+// exactly the same rounding and the transform is reversible
+inline float halfSum(float a, float b) { return 0.5f * (a + b); }
+inline int32_t halfSum(int32_t a, int32_t b) { return (a + b) >> 1; }
+inline float quarterSum(float a, float b) { return 0.25f * (a + b); }
+inline int32_t quarterSum(int32_t a, int32_t b) { return (a + b + 2) >> 2; }
+inline float half(float a) { return 0.5f * a; }
+inline int32_t half(int32_t a) { return a >> 1; }
+
+// One lifting level along the first axis of buf[n][bundle]. Every step
+// updates whole rows of `bundle` independent lines, so the inner loops are
+// contiguous and branch-free for the vectorizer. Forward output is the n/2
+// rounded-up low-pass rows followed by the high-pass rows.
+template <typename T>
+void liftForward(T* buf, int n, int bundle, WaveletKind kind, T* tmp) {
+    if (n < 2) {
+        return;
+    }
+    int ne = (n + 1) / 2;
+    int no = n / 2;
+    T* even = tmp;
+    T* odd = tmp + static_cast<size_t>(ne) * bundle;
+    for (int i = 0; i < n; ++i) {
+        T* dst = ((i & 1) ? odd : even) + static_cast<size_t>(i / 2) * bundle;
+        std::memcpy(dst, buf + static_cast<size_t>(i) * bundle, bundle * sizeof(T));
+    }
+
+    if (kind == WaveletKind::CDF53) {
+        for (int k = 0; k < no; ++k) {
+            T* d = odd + static_cast<size_t>(k) * bundle;
+            const T* a = even + static_cast<size_t>(k) * bundle;
+            const T* b = even + static_cast<size_t>(std::min(k + 1, ne - 1)) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                d[j] -= halfSum(a[j], b[j]);
+            }
+        }
+        for (int k = 0; k < ne; ++k) {
+            T* s = even + static_cast<size_t>(k) * bundle;
+            const T* a = odd + static_cast<size_t>(std::min(std::max(k - 1, 0), no - 1)) * bundle;
+            const T* b = odd + static_cast<size_t>(std::min(k, no - 1)) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                s[j] += quarterSum(a[j], b[j]);
+            }
+        }
+    } else {
+        for (int k = 0; k < no; ++k) {
+            T* d = odd + static_cast<size_t>(k) * bundle;
+            T* s = even + static_cast<size_t>(k) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                d[j] -= s[j];
+                s[j] += half(d[j]);
+            }
+        }
+    }
+
+    std::memcpy(buf, tmp, static_cast<size_t>(n) * bundle * sizeof(T));
+}
+
+template <typename T>
+void liftInverse(T* buf, int n, int bundle, WaveletKind kind, T* tmp) {
+    if (n < 2) {
+        return;
+    }
+    int ne = (n + 1) / 2;
+    int no = n / 2;
+    T* even = buf;
+    T* odd = buf + static_cast<size_t>(ne) * bundle;
+
+    if (kind == WaveletKind::CDF53) {
+        for (int k = 0; k < ne; ++k) {
+            T* s = even + static_cast<size_t>(k) * bundle;
+            const T* a = odd + static_cast<size_t>(std::min(std::max(k - 1, 0), no - 1)) * bundle;
+            const T* b = odd + static_cast<size_t>(std::min(k, no - 1)) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                s[j] -= quarterSum(a[j], b[j]);
+            }
+        }
+        for (int k = 0; k < no; ++k) {
+            T* d = odd + static_cast<size_t>(k) * bundle;
+            const T* a = even + static_cast<size_t>(k) * bundle;
+            const T* b = even + static_cast<size_t>(std::min(k + 1, ne - 1)) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                d[j] += halfSum(a[j], b[j]);
+            }
+        }
+    } else {
+        for (int k = 0; k < no; ++k) {
+            T* d = odd + static_cast<size_t>(k) * bundle;
+            T* s = even + static_cast<size_t>(k) * bundle;
+            for (int j = 0; j < bundle; ++j) {
+                s[j] -= half(d[j]);
+                d[j] += s[j];
+            }
+        }
+    }
+
+    for (int i = 0; i < n; ++i) {
+        const T* src = ((i & 1) ? odd : even) + static_cast<size_t>(i / 2) * bundle;
+        std::memcpy(tmp + static_cast<size_t>(i) * bundle, src, bundle * sizeof(T));
+    }
+    std::memcpy(buf, tmp, static_cast<size_t>(n) * bundle * sizeof(T));
+}
+
+// Extents of the low-pass sub-brick at each decomposition level
+struct LevelExtent {
+    int lx, ly, lz;
+};
+
+std::vector<LevelExtent> levelExtents(int nx, int ny, int nz) {
+    std::vector<LevelExtent> levels;
+    LevelExtent e = {nx, ny, nz};
+    while (static_cast<int>(levels.size()) < kMaxLevels && (e.lx > 1 || e.ly > 1 || e.lz > 1)) {
+        levels.push_back(e);
+        e.lx = (e.lx + 1) / 2;
+        e.ly = (e.ly + 1) / 2;
+        e.lz = (e.lz + 1) / 2;
+    }
+    return levels;
+}
+
+// Separable 3D transform of the low-pass corner [0,lx) x [0,ly) x [0,lz).
+// Each axis is gathered into a [n][bundle] line buffer first: x lines are
+// bundled per z-plane (transposed), y lines per plane and z lines over the
+// whole plane.
+template <typename T>
+void transformLevel(std::vector<T>& c, int nx, int ny, const LevelExtent& e,
+                    WaveletKind kind, bool inverse, std::vector<T>& lines, std::vector<T>& tmp) {
+    size_t plane = static_cast<size_t>(e.lx) * e.ly;
+    lines.resize(plane * e.lz);
+    tmp.resize(lines.size());
+    auto lift = [&](int n, int bundle) {
+        if (inverse) {
+            liftInverse(lines.data(), n, bundle, kind, tmp.data());
+        } else {
+            liftForward(lines.data(), n, bundle, kind, tmp.data());
+        }
+    };
+    auto at = [&](int x, int y, int z) -> T& {
+        return c[(static_cast<size_t>(z) * ny + y) * nx + x];
+    };
+
+    auto axisX = [&]() {
+        for (int z = 0; z < e.lz; ++z) {
+            for (int y = 0; y < e.ly; ++y)
+                for (int x = 0; x < e.lx; ++x)
+                    lines[static_cast<size_t>(x) * e.ly + y] = at(x, y, z);
+            lift(e.lx, e.ly);
+            for (int y = 0; y < e.ly; ++y)
+                for (int x = 0; x < e.lx; ++x)
+                    at(x, y, z) = lines[static_cast<size_t>(x) * e.ly + y];
+        }
+    };
+    auto axisY = [&]() {
+        for (int z = 0; z < e.lz; ++z) {
+            for (int y = 0; y < e.ly; ++y)
+                std::memcpy(&lines[static_cast<size_t>(y) * e.lx], &at(0, y, z), e.lx * sizeof(T));
+            lift(e.ly, e.lx);
+            for (int y = 0; y < e.ly; ++y)
+                std::memcpy(&at(0, y, z), &lines[static_cast<size_t>(y) * e.lx], e.lx * sizeof(T));
+        }
+    };
+    auto axisZ = [&]() {
+        for (int z = 0; z < e.lz; ++z)
+            for (int y = 0; y < e.ly; ++y)
+                std::memcpy(&lines[z * plane + static_cast<size_t>(y) * e.lx], &at(0, y, z), e.lx * sizeof(T));
+        lift(e.lz, static_cast<int>(plane));
+        for (int z = 0; z < e.lz; ++z)
+            for (int y = 0; y < e.ly; ++y)
+                std::memcpy(&at(0, y, z), &lines[z * plane + static_cast<size_t>(y) * e.lx], e.lx * sizeof(T));
+    };
+
+    if (inverse) {
+        axisZ();
+        axisY();
+        axisX();
+    } else {
+        axisX();
+        axisY();
+        axisZ();
+    }
+}
+
+template <typename T>
+void forward3D(std::vector<T>& c, int nx, int ny, int nz, WaveletKind kind) {
+    std::vector<T> lines, tmp;
+    for (const auto& e : levelExtents(nx, ny, nz)) {
+        transformLevel(c, nx, ny, e, kind, false, lines, tmp);
+    }
+}
+
+template <typename T>
+void inverse3D(std::vector<T>& c, int nx, int ny, int nz, WaveletKind kind) {
+    std::vector<T> lines, tmp;
+    std::vector<LevelExtent> levels = levelExtents(nx, ny, nz);
+    for (auto it = levels.rbegin(); it != levels.rend(); ++it) {
+        transformLevel(c, nx, ny, *it, kind, true, lines, tmp);
+    }
+}
+
+// Dead-zone quantization: |c| in [q, q+1) * step maps to q and is rebuilt at
+// the bin midpoint
+void quantize(const std::vector<float>& coeffs, float step, std::vector<int32_t>& codes) {
+    float limit = static_cast<float>(std::numeric_limits<int32_t>::max() / 2);
+    float inv = 1.0f / step;
+    codes.resize(coeffs.size());
+    for (size_t i = 0; i < coeffs.size(); ++i) {
+        codes[i] = static_cast<int32_t>(std::max(-limit, std::min(limit, coeffs[i] * inv)));
+    }
+}
+
+void quantize(const std::vector<int32_t>& coeffs, float step, std::vector<int32_t>& codes) {
+    int32_t q = static_cast<int32_t>(step);
+    codes.resize(coeffs.size());
+    for (size_t i = 0; i < coeffs.size(); ++i) {
+        codes[i] = coeffs[i] / q;
+    }
+}
+
+void dequantize(const std::vector<int32_t>& codes, float step, std::vector<float>& coeffs) {
+    coeffs.resize(codes.size());
+    for (size_t i = 0; i < codes.size(); ++i) {
+        int32_t q = codes[i];
+        coeffs[i] = (q == 0) ? 0.0f : (static_cast<float>(q) + (q > 0 ? 0.5f : -0.5f)) * step;
+    }
+}
+
+void dequantize(const std::vector<int32_t>& codes, float step, std::vector<int32_t>& coeffs) {
+    int32_t q = static_cast<int32_t>(step);
+    int32_t mid = q / 2;
+    coeffs.resize(codes.size());
+    for (size_t i = 0; i < codes.size(); ++i) {
+        int32_t v = codes[i];
+        coeffs[i] = v * q + (v > 0 ? mid : (v < 0 ? -mid : 0));
+    }
+}
+
+void putVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t getVarint(const std::vector<uint8_t>& in, size_t& pos) {
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (pos >= in.size()) {
+            throw std::runtime_error("Truncated wavelet brick");
+        }
+        uint8_t byte = in[pos++];
+        value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return value;
+        }
+    }
+    throw std::runtime_error("Invalid varint in wavelet brick");
+}
+
+// Nonzero codes as (zero run, zigzag value) pairs; trailing zeros are implicit
+void packCodes(const std::vector<int32_t>& codes, std::vector<uint8_t>& out) {
+    out.clear();
+    uint32_t run = 0;
+    for (int32_t q : codes) {
+        if (q == 0) {
+            ++run;
+            continue;
+        }
+        putVarint(out, run);
+        putVarint(out, (static_cast<uint32_t>(q) << 1) ^ static_cast<uint32_t>(q >> 31));
+        run = 0;
+    }
+}
+
+void unpackCodes(const std::vector<uint8_t>& in, size_t count, std::vector<int32_t>& codes) {
+    codes.assign(count, 0);
+    size_t pos = 0;
+    size_t index = 0;
+    while (pos < in.size()) {
+        index += getVarint(in, pos);
+        uint32_t zz = getVarint(in, pos);
+        if (index >= count) {
+            throw std::runtime_error("Wavelet brick coefficient out of range");
+        }
+        codes[index++] = static_cast<int32_t>(zz >> 1) ^ -static_cast<int32_t>(zz & 1);
+    }
+}
+
+} // namespace
+
+size_t WaveletVolume::byteSize() const {
+    size_t bytes = sizeof(kMagic) + 4 * sizeof(int32_t) + 2 * sizeof(uint8_t) + sizeof(float) + sizeof(uint64_t);
+    for (const auto& brick : bricks) {
+        bytes += 6 * sizeof(int32_t) + 2 * sizeof(float) + sizeof(uint32_t) + brick.data.size();
+    }
+    return bytes;
+}
+
+WaveletBrickCodec::WaveletBrickCodec(WaveletKind kind, bool integerReversible, float targetRMSE, float inputStep)
+    : kind_(kind), integer_(integerReversible), targetRMSE_(targetRMSE), inputStep_(inputStep) {
+    if (integer_ && inputStep_ <= 0.0f) {
+        throw std::runtime_error("Integer wavelet mode needs a positive input step");
+    }
+    if (!integer_ && targetRMSE_ <= 0.0f) {
+        throw std::runtime_error("Float wavelet mode needs a positive target RMSE");
+    }
+}
+
+WaveletKind WaveletBrickCodec::parseKind(const std::string& name) {
+    if (name == "haar") return WaveletKind::Haar;
+    if (name == "cdf53") return WaveletKind::CDF53;
+    throw std::runtime_error("Unknown wavelet: " + name + " (expected haar or cdf53)");
+}
+
+template <typename T>
+void WaveletBrickCodec::reconstruct(const std::vector<int32_t>& codes, int nx, int ny, int nz,
+                                    float step, float offset, float* out) const {
+    std::vector<T> coeffs;
+    dequantize(codes, step, coeffs);
+    inverse3D(coeffs, nx, ny, nz, kind_);
+    float scale = integer_ ? inputStep_ : 1.0f;
+    for (size_t i = 0; i < coeffs.size(); ++i) {
+        out[i] = offset + static_cast<float>(coeffs[i]) * scale;
+    }
+}
+
+WaveletBrick WaveletBrickCodec::encode(const float* values, int nx, int ny, int nz) const {
+    WaveletBrick brick;
+    brick.x = brick.y = brick.z = 0;
+    brick.nx = nx;
+    brick.ny = ny;
+    brick.nz = nz;
+    brick.step = 0.0f;
+
+    size_t count = static_cast<size_t>(nx) * ny * nz;
+    auto range = std::minmax_element(values, values + count);
+    brick.offset = *range.first;
+    float span = *range.second - *range.first;
+    if (span <= 0.0f) {
+        return brick; // Constant brick, no coefficients needed
+    }
+
+    std::vector<int32_t> codes;
+    std::vector<float> decoded(count);
+    auto rmseFor = [&](float step) {
+        if (integer_) {
+            reconstruct<int32_t>(codes, nx, ny, nz, step, brick.offset, decoded.data());
+        } else {
+            reconstruct<float>(codes, nx, ny, nz, step, brick.offset, decoded.data());
+        }
+        double sumSq = 0.0;
+        for (size_t i = 0; i < count; ++i) {
+            double diff = decoded[i] - values[i];
+            sumSq += diff * diff;
+        }
+        return std::sqrt(sumSq / count);
+    };
+
+    if (integer_) {
+        std::vector<int32_t> coeffs(count);
+        for (size_t i = 0; i < count; ++i) {
+            coeffs[i] = static_cast<int32_t>(std::lround((values[i] - brick.offset) / inputStep_));
+        }
+        forward3D(coeffs, nx, ny, nz, kind_);
+
+        // Largest integer step meeting the target; 1 keeps every coefficient
+        int32_t best = 1;
+        if (targetRMSE_ > 0.0f) {
+            int32_t lo = 2;
+            int32_t hi = static_cast<int32_t>(std::min(2.0f * span / inputStep_ + 2.0f, 1.0e9f));
+            while (lo <= hi) {
+                int32_t mid = lo + (hi - lo) / 2;
+                quantize(coeffs, static_cast<float>(mid), codes);
+                if (rmseFor(static_cast<float>(mid)) <= targetRMSE_) {
+                    best = mid;
+                    lo = mid + 1;
+                } else {
+                    hi = mid - 1;
+                }
+            }
+        }
+        brick.step = static_cast<float>(best);
+        quantize(coeffs, brick.step, codes);
+    } else {
+        std::vector<float> coeffs(values, values + count);
+        for (float& v : coeffs) {
+            v -= brick.offset;
+        }
+        forward3D(coeffs, nx, ny, nz, kind_);
+
+        // Bisect log(step) between a step that drops everything and one well
+        // below float precision of the brick range
+        float lo = span * 1.0e-7f;
+        float hi = span * 2.0f;
+        quantize(coeffs, hi, codes);
+        if (rmseFor(hi) <= targetRMSE_) {
+            lo = hi;
+        } else {
+            for (int i = 0; i < kStepSearchIterations; ++i) {
+                float mid = std::sqrt(lo * hi);
+                quantize(coeffs, mid, codes);
+                if (rmseFor(mid) <= targetRMSE_) {
+                    lo = mid;
+                } else {
+                    hi = mid;
+                }
+            }
+        }
+        brick.step = lo;
+        quantize(coeffs, brick.step, codes);
+    }
+
+    packCodes(codes, brick.data);
+    return brick;
+}
+
+void WaveletBrickCodec::decode(const WaveletBrick& brick, float* out) const {
+    size_t count = static_cast<size_t>(brick.nx) * brick.ny * brick.nz;
+    if (brick.step <= 0.0f) {
+        std::fill(out, out + count, brick.offset);
+        return;
+    }
+    std::vector<int32_t> codes;
+    unpackCodes(brick.data, count, codes);
+    if (integer_) {
+        reconstruct<int32_t>(codes, brick.nx, brick.ny, brick.nz, brick.step, brick.offset, out);
+    } else {
+        reconstruct<float>(codes, brick.nx, brick.ny, brick.nz, brick.step, brick.offset, out);
+    }
+}
+
+WaveletVolume WaveletBrickCodec::encodeVolume(
+    const std::vector<float>& volumeData, int W, int H, int D, int brickSize) const {
+
+    WaveletVolume volume;
+    volume.W = W;
+    volume.H = H;
+    volume.D = D;
+    volume.brickSize = brickSize;
+    volume.kind = kind_;
+    volume.integerReversible = integer_;
+    volume.inputStep = integer_ ? inputStep_ : 1.0f;
+
+    int bricksX = (W + brickSize - 1) / brickSize;
+    int bricksY = (H + brickSize - 1) / brickSize;
+    int bricksZ = (D + brickSize - 1) / brickSize;
+    volume.bricks.resize(static_cast<size_t>(bricksX) * bricksY * bricksZ);
+
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, volume.bricks.size()),
+        [&](const tbb::blocked_range<size_t>& r) {
+            std::vector<float> values;
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                int x = static_cast<int>(i % bricksX) * brickSize;
+                int y = static_cast<int>((i / bricksX) % bricksY) * brickSize;
+                int z = static_cast<int>(i / (static_cast<size_t>(bricksX) * bricksY)) * brickSize;
+                int nx = std::min(brickSize, W - x);
+                int ny = std::min(brickSize, H - y);
+                int nz = std::min(brickSize, D - z);
+
+                values.resize(static_cast<size_t>(nx) * ny * nz);
+                for (int k = 0; k < nz; ++k) {
+                    for (int j = 0; j < ny; ++j) {
+                        const float* row = &volumeData[static_cast<size_t>(z + k) * W * H + static_cast<size_t>(y + j) * W + x];
+                        std::copy(row, row + nx, values.begin() + (static_cast<size_t>(k) * ny + j) * nx);
+                    }
+                }
+
+                WaveletBrick& brick = volume.bricks[i];
+                brick = encode(values.data(), nx, ny, nz);
+                brick.x = x;
+                brick.y = y;
+                brick.z = z;
+            }
+        });
+    return volume;
+}
+
+void WaveletBrickCodec::decodeVolume(const WaveletVolume& volume, std::vector<float>& volumeData) {
+    int W = volume.W, H = volume.H;
+    volumeData.assign(static_cast<size_t>(W) * H * volume.D, 0.0f);
+
+    // The target only matters when encoding
+    WaveletBrickCodec codec(volume.kind, volume.integerReversible, 1.0f, volume.inputStep);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, volume.bricks.size()),
+        [&](const tbb::blocked_range<size_t>& r) {
+            std::vector<float> values;
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                const WaveletBrick& brick = volume.bricks[i];
+                values.resize(static_cast<size_t>(brick.nx) * brick.ny * brick.nz);
+                codec.decode(brick, values.data());
+                for (int k = 0; k < brick.nz; ++k) {
+                    for (int j = 0; j < brick.ny; ++j) {
+                        const float* src = &values[(static_cast<size_t>(k) * brick.ny + j) * brick.nx];
+                        std::copy(src, src + brick.nx,
+                                  volumeData.begin() + static_cast<size_t>(brick.z + k) * W * H +
+                                  static_cast<size_t>(brick.y + j) * W + brick.x);
+                    }
+                }
+            }
+        });
+}
+
+void WaveletBrickCodec::write(const WaveletVolume& volume, const std::string& filename) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) {
+        throw std::runtime_error("Failed to open for writing: " + filename);
+    }
+
+    out.write(kMagic, sizeof(kMagic));
+    writePod<int32_t>(out, volume.W);
+    writePod<int32_t>(out, volume.H);
+    writePod<int32_t>(out, volume.D);
+    writePod<int32_t>(out, volume.brickSize);
+    writePod<uint8_t>(out, static_cast<uint8_t>(volume.kind));
+    writePod<uint8_t>(out, volume.integerReversible ? 1 : 0);
+    writePod<float>(out, volume.inputStep);
+    writePod<uint64_t>(out, volume.bricks.size());
+
+    for (const auto& brick : volume.bricks) {
+        writePod<int32_t>(out, brick.x);
+        writePod<int32_t>(out, brick.y);
+        writePod<int32_t>(out, brick.z);
+        writePod<int32_t>(out, brick.nx);
+        writePod<int32_t>(out, brick.ny);
+        writePod<int32_t>(out, brick.nz);
+        writePod<float>(out, brick.offset);
+        writePod<float>(out, brick.step);
+        writePod<uint32_t>(out, static_cast<uint32_t>(brick.data.size()));
+        out.write(reinterpret_cast<const char*>(brick.data.data()), brick.data.size());
+    }
+
+    if (!out) {
+        throw std::runtime_error("Failed to write: " + filename);
+    }
+}
+
+WaveletVolume WaveletBrickCodec::read(const std::string& filename) {
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) {
+        throw std::runtime_error("Failed to open: " + filename);
+    }
+
+    char magic[sizeof(kMagic)];
+    in.read(magic, sizeof(magic));
+    if (!in || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+        throw std::runtime_error("Not a wavelet brick stream: " + filename);
+    }
+
+    WaveletVolume volume;
+    volume.W = readPod<int32_t>(in);
+    volume.H = readPod<int32_t>(in);
+    volume.D = readPod<int32_t>(in);
+    volume.brickSize = readPod<int32_t>(in);
+    uint8_t kind = readPod<uint8_t>(in);
+    if (kind > static_cast<uint8_t>(WaveletKind::CDF53)) {
+        throw std::runtime_error("Unknown wavelet in: " + filename);
+    }
+    volume.kind = static_cast<WaveletKind>(kind);
+    volume.integerReversible = readPod<uint8_t>(in) != 0;
+    volume.inputStep = readPod<float>(in);
+    uint64_t count = readPod<uint64_t>(in);
+
+    volume.bricks.resize(count);
+    for (auto& brick : volume.bricks) {
+        brick.x = readPod<int32_t>(in);
+        brick.y = readPod<int32_t>(in);
+        brick.z = readPod<int32_t>(in);
+        brick.nx = readPod<int32_t>(in);
+        brick.ny = readPod<int32_t>(in);
+        brick.nz = readPod<int32_t>(in);
+        brick.offset = readPod<float>(in);
+        brick.step = readPod<float>(in);
+
+        if (brick.x < 0 || brick.y < 0 || brick.z < 0 || brick.nx <= 0 || brick.ny <= 0 || brick.nz <= 0 ||
+            brick.x + brick.nx > volume.W || brick.y + brick.ny > volume.H || brick.z + brick.nz > volume.D) {
+            throw std::runtime_error("Brick outside volume in: " + filename);
+        }
+        brick.data.resize(readPod<uint32_t>(in));
+        in.read(reinterpret_cast<char*>(brick.data.data()), brick.data.size());
+        if (!in) {
+            throw std::runtime_error("Truncated wavelet brick stream: " + filename);
+        }
+    }
+    return volume;
+}
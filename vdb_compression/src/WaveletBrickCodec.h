@@ -0,0 +1,67 @@
+#ifndef WAVELETBRICKCODEC_H
+#define WAVELETBRICKCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-brick 3D wavelet codec. Each brick is transformed with multi-level
+// Haar or CDF 5/3 lifting, coefficients are dead-zone quantized with the
+// coarsest step that keeps the brick RMSE within the target, and the
+// quantized coefficients are stored as zero-run/value varint pairs.
+// The integer-reversible option runs integer lifting on the input snapped
+// to `inputStep`, so a target of 0 is lossless for integer-valued data.
+
+enum class WaveletKind : uint8_t {
+    Haar = 0,
+    CDF53 = 1
+};
+
+struct WaveletBrick {
+    int x, y, z;        // brick origin in voxels
+    int nx, ny, nz;     // brick extent
+    float offset;       // subtracted before the transform (integer mode)
+    float step;         // coefficient quantization step
+    std::vector<uint8_t> data;
+};
+
+struct WaveletVolume {
+    int W = 0, H = 0, D = 0;
+    int brickSize = 0;
+    WaveletKind kind = WaveletKind::CDF53;
+    bool integerReversible = false;
+    float inputStep = 1.0f;
+    std::vector<WaveletBrick> bricks;
+
+    size_t byteSize() const;
+};
+
+class WaveletBrickCodec {
+public:
+    WaveletBrickCodec(WaveletKind kind, bool integerReversible, float targetRMSE, float inputStep = 1.0f);
+
+    // Encodes/decodes a contiguous brick laid out [(z * ny + y) * nx + x]
+    WaveletBrick encode(const float* values, int nx, int ny, int nz) const;
+    void decode(const WaveletBrick& brick, float* out) const;
+
+    // Brick-parallel encode/decode of a whole volume
+    WaveletVolume encodeVolume(const std::vector<float>& volumeData, int W, int H, int D, int brickSize) const;
+    static void decodeVolume(const WaveletVolume& volume, std::vector<float>& volumeData);
+
+    static void write(const WaveletVolume& volume, const std::string& filename);
+    static WaveletVolume read(const std::string& filename);
+
+    static WaveletKind parseKind(const std::string& name);
+
+private:
+    template <typename T>
+    void reconstruct(const std::vector<int32_t>& codes, int nx, int ny, int nz,
+                     float step, float offset, float* out) const;
+
+    WaveletKind kind_;
+    bool integer_;
+    float targetRMSE_;
+    float inputStep_;
+};
+
+#endif
@@ -1,41 +1,344 @@
+#include "OutputPrecision.h"
 #include <openvdb/openvdb.h>
 #include <openvdb/io/File.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using LeafT = openvdb::FloatTree::LeafNodeType;
+using LowerNodeT = openvdb::FloatTree::RootNodeType::ChildNodeType::ChildNodeType;
+using UpperNodeT = openvdb::FloatTree::RootNodeType::ChildNodeType;
+
+// Grid metadata OpenVDB writes itself; reported in the summary lines
+const std::set<std::string> kStandardMeta = {
+    "class", "name", "value_type", "vector_type", "is_local_space", "is_saved_as_half_float",
+    "file_bbox_min", "file_bbox_max", "file_compression", "file_mem_bytes", "file_voxel_count"
+};
+
+// Width of the longest histogram bar
+const int kHistogramWidth = 40;
+
+// Tile levels: 1 = leaf-sized (8^3), 2 = internal node (128^3), 3 = root child (4096^3)
+const int kTileLevels = 4;
+
+struct DeepStats {
+    size_t leaves = 0;
+    size_t denseLeaves = 0;          // all 512 voxels active
+    uint64_t leafVoxels = 0;         // active voxels stored in leaves
+    size_t activeTiles[kTileLevels] = {0};
+    uint64_t tileVoxels[kTileLevels] = {0};
+    size_t inactiveTiles = 0;        // inactive tiles holding a non-background value
+    float minVal = std::numeric_limits<float>::max();
+    float maxVal = std::numeric_limits<float>::lowest();
+    double sum = 0.0;
+    std::vector<uint64_t> histogram;
+    size_t leafBytes = 0;
+    size_t lowerBytes = 0;
+    size_t upperBytes = 0;
+    size_t totalBytes = 0;
+};
+
+// Per-leaf results of the first pass
+struct LeafStats {
+    uint32_t active = 0;
+    float minVal = std::numeric_limits<float>::max();
+    float maxVal = std::numeric_limits<float>::lowest();
+    double sum = 0.0;
+    size_t bytes = 0;
+};
+
+std::string metaString(const openvdb::GridBase& grid, const char* name) {
+    openvdb::Metadata::Ptr meta = grid[name];
+    return meta ? meta->str() : std::string("?");
+}
+
+void printGridMetadata(const openvdb::GridBase& grid) {
+    std::cout << "Grid: " << grid.getName() << std::endl;
+    std::cout << "  Stored type: " << grid.valueType()
+              << (grid.saveFloatAsHalf() ? " (saved as half)" : "") << std::endl;
+    std::cout << "  Grid class: " << openvdb::GridBase::gridClassToString(grid.getGridClass()) << std::endl;
+    std::cout << "  Voxel size: " << grid.transform().voxelSize() << std::endl;
+    std::cout << "  Active voxels: " << metaString(grid, openvdb::GridBase::META_FILE_VOXEL_COUNT) << std::endl;
+    std::cout << "  Active bbox: " << metaString(grid, openvdb::GridBase::META_FILE_BBOX_MIN) << " - "
+              << metaString(grid, openvdb::GridBase::META_FILE_BBOX_MAX) << std::endl;
+    std::cout << "  Memory usage: " << metaString(grid, openvdb::GridBase::META_FILE_MEM_BYTES) << " bytes" << std::endl;
+    for (auto it = grid.beginMeta(); it != grid.endMeta(); ++it) {
+        if (kStandardMeta.count(it->first) || !it->second) continue;
+        std::cout << "  " << it->first << ": " << it->second->str() << std::endl;
+    }
+}
+
+int histogramBin(float value, float lo, float scale, int bins) {
+    return std::max(0, std::min(bins - 1, static_cast<int>((value - lo) * scale)));
+}
+
+// Leaf-parallel statistics of a loaded grid. With delayed loading, leaf
+// buffers are read from the file as the workers first touch them.
+DeepStats analyzeGrid(
+    const openvdb::FloatGrid& grid,
+    int bins,
+    std::ostream* leafCsv,
+    const std::string& label) {
+
+    DeepStats stats;
+    const openvdb::FloatTree& tree = grid.tree();
+    std::vector<const LeafT*> leaves;
+    tree.getNodes(leaves);
+    stats.leaves = leaves.size();
+
+    // Pass 1: per-leaf range, sum and memory
+    std::vector<LeafStats> leafStats(leaves.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, leaves.size()), [&](const tbb::blocked_range<size_t>& r) {
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            LeafStats& s = leafStats[i];
+            for (auto iter = leaves[i]->cbeginValueOn(); iter; ++iter) {
+                float v = *iter;
+                s.minVal = std::min(s.minVal, v);
+                s.maxVal = std::max(s.maxVal, v);
+                s.sum += v;
+                ++s.active;
+            }
+            s.bytes = leaves[i]->memUsage();
+        }
+    });
+    for (const auto& s : leafStats) {
+        stats.leafVoxels += s.active;
+        stats.denseLeaves += s.active == LeafT::SIZE;
+        stats.minVal = std::min(stats.minVal, s.minVal);
+        stats.maxVal = std::max(stats.maxVal, s.maxVal);
+        stats.sum += s.sum;
+        stats.leafBytes += s.bytes;
+    }
+
+    // Tiles above the leaf level; few enough to visit serially
+    std::vector<std::pair<float, uint64_t>> tiles;
+    auto tile = tree.cbeginValueAll();
+    tile.setMaxDepth(tile.getLeafDepth() - 1);
+    for (; tile; ++tile) {
+        if (!tile.isValueOn()) {
+            stats.inactiveTiles += *tile != grid.background();
+            continue;
+        }
+        openvdb::CoordBBox bbox;
+        tile.getBoundingBox(bbox);
+        int level = std::min<int>(tile.getLevel(), kTileLevels - 1);
+        stats.activeTiles[level]++;
+        stats.tileVoxels[level] += bbox.volume();
+        stats.minVal = std::min(stats.minVal, *tile);
+        stats.maxVal = std::max(stats.maxVal, *tile);
+        stats.sum += static_cast<double>(*tile) * bbox.volume();
+        tiles.push_back(std::make_pair(*tile, bbox.volume()));
+    }
+
+    // Pass 2: histograms over the global range, per leaf into a chunk-local
+    // total that is merged once per chunk
+    stats.histogram.assign(bins, 0);
+    float scale = stats.maxVal > stats.minVal ? bins / (stats.maxVal - stats.minVal) : 0.0f;
+    std::mutex mutex;
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, leaves.size()), [&](const tbb::blocked_range<size_t>& r) {
+        std::vector<uint64_t> chunk(bins, 0);
+        std::vector<uint32_t> leafHistogram(bins);
+        std::ostringstream rows;
+        for (size_t i = r.begin(); i != r.end(); ++i) {
+            std::fill(leafHistogram.begin(), leafHistogram.end(), 0);
+            for (auto iter = leaves[i]->cbeginValueOn(); iter; ++iter) {
+                leafHistogram[histogramBin(*iter, stats.minVal, scale, bins)]++;
+            }
+            for (int b = 0; b < bins; ++b) {
+                chunk[b] += leafHistogram[b];
+            }
+            if (leafCsv) {
+                const LeafStats& s = leafStats[i];
+                const openvdb::Coord& origin = leaves[i]->origin();
+                rows << label << "," << origin.x() << "," << origin.y() << "," << origin.z() << ","
+                     << s.active << "," << (s.active ? s.minVal : 0.0f) << "," << (s.active ? s.maxVal : 0.0f)
+                     << "," << (s.active ? s.sum / s.active : 0.0);
+                for (int b = 0; b < bins; ++b) {
+                    rows << "," << leafHistogram[b];
+                }
+                rows << "\n";
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int b = 0; b < bins; ++b) {
+            stats.histogram[b] += chunk[b];
+        }
+        if (leafCsv) {
+            *leafCsv << rows.str();
+        }
+    });
+    for (const auto& t : tiles) {
+        stats.histogram[histogramBin(t.first, stats.minVal, scale, bins)] += t.second;
+    }
+
+    // Memory: leaves measured, internal nodes counted per level, the rest is
+    // the root table
+    std::vector<openvdb::Index32> nodeCount = tree.nodeCount();
+    if (nodeCount.size() > 2) {
+        stats.lowerBytes = nodeCount[1] * sizeof(LowerNodeT);
+        stats.upperBytes = nodeCount[2] * sizeof(UpperNodeT);
+    }
+    stats.totalBytes = tree.memUsage();
+    return stats;
+}
+
+void printDeepStats(const openvdb::FloatGrid& grid, const DeepStats& stats) {
+    uint64_t tileVoxels = 0;
+    size_t activeTiles = 0;
+    for (int level = 1; level < kTileLevels; ++level) {
+        tileVoxels += stats.tileVoxels[level];
+        activeTiles += stats.activeTiles[level];
+    }
+    uint64_t activeVoxels = stats.leafVoxels + tileVoxels;
+
+    std::cout << "  --- Deep statistics ---" << std::endl;
+    std::cout << "  Background value: " << grid.background() << std::endl;
+    openvdb::CoordBBox bbox;
+    if (activeVoxels > 0 && grid.tree().evalActiveVoxelBoundingBox(bbox)) {
+        std::cout << "  Active bbox: " << bbox.min() << " - " << bbox.max() << " (" << bbox.dim() << ")" << std::endl;
+    }
+    std::cout << "  Active voxels: " << activeVoxels << " (" << stats.leafVoxels << " in leaves, "
+              << tileVoxels << " in " << activeTiles << " tiles)" << std::endl;
+    std::cout << "  Leaves: " << stats.leaves << " (" << stats.denseLeaves << " fully active, mean fill "
+              << std::fixed << std::setprecision(1)
+              << (stats.leaves ? 100.0 * stats.leafVoxels / (stats.leaves * LeafT::SIZE) : 0.0) << "%)"
+              << std::defaultfloat << std::endl;
+    const char* tileNames[kTileLevels] = {"", "leaf (8^3)", "internal node (128^3)", "root child (4096^3)"};
+    for (int level = 1; level < kTileLevels; ++level) {
+        if (stats.activeTiles[level] > 0) {
+            std::cout << "  Active " << tileNames[level] << " tiles: " << stats.activeTiles[level] << std::endl;
+        }
+    }
+    if (stats.inactiveTiles > 0) {
+        std::cout << "  Inactive tiles off the background: " << stats.inactiveTiles << std::endl;
+    }
+    if (activeVoxels == 0) {
+        std::cout << "  No active values" << std::endl;
+    } else {
+        std::cout << "  Value range: [" << stats.minVal << ", " << stats.maxVal << "], mean "
+                  << stats.sum / activeVoxels << std::endl;
+        uint64_t peak = *std::max_element(stats.histogram.begin(), stats.histogram.end());
+        int bins = static_cast<int>(stats.histogram.size());
+        double width = static_cast<double>(stats.maxVal - stats.minVal) / bins;
+        std::cout << "  Histogram of active values:" << std::endl;
+        for (int b = 0; b < bins; ++b) {
+            int bar = peak ? static_cast<int>(kHistogramWidth * stats.histogram[b] / peak) : 0;
+            std::cout << "    " << std::setw(12) << stats.minVal + b * width << " " << std::setw(12)
+                      << stats.histogram[b] << " " << std::string(bar, '#') << std::endl;
+        }
+    }
+    size_t nodeBytes = stats.leafBytes + stats.lowerBytes + stats.upperBytes;
+    std::cout << "  Memory: " << stats.totalBytes << " bytes (leaves " << stats.leafBytes
+              << ", internal nodes " << stats.lowerBytes + stats.upperBytes << ", root "
+              << (stats.totalBytes > nodeBytes ? stats.totalBytes - nodeBytes : 0) << ")" << std::endl;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options] <input.vdb> [more.vdb ...]" << std::endl;
+    std::cout << "Lists every grid of every file from the file metadata, without loading voxels." << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --deep                Also load each grid (delayed loading) and report per-leaf statistics:" << std::endl;
+    std::cout << "                        value histogram, bounding box, tile vs voxel counts and memory" << std::endl;
+    std::cout << "  --bins <n>            Histogram bins in deep mode (default 16)" << std::endl;
+    std::cout << "  --leaf-csv <file>     Write per-leaf counts, range, mean and histogram as CSV (implies --deep)" << std::endl;
+}
+
+} // namespace
 
 int main(int argc, char* argv[]) {
-    if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <input.vdb>" << std::endl;
+    std::vector<std::string> files;
+    bool deep = false;
+    int bins = 16;
+    std::string leafCsvFile;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--deep") {
+            deep = true;
+        } else if (arg == "--bins" && i + 1 < argc) {
+            bins = std::atoi(argv[++i]);
+        } else if (arg == "--leaf-csv" && i + 1 < argc) {
+            leafCsvFile = argv[++i];
+            deep = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "✗ Error: Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (bins < 1) {
+        std::cerr << "✗ Error: --bins must be positive" << std::endl;
         return 1;
     }
-    
+
     openvdb::initialize();
-    
-    try {
-        openvdb::io::File file(argv[1]);
-        file.open();
-        
-        openvdb::GridBase::Ptr baseGrid;
-        for (openvdb::io::File::NameIterator nameIter = file.beginName(); 
-             nameIter != file.endName(); ++nameIter) {
-            baseGrid = file.readGrid(nameIter.gridName());
-            break;
-        }
-        file.close();
-        
-        if (auto grid = openvdb::gridPtrCast<openvdb::FloatGrid>(baseGrid)) {
-            std::cout << "=== VDB File Info ===" << std::endl;
-            std::cout << "Grid name: " << grid->getName() << std::endl;
-            std::cout << "Grid class: " << grid->getGridClass() << std::endl;
-            std::cout << "Memory usage: " << grid->memUsage() << " bytes" << std::endl;
-            std::cout << "Active voxels: " << grid->activeVoxelCount() << std::endl;
-            std::cout << "Background value: " << grid->background() << std::endl;
-        } else {
-            std::cout << "Error: Could not read grid as FloatGrid" << std::endl;
+    registerOutputGridTypes();
+
+    std::ofstream leafCsv;
+    if (!leafCsvFile.empty()) {
+        leafCsv.open(leafCsvFile);
+        if (!leafCsv) {
+            std::cerr << "✗ Error: Failed to open for writing: " << leafCsvFile << std::endl;
+            return 1;
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error reading VDB file: " << e.what() << std::endl;
-        return 1;
+        leafCsv << "file,grid,origin_x,origin_y,origin_z,active,min,max,mean";
+        for (int b = 0; b < bins; ++b) {
+            leafCsv << ",bin" << b;
+        }
+        leafCsv << std::endl;
     }
-    
-    return 0;
+
+    int failures = 0;
+    for (const auto& filename : files) {
+        try {
+            openvdb::io::File file(filename);
+            file.open(true);
+            std::cout << "=== " << filename << " (" << file.getSize() << " bytes) ===" << std::endl;
+
+            // Grid descriptors, metadata and transforms only; trees stay on disk
+            openvdb::GridPtrVecPtr grids = file.readAllGridMetadata();
+            if (!grids || grids->empty()) {
+                std::cout << "No grids" << std::endl;
+            } else {
+                for (const auto& meta : *grids) {
+                    printGridMetadata(*meta);
+                    if (!deep) continue;
+
+                    openvdb::GridBase::Ptr baseGrid = file.readGrid(meta->getName());
+                    openvdb::FloatGrid::Ptr grid = restorePhysicalGrid(baseGrid);
+                    if (!grid) {
+                        std::cout << "  (deep statistics need a float, half or quantized grid)" << std::endl;
+                        continue;
+                    }
+                    DeepStats stats = analyzeGrid(*grid, bins, leafCsv.is_open() ? &leafCsv : nullptr,
+                                                  filename + "," + meta->getName());
+                    printDeepStats(*grid, stats);
+                }
+            }
+            file.close();
+        } catch (const std::exception& e) {
+            std::cerr << "✗ Error reading " << filename << ": " << e.what() << std::endl;
+            ++failures;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
 }
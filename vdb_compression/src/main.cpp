@@ -1,46 +1,698 @@
-#include "VDBCompressor.h"
+#include "VDBCompressorVTK.h"
+#include "BatchCompressor.h"
+#include "FixedRateBlockCodec.h"
+#include "LorenzoCodec.h"
+#include "OutputPrecision.h"
+#include "VQCodec.h"
+#include "VolumeCompression.h"
+#include "WaveletBrickCodec.h"
 #include <openvdb/openvdb.h>
 #include <openvdb/io/File.h>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
 #include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Parses a byte count with an optional K/M/G suffix (e.g. "512M", "4G")
+static size_t parseByteSize(const std::string& text) {
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (end == text.c_str() || value < 0) {
+        throw std::runtime_error("Invalid size: " + text);
+    }
+    switch (*end) {
+        case 'k': case 'K': value *= 1024.0; break;
+        case 'm': case 'M': value *= 1024.0 * 1024.0; break;
+        case 'g': case 'G': value *= 1024.0 * 1024.0 * 1024.0; break;
+        case '\0': break;
+        default: throw std::runtime_error("Invalid size suffix: " + text);
+    }
+    return static_cast<size_t>(value);
+}
+
+// Replaces (or appends) the extension of the file name in `path`
+static std::string replaceExtension(const std::string& path, const std::string& extension) {
+    size_t slash = path.find_last_of("/\\");
+    size_t dot = path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return path + extension;
+    }
+    return path.substr(0, dot) + extension;
+}
+
+// Parses a comma-separated list of numbers (e.g. "0.1,0.25,0.5")
+template <typename T>
+static std::vector<T> parseNumberList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        char* end = nullptr;
+        double value = std::strtod(item.c_str(), &end);
+        if (item.empty() || *end != '\0') {
+            throw std::runtime_error("Invalid list: " + text);
+        }
+        values.push_back(static_cast<T>(value));
+    }
+    if (values.empty()) {
+        throw std::runtime_error("Empty list: " + text);
+    }
+    return values;
+}
+
+// Prints the compression ratio and the error of an engine's reconstruction
+static void reportEngineResult(const std::vector<float>& original, const std::vector<float>& decoded, size_t bytes) {
+    double sumSq = 0.0;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < decoded.size(); ++i) {
+        float diff = std::abs(decoded[i] - original[i]);
+        maxError = std::max(maxError, diff);
+        sumSq += static_cast<double>(diff) * diff;
+    }
+    std::cout << "Compressed size: " << bytes << " bytes ("
+              << static_cast<double>(original.size() * sizeof(float)) / bytes << ":1)" << std::endl;
+    std::cout << "Reconstruction RMSE " << std::sqrt(sumSq / decoded.size())
+              << ", max error " << maxError << std::endl;
+}
+
+// Wavelet engine: codes every brick of the volume to a .vwc stream
+static void runWaveletEngine(const std::vector<float>& volumeData, int W, int H, int D,
+                             const std::string& outputFile,
+                             WaveletKind kind, float targetRMSE, float integerStep, int brickSize) {
+    WaveletBrickCodec codec(kind, integerStep > 0.0f, targetRMSE, integerStep > 0.0f ? integerStep : 1.0f);
+    WaveletVolume volume = codec.encodeVolume(volumeData, W, H, D, brickSize);
+    WaveletBrickCodec::write(volume, outputFile);
+
+    std::vector<float> decoded;
+    WaveletBrickCodec::decodeVolume(volume, decoded);
+    std::cout << "Wavelet bricks: " << volume.bricks.size() << std::endl;
+    reportEngineResult(volumeData, decoded, volume.byteSize());
+}
+
+// Fixed-rate engine: codes 4^3 blocks at `rate` bits per voxel to a .vfr stream
+static void runFixedRateEngine(const std::vector<float>& volumeData, int W, int H, int D,
+                               const std::string& outputFile, int rate) {
+    FixedRateBlockCodec codec(rate);
+    FixedRateVolume volume = codec.encodeVolume(volumeData, W, H, D);
+    FixedRateBlockCodec::write(volume, outputFile);
+
+    std::vector<float> decoded;
+    FixedRateBlockCodec::decodeVolume(volume, decoded);
+    std::cout << "Fixed-rate blocks: " << volume.words.size() / rate << " x " << rate * 8 << " bytes" << std::endl;
+    reportEngineResult(volumeData, decoded, volume.byteSize());
+}
+
+// Lorenzo engine: error-bounded prediction coding to a .vlz stream. The
+// decoded volume is checked against the bound on every voxel; returns
+// false if any voxel violates it.
+static bool runLorenzoEngine(const std::vector<float>& volumeData, int W, int H, int D,
+                             const std::string& outputFile, float errorBound) {
+    LorenzoCodec codec(errorBound);
+    LorenzoVolume volume = codec.encodeVolume(volumeData, W, H, D);
+    LorenzoCodec::write(volume, outputFile);
+
+    std::vector<float> decoded;
+    LorenzoCodec::decodeVolume(LorenzoCodec::read(outputFile), decoded);
+    std::cout << "Lorenzo chunks: " << volume.chunks.size() << std::endl;
+    reportEngineResult(volumeData, decoded, volume.byteSize());
+
+    LorenzoVerifyResult check = LorenzoCodec::verify(volumeData, decoded, errorBound);
+    if (check.violations > 0) {
+        std::cerr << "✗ Error bound violated at " << check.violations << " voxels (first at index "
+                  << check.firstViolation << ", max error " << check.maxError << ")" << std::endl;
+        return false;
+    }
+    std::cout << "✓ Error bound " << errorBound << " verified on all " << decoded.size() << " voxels" << std::endl;
+    return true;
+}
+
+// VQ engine: k-means codebook of voxel blocks plus an index volume (.vvq)
+static void runVQEngine(const std::vector<float>& volumeData, int W, int H, int D,
+                        const std::string& outputFile, int codebookSize, int blockDim, bool scaled) {
+    VQCodec codec(codebookSize, blockDim, scaled);
+    VQVolume volume = codec.encodeVolume(volumeData, W, H, D);
+    VQCodec::write(volume, outputFile);
+
+    std::vector<float> decoded;
+    VQCodec::decodeVolume(volume, decoded);
+    std::cout << "VQ codebook: " << volume.codebookSize << " entries of " << blockDim << "^3, "
+              << volume.indices.size() << " block indices" << std::endl;
+    reportEngineResult(volumeData, decoded, volume.byteSize());
+}
+
+static const char* engineExtension(const std::string& engine) {
+    if (engine == "wavelet") return ".vwc";
+    if (engine == "fixed-rate") return ".vfr";
+    if (engine == "lorenzo") return ".vlz";
+    if (engine == "vq") return ".vvq";
+    return ".vdb";
+}
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " <input.vtk> [quality=0.5] [output.vdb] [metric=3] [options]" << std::endl;
+    std::cout << "Quality: 0.1 (high compression) to 1.0 (low compression)" << std::endl;
+    std::cout << "Similarity metrics: " << BrickMetric::describe() << std::endl;
+    std::cout << "  (metrics 4-7 use full brick statistics and are not available with --stream)" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --stream              Out-of-core mode, reads the volume in Z-slabs" << std::endl;
+    std::cout << "  --max-memory <size>   Working memory limit for streaming, e.g. 512M (implies --stream)" << std::endl;
+    std::cout << "  --max-error <value>   Error-bounded mode: max absolute reconstruction error" << std::endl;
+    std::cout << "  --psnr <dB>           Error-bounded mode: minimum reconstruction PSNR" << std::endl;
+    std::cout << "  --brick-size <n|auto> Brick edge in voxels (default 32); auto needs --max-error/--psnr" << std::endl;
+    std::cout << "  --tile-tolerance <v>  Store leaves/nodes spanning <= 2v as constant tiles (default 0, <0 off)" << std::endl;
+    std::cout << "  --adaptive-background Estimate the background per 128^3 region instead of globally" << std::endl;
+    std::cout << "  --quantize <8|16|auto> Also write selected bricks as a quantized stream (<output>.qbs)" << std::endl;
+    std::cout << "  --quantize-error <v>  Max quantization error; bricks escalate to more bits to meet it" << std::endl;
+    std::cout << "  --container <codec>   Also write selected bricks to a random-access container (<output>.vbc)," << std::endl;
+    std::cout << "                        compressed per brick with lz4, zstd or none" << std::endl;
+    std::cout << "  --target-bytes <size> Target-size mode: fit the output file in a byte budget, e.g. 64M" << std::endl;
+    std::cout << "  --output-type <type>  Stored value type: float (default), half, uint8 or uint16" << std::endl;
+    std::cout << "                        (narrow types keep value_scale/value_offset metadata)" << std::endl;
+    std::cout << "  --sequence            Time-series mode: the input is a file list (one VTK file per line)" << std::endl;
+    std::cout << "                        or a quoted glob, one file per step; writes keyframes plus" << std::endl;
+    std::cout << "                        per-step grids of changed bricks" << std::endl;
+    std::cout << "  --keyframe-interval <n> Steps between keyframes in sequence mode (default 16, 0 = first only)" << std::endl;
+    std::cout << "  --change-tolerance <v> Max voxel change for a brick to count as unchanged (default 0)" << std::endl;
+    std::cout << "  --batch               Batch mode: the input is a file list or a quoted glob and the" << std::endl;
+    std::cout << "                        output a directory (default: next to each input); reads," << std::endl;
+    std::cout << "                        compression and writes of different files overlap" << std::endl;
+    std::cout << "  --jobs <n>            Worker threads for batch mode (default: all cores)" << std::endl;
+    std::cout << "  --batch-memory <size> Memory limit for files in flight in batch mode, e.g. 8G" << std::endl;
+    std::cout << "  --sweep <q1,q2,...>   Sweep mode: one output per quality and metric from a single" << std::endl;
+    std::cout << "                        decomposition, saved as <output>_<metric>_q<quality>.vdb" << std::endl;
+    std::cout << "  --sweep-metrics <m1,m2,...> Metrics of the sweep (default: the metric argument)" << std::endl;
+    std::cout << "  --stats-cache <file>  Sweep mode: reuse brick statistics from this file, or save them there" << std::endl;
+    std::cout << "  --lod <levels>        Also write <levels> coarser grids (1/2, 1/4, ...) to the same file" << std::endl;
+    std::cout << "  --profile <file>      Write per-phase time, RSS and allocation counts as JSON" << std::endl;
+    std::cout << "  --trace <file>        Write the phases and sampled RSS as a Chrome trace" << std::endl;
+    std::cout << "  --engine <name>       Compression engine: vdb (default), wavelet (.vwc)," << std::endl;
+    std::cout << "                        fixed-rate (.vfr, random access per 4^3 block) or" << std::endl;
+    std::cout << "                        lorenzo (.vlz, pointwise bound given by --max-error) or" << std::endl;
+    std::cout << "                        vq (.vvq, codebook index per block)" << std::endl;
+    std::cout << "  --wavelet <haar|cdf53> Wavelet lifting scheme (default cdf53)" << std::endl;
+    std::cout << "  --wavelet-rmse <v>    Per-brick RMSE target for the wavelet engine" << std::endl;
+    std::cout << "  --integer-step <v>    Integer-reversible lifting on values snapped to v (lossless with" << std::endl;
+    std::cout << "                        --wavelet-rmse 0 for data that is a multiple of v)" << std::endl;
+    std::cout << "  --rate <bits>         Bits per voxel for the fixed-rate engine (1-32, default 8)" << std::endl;
+    std::cout << "  --codebook <n>        VQ codebook entries (default 256; more than 256 uses 16-bit indices)" << std::endl;
+    std::cout << "  --vq-block <2|4>      VQ block edge in voxels (default 4)" << std::endl;
+    std::cout << "  --vq-scale            Store a per-block offset and scale with each VQ index" << std::endl;
+}
 
 int main(int argc, char* argv[]) {
     if (argc < 2) {
-        std::cout << "Usage: " << argv[0] << " <input.vtk> [quality=0.5] [output.vdb] [metric=3]" << std::endl;
-        std::cout << "Quality: 0.1 (high compression) to 1.0 (low compression)" << std::endl;
-        std::cout << "Similarity metrics: 1=closest, 2=farthest, 3=median (recommended)" << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::vector<std::string> positional;
+    bool streaming = false;
+    size_t maxMemory = 0;
+    float maxError = 0.0f;
+    float targetPSNR = 0.0f;
+    size_t targetBytes = 0;
+    int brickSize = 32;
+    float tileTolerance = 0.0f;
+    bool adaptiveBackground = false;
+    int quantizeBits = -1;
+    float quantizeError = 0.0f;
+    std::string containerCodec;
+    OutputType outputType = OutputType::Float;
+    int lodLevels = 0;
+    bool sequence = false;
+    bool batch = false;
+    std::vector<float> sweepQualities;
+    std::vector<int> sweepMetrics;
+    std::string statsCache;
+    std::string profileFile;
+    std::string traceFile;
+    int jobs = 0;
+    size_t batchMemory = 0;
+    int keyframeInterval = 16;
+    float changeTolerance = 0.0f;
+    std::string engine = "vdb";
+    WaveletKind waveletKind = WaveletKind::CDF53;
+    float waveletRMSE = 0.0f;
+    float integerStep = 0.0f;
+    int rate = 8;
+    int codebookSize = 256;
+    int vqBlock = 4;
+    bool vqScale = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--stream") {
+                streaming = true;
+            } else if (arg == "--max-memory" && i + 1 < argc) {
+                maxMemory = parseByteSize(argv[++i]);
+                streaming = true;
+            } else if (arg == "--max-error" && i + 1 < argc) {
+                maxError = std::atof(argv[++i]);
+            } else if (arg == "--psnr" && i + 1 < argc) {
+                targetPSNR = std::atof(argv[++i]);
+            } else if (arg == "--brick-size" && i + 1 < argc) {
+                std::string value = argv[++i];
+                brickSize = (value == "auto") ? 0 : std::atoi(value.c_str());
+                if (brickSize < 0 || (brickSize == 0 && value != "auto")) {
+                    throw std::runtime_error("Invalid brick size: " + value);
+                }
+            } else if (arg == "--tile-tolerance" && i + 1 < argc) {
+                tileTolerance = std::atof(argv[++i]);
+            } else if (arg == "--adaptive-background") {
+                adaptiveBackground = true;
+            } else if (arg == "--quantize" && i + 1 < argc) {
+                std::string value = argv[++i];
+                quantizeBits = (value == "auto") ? 0 : std::atoi(value.c_str());
+                if (quantizeBits != 0 && quantizeBits != 8 && quantizeBits != 16) {
+                    throw std::runtime_error("Invalid quantization bits: " + value);
+                }
+            } else if (arg == "--quantize-error" && i + 1 < argc) {
+                quantizeError = std::atof(argv[++i]);
+            } else if (arg == "--container" && i + 1 < argc) {
+                containerCodec = argv[++i];
+                parseBrickCompression(containerCodec);
+            } else if (arg == "--target-bytes" && i + 1 < argc) {
+                targetBytes = parseByteSize(argv[++i]);
+            } else if (arg == "--output-type" && i + 1 < argc) {
+                outputType = parseOutputType(argv[++i]);
+            } else if (arg == "--sequence") {
+                sequence = true;
+            } else if (arg == "--sweep" && i + 1 < argc) {
+                sweepQualities = parseNumberList<float>(argv[++i]);
+            } else if (arg == "--sweep-metrics" && i + 1 < argc) {
+                sweepMetrics = parseNumberList<int>(argv[++i]);
+            } else if (arg == "--stats-cache" && i + 1 < argc) {
+                statsCache = argv[++i];
+            } else if (arg == "--profile" && i + 1 < argc) {
+                profileFile = argv[++i];
+            } else if (arg == "--trace" && i + 1 < argc) {
+                traceFile = argv[++i];
+            } else if (arg == "--batch") {
+                batch = true;
+            } else if (arg == "--jobs" && i + 1 < argc) {
+                jobs = std::atoi(argv[++i]);
+                if (jobs < 1) {
+                    throw std::runtime_error("Invalid job count: " + std::string(argv[i]));
+                }
+            } else if (arg == "--batch-memory" && i + 1 < argc) {
+                batchMemory = parseByteSize(argv[++i]);
+            } else if (arg == "--keyframe-interval" && i + 1 < argc) {
+                keyframeInterval = std::atoi(argv[++i]);
+                if (keyframeInterval < 0) {
+                    throw std::runtime_error("Invalid keyframe interval: " + std::string(argv[i]));
+                }
+            } else if (arg == "--change-tolerance" && i + 1 < argc) {
+                changeTolerance = std::atof(argv[++i]);
+            } else if (arg == "--lod" && i + 1 < argc) {
+                lodLevels = std::atoi(argv[++i]);
+                if (lodLevels < 0 || lodLevels > 16) {
+                    throw std::runtime_error("Invalid LOD level count: " + std::string(argv[i]));
+                }
+            } else if (arg == "--engine" && i + 1 < argc) {
+                engine = argv[++i];
+                if (engine != "vdb" && engine != "wavelet" && engine != "fixed-rate" &&
+                    engine != "lorenzo" && engine != "vq") {
+                    throw std::runtime_error("Unknown engine: " + engine);
+                }
+            } else if (arg == "--wavelet" && i + 1 < argc) {
+                waveletKind = WaveletBrickCodec::parseKind(argv[++i]);
+            } else if (arg == "--wavelet-rmse" && i + 1 < argc) {
+                waveletRMSE = std::atof(argv[++i]);
+            } else if (arg == "--integer-step" && i + 1 < argc) {
+                integerStep = std::atof(argv[++i]);
+            } else if (arg == "--rate" && i + 1 < argc) {
+                rate = std::atoi(argv[++i]);
+                if (rate < 1 || rate > 32) {
+                    throw std::runtime_error("Invalid rate: " + std::string(argv[i]));
+                }
+            } else if (arg == "--codebook" && i + 1 < argc) {
+                codebookSize = std::atoi(argv[++i]);
+                if (codebookSize < 1 || codebookSize > 65536) {
+                    throw std::runtime_error("Invalid codebook size: " + std::string(argv[i]));
+                }
+            } else if (arg == "--vq-block" && i + 1 < argc) {
+                vqBlock = std::atoi(argv[++i]);
+                if (vqBlock != 2 && vqBlock != 4) {
+                    throw std::runtime_error("Invalid VQ block size: " + std::string(argv[i]));
+                }
+            } else if (arg == "--vq-scale") {
+                vqScale = true;
+            } else if (arg.compare(0, 2, "--") == 0) {
+                throw std::runtime_error("Unknown or incomplete option: " + arg);
+            } else {
+                positional.push_back(arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    bool errorBounded = maxError > 0.0f || targetPSNR > 0.0f;
+    if (streaming && (errorBounded || targetBytes > 0)) {
+        std::cerr << "✗ Error: --max-error/--psnr/--target-bytes are not supported in streaming mode" << std::endl;
         return 1;
     }
-    
-    std::string inputFile = argv[1];
-    float quality = (argc > 2) ? std::atof(argv[2]) : 0.5f;
-    std::string outputFile = (argc > 3) ? argv[3] : "output.vdb";
-    int metricType = (argc > 4) ? std::atoi(argv[4]) : 3;
-    
+    if (streaming && (quantizeBits >= 0 || !containerCodec.empty() || adaptiveBackground)) {
+        std::cerr << "✗ Error: --quantize/--container/--adaptive-background are not supported in streaming mode" << std::endl;
+        return 1;
+    }
+    if (sequence && (streaming || errorBounded || targetBytes > 0 || quantizeBits >= 0 || !containerCodec.empty() || lodLevels > 0 ||
+                     outputType == OutputType::UInt8 || outputType == OutputType::UInt16)) {
+        std::cerr << "✗ Error: --sequence does not support streaming, --max-error/--psnr, --target-bytes, --quantize, --container," << std::endl;
+        std::cerr << "  --lod or narrow output types" << std::endl;
+        return 1;
+    }
+
+    bool sweep = !sweepQualities.empty();
+    if ((!sweepMetrics.empty() || !statsCache.empty()) && !sweep) {
+        std::cerr << "✗ Error: --sweep-metrics and --stats-cache need --sweep" << std::endl;
+        return 1;
+    }
+    if (sweep && (sequence || batch || streaming || errorBounded || targetBytes > 0 || brickSize <= 0 ||
+                  adaptiveBackground || quantizeBits >= 0 || !containerCodec.empty())) {
+        std::cerr << "✗ Error: --sweep does not support --sequence, --batch, streaming, --max-error/--psnr," << std::endl;
+        std::cerr << "  --target-bytes, --brick-size auto, --adaptive-background, --quantize or --container" << std::endl;
+        return 1;
+    }
+    if (sweep) {
+        // Outputs are named by quality and metric name; a repeat would
+        // overwrite an earlier file (unknown metric ids fall back to median)
+        std::vector<float> qualities;
+        for (float q : sweepQualities) {
+            if (std::find(qualities.begin(), qualities.end(), q) == qualities.end()) {
+                qualities.push_back(q);
+            }
+        }
+        sweepQualities.swap(qualities);
+        if (sweepMetrics.empty()) {
+            sweepMetrics.push_back(positional.size() > 3 ? std::atoi(positional[3].c_str()) : 3);
+        }
+        std::vector<int> metrics;
+        std::vector<std::string> names;
+        for (int m : sweepMetrics) {
+            std::string name = BrickMetric::create(m)->name();
+            if (std::find(names.begin(), names.end(), name) == names.end()) {
+                names.push_back(name);
+                metrics.push_back(m);
+            }
+        }
+        sweepMetrics.swap(metrics);
+    }
+
+    if (batch && (sequence || streaming || quantizeBits >= 0 || !containerCodec.empty() ||
+                  !profileFile.empty() || !traceFile.empty())) {
+        std::cerr << "✗ Error: --batch does not support --sequence, streaming, --quantize, --container," << std::endl;
+        std::cerr << "  --profile or --trace" << std::endl;
+        return 1;
+    }
+
+    bool engineErrorBound = engine == "lorenzo" && maxError > 0.0f && targetPSNR <= 0.0f;
+    if (engine != "vdb" && (streaming || (errorBounded && !engineErrorBound) || targetBytes > 0 ||
+                            quantizeBits >= 0 || !containerCodec.empty() || outputType != OutputType::Float ||
+                            adaptiveBackground ||
+                            lodLevels > 0 || sequence || batch || sweep ||
+                            !profileFile.empty() || !traceFile.empty())) {
+        std::cerr << "✗ Error: --engine " << engine << " only supports --brick-size and its own options" << std::endl;
+        return 1;
+    }
+    if (engine == "vdb") {
+        // Cross-option checks of the compressor itself (libvdbcompress)
+        CompressionSettings settings;
+        settings.brickSize = brickSize;
+        settings.maxError = maxError;
+        settings.targetPSNR = targetPSNR;
+        settings.targetBytes = targetBytes;
+        settings.tileTolerance = tileTolerance;
+        settings.adaptiveBackground = adaptiveBackground;
+        settings.outputType = outputType;
+        try {
+            validateSettings(settings, lodLevels);
+        } catch (const std::exception& e) {
+            std::cerr << "✗ Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    if (engine == "lorenzo" && maxError <= 0.0f) {
+        std::cerr << "✗ Error: --engine lorenzo needs --max-error" << std::endl;
+        return 1;
+    }
+    if (engine == "wavelet" && waveletRMSE <= 0.0f && integerStep <= 0.0f) {
+        std::cerr << "✗ Error: --engine wavelet needs --wavelet-rmse and/or --integer-step" << std::endl;
+        return 1;
+    }
+
+    if (positional.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    std::string inputFile = positional[0];
+    float quality = (positional.size() > 1) ? std::atof(positional[1].c_str()) : 0.5f;
+    std::string outputFile = (positional.size() > 2) ? positional[2] : "output.vdb";
+    int metricType = (positional.size() > 3) ? std::atoi(positional[3].c_str()) : 3;
+
+    if (batch) {
+        try {
+            BatchOptions options;
+            options.quality = quality;
+            options.brickSize = brickSize;
+            options.metricType = metricType;
+            options.maxError = maxError;
+            options.targetPSNR = targetPSNR;
+            options.targetBytes = targetBytes;
+            options.tileTolerance = tileTolerance;
+            options.adaptiveBackground = adaptiveBackground;
+            options.outputType = outputType;
+            options.lodLevels = lodLevels;
+            options.outputDir = (positional.size() > 2) ? positional[2] : "";
+            options.jobs = jobs;
+            options.maxMemory = batchMemory;
+            
+            auto start = std::chrono::steady_clock::now();
+            BatchCompressor compressor(options);
+            std::vector<BatchFileResult> results = compressor.run(BatchCompressor::expandInputs(inputFile));
+            BatchCompressor::printSummary(results, std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count());
+            for (const auto& r : results) {
+                if (!r.error.empty()) return 1;
+            }
+        } catch (const std::exception& e) {
+            std::cerr << "✗ Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (engine != "vdb") {
+        try {
+            if (positional.size() <= 2) {
+                outputFile = replaceExtension(outputFile, engineExtension(engine));
+            }
+            std::cout << "=== " << engine << " engine ===" << std::endl;
+            std::cout << "Input: " << inputFile << std::endl;
+
+            int W, H, D;
+            std::vector<float> volumeData;
+            loadVTKVolume(inputFile, volumeData, W, H, D);
+
+            if (engine == "wavelet") {
+                int waveletBrickSize = (brickSize > 0) ? brickSize : 32;
+                std::cout << "Wavelet: " << (waveletKind == WaveletKind::Haar ? "haar" : "cdf53")
+                          << (integerStep > 0.0f ? " (integer-reversible)" : "")
+                          << ", brick size " << waveletBrickSize << ", RMSE target " << waveletRMSE << std::endl;
+                runWaveletEngine(volumeData, W, H, D, outputFile, waveletKind, waveletRMSE, integerStep, waveletBrickSize);
+            } else if (engine == "fixed-rate") {
+                std::cout << "Rate: " << rate << " bits per voxel" << std::endl;
+                runFixedRateEngine(volumeData, W, H, D, outputFile, rate);
+            } else if (engine == "vq") {
+                std::cout << "Codebook: " << codebookSize << " x " << vqBlock << "^3 blocks"
+                          << (vqScale ? " with per-block scale" : "") << std::endl;
+                runVQEngine(volumeData, W, H, D, outputFile, codebookSize, vqBlock, vqScale);
+            } else if (!runLorenzoEngine(volumeData, W, H, D, outputFile, maxError)) {
+                return 1;
+            }
+            std::cout << "✓ Compression completed successfully!" << std::endl;
+            std::cout << "Output saved to: " << outputFile << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << "✗ Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
     try {
         VDBCompressor compressor;
-        
+
         std::cout << "=== OpenVDB Compression ===" << std::endl;
         std::cout << "Input: " << inputFile << std::endl;
-        std::cout << "Quality: " << quality << std::endl;
-        std::cout << "Output: " << outputFile << std::endl;
-        std::cout << "Similarity metric: " << metricType << std::endl;
-        
-        auto compressedGrid = compressor.compressVTKVolume(inputFile, quality, 32, metricType);
-        
-        openvdb::io::File file(outputFile);
+        if (errorBounded) {
+            std::cout << "Error bound:";
+            if (maxError > 0.0f) std::cout << " max error " << maxError;
+            if (targetPSNR > 0.0f) std::cout << " PSNR " << targetPSNR << " dB";
+            std::cout << std::endl;
+        } else if (targetBytes > 0) {
+            std::cout << "Target size: " << targetBytes << " bytes" << std::endl;
+        } else {
+            std::cout << "Quality: " << quality << std::endl;
+        }
+        std::cout << "Output: " << outputFile;
+        if (outputType != OutputType::Float) std::cout << " (" << outputTypeName(outputType) << ")";
+        std::cout << std::endl;
+        std::cout << "Similarity metric: " << metricType << " (" << BrickMetric::create(metricType)->name() << ")" << std::endl;
+        std::cout << "Brick size: " << (brickSize > 0 ? std::to_string(brickSize) : "auto") << std::endl;
+        if (lodLevels > 0) {
+            std::cout << "LOD levels: " << lodLevels << std::endl;
+        }
+        if (sweep) {
+            std::cout << "Mode: sweep over " << sweepQualities.size() << " qualities";
+            if (!statsCache.empty()) std::cout << " (statistics cache " << statsCache << ")";
+            std::cout << std::endl;
+        }
+        if (sequence) {
+            std::cout << "Mode: sequence (keyframe interval " << keyframeInterval
+                      << ", change tolerance " << changeTolerance << ")" << std::endl;
+        }
+        if (streaming) {
+            std::cout << "Mode: streaming";
+            if (maxMemory > 0) std::cout << " (max memory " << maxMemory << " bytes)";
+            std::cout << std::endl;
+        }
+
+        compressor.setErrorBound(maxError, targetPSNR);
+        compressor.setTargetBytes(targetBytes);
+        compressor.setTileTolerance(tileTolerance);
+        compressor.setAdaptiveBackground(adaptiveBackground);
+        compressor.setQuantization(quantizeBits, quantizeError);
+        if (!containerCodec.empty()) {
+            compressor.enableBrickContainer(parseBrickCompression(containerCodec));
+        }
+        compressor.validateOptions(brickSize);
+        bool profiling = !profileFile.empty() || !traceFile.empty();
+        if (profiling) {
+            compressor.profiler().startSampling();
+        }
+        // Prints and saves the phase profile once the output is written
+        auto finishProfile = [&]() {
+            if (!profiling) return;
+            compressor.profiler().stopSampling();
+            compressor.profiler().printSummary(std::cout);
+            if (!profileFile.empty()) {
+                compressor.profiler().writeReport(profileFile);
+                std::cout << "Profile saved to: " << profileFile << std::endl;
+            }
+            if (!traceFile.empty()) {
+                compressor.profiler().writeChromeTrace(traceFile);
+                std::cout << "Chrome trace saved to: " << traceFile << std::endl;
+            }
+        };
+
+        if (sweep) {
+            int W, H, D;
+            std::vector<float> volumeData;
+            loadVTKVolume(inputFile, volumeData, W, H, D, &compressor.profiler());
+            std::vector<openvdb::FloatGrid::Ptr> outputs = compressor.compressSweep(
+                volumeData, W, H, D, sweepQualities, sweepMetrics, brickSize, statsCache);
+            
+            registerOutputGridTypes();
+            for (size_t m = 0; m < sweepMetrics.size(); ++m) {
+                for (size_t q = 0; q < sweepQualities.size(); ++q) {
+                    openvdb::FloatGrid::Ptr grid = outputs[m * sweepQualities.size() + q];
+                    openvdb::GridPtrVec grids;
+                    if (lodLevels > 0) {
+                        PhaseProfiler::Scope phase(&compressor.profiler(), "lod_pyramid");
+                        for (const auto& level : compressor.buildLodPyramid(grid, lodLevels)) {
+                            grids.push_back(convertOutputGrid(level, outputType));
+                        }
+                    } else {
+                        grids.push_back(convertOutputGrid(grid, outputType));
+                    }
+                    std::ostringstream suffix;
+                    suffix << "_" << grid->metaValue<std::string>("sweep_metric") << "_q" << sweepQualities[q] << ".vdb";
+                    std::string sweepFile = replaceExtension(outputFile, suffix.str());
+                    {
+                        PhaseProfiler::Scope phase(&compressor.profiler(), "write");
+                        openvdb::io::File file(sweepFile);
+                        file.write(grids);
+                        file.close();
+                    }
+                    std::cout << "Output saved to: " << sweepFile << std::endl;
+                }
+            }
+            finishProfile();
+            std::cout << "✓ Compression completed successfully!" << std::endl;
+            return 0;
+        }
+
+        if (sequence) {
+            std::vector<openvdb::FloatGrid::Ptr> steps = compressVTKSequence(
+                compressor, BatchCompressor::expandInputs(inputFile), quality, brickSize, metricType, keyframeInterval, changeTolerance);
+            {
+                PhaseProfiler::Scope phase(&compressor.profiler(), "write");
+                openvdb::io::File file(outputFile);
+                openvdb::GridPtrVec grids;
+                for (const auto& step : steps) {
+                    grids.push_back(convertOutputGrid(step, outputType));
+                }
+                file.write(grids);
+                file.close();
+            }
+            finishProfile();
+            std::cout << "✓ Compression completed successfully!" << std::endl;
+            std::cout << "Output saved to: " << outputFile << std::endl;
+            return 0;
+        }
+
+        openvdb::FloatGrid::Ptr compressedGrid;
+        if (streaming) {
+            compressedGrid = compressor.compressVTKVolumeStreaming(inputFile, quality, brickSize, metricType, maxMemory);
+        } else {
+            compressedGrid = compressVTKVolume(compressor, inputFile, quality, brickSize, metricType);
+        }
+
+        registerOutputGridTypes();
         openvdb::GridPtrVec grids;
-        grids.push_back(compressedGrid);
-        file.write(grids);
-        file.close();
-        
+        if (lodLevels > 0) {
+            PhaseProfiler::Scope phase(&compressor.profiler(), "lod_pyramid");
+            for (const auto& level : compressor.buildLodPyramid(compressedGrid, lodLevels)) {
+                grids.push_back(convertOutputGrid(level, outputType));
+            }
+        } else {
+            grids.push_back(convertOutputGrid(compressedGrid, outputType));
+        }
+        {
+            PhaseProfiler::Scope phase(&compressor.profiler(), "write");
+            openvdb::io::File file(outputFile);
+            file.write(grids);
+            file.close();
+        }
+
+        if (quantizeBits >= 0) {
+            std::string streamFile = replaceExtension(outputFile, ".qbs");
+            QuantizedBrickCodec::write(compressor.quantizedBricks(), streamFile);
+            std::cout << "Quantized bricks saved to: " << streamFile << std::endl;
+        }
+        if (compressor.brickContainer()) {
+            std::string containerFile = replaceExtension(outputFile, ".vbc");
+            compressor.brickContainer()->write(containerFile);
+            std::cout << "Brick container saved to: " << containerFile << std::endl;
+        }
+        finishProfile();
+
         std::cout << "✓ Compression completed successfully!" << std::endl;
         std::cout << "Output saved to: " << outputFile << std::endl;
-        
+
     } catch (const std::exception& e) {
         std::cerr << "✗ Error: " << e.what() << std::endl;
         return 1;
     }
-    
+
     return 0;
 }
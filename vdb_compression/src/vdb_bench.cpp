@@ -0,0 +1,427 @@
+#include "VDBCompressorVTK.h"
+#include "QualityMetrics.h"
+#include <openvdb/openvdb.h>
+#include <openvdb/io/Stream.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Benchmark harness: runs the compressor over every combination of dataset,
+// quality, brick size and metric, repeating each run to report the spread
+// of the timings next to size and error.
+
+namespace {
+
+struct Dataset {
+    std::string name;
+    std::vector<float> data;
+    int W = 0, H = 0, D = 0;
+};
+
+struct RunConfig {
+    size_t dataset;
+    float quality;
+    int brickSize;
+    int metricType;
+};
+
+struct Sample {
+    double compressSeconds = 0.0;
+    double serializeSeconds = 0.0;
+    size_t peakRSS = 0;
+    std::vector<PhaseProfiler::Phase> phases;
+};
+
+// One compressor phase over the repeats of a configuration: wall time summed
+// per repeat (a phase can run more than once) and averaged, and the highest
+// RSS seen while it ran
+struct PhaseSummary {
+    std::string name;
+    double meanSeconds = 0.0;
+    size_t peakRSS = 0;
+};
+
+struct RunResult {
+    RunConfig config;
+    std::vector<Sample> samples;
+    size_t outputBytes = 0;
+    size_t activeVoxels = 0;
+    QualityReport quality;
+};
+
+// Silences std::cout for its lifetime (the compressor reports every phase)
+class QuietCout {
+public:
+    explicit QuietCout(bool enabled) : saved_(std::cout.rdbuf()) {
+        if (enabled) std::cout.rdbuf(sink_.rdbuf());
+    }
+    ~QuietCout() { std::cout.rdbuf(saved_); }
+
+private:
+    std::ostringstream sink_;
+    std::streambuf* saved_;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Resets the kernel's peak RSS counter (Linux), so PhaseProfiler::peakRSS()
+// reports the high-water mark of one run instead of the whole process
+void resetPeakRSS() {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    if (clearRefs) {
+        clearRefs << "5";
+    }
+}
+
+template <typename T>
+std::vector<T> parseList(const std::string& text) {
+    std::vector<T> values;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        std::stringstream parser(item);
+        T value;
+        if (!(parser >> value)) {
+            throw std::runtime_error("Invalid list value: " + item);
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+// Synthetic volumes "<kind>:<size>": sphere (smooth radial density on a
+// zero background), blobs (Gaussian blobs on a constant background with
+// low noise) and noise (smoothed white noise, the worst case for bricking)
+Dataset generateDataset(const std::string& spec) {
+    size_t colon = spec.find(':');
+    std::string kind = spec.substr(0, colon);
+    int n = (colon == std::string::npos) ? 64 : std::atoi(spec.c_str() + colon + 1);
+    if (n < 8) {
+        throw std::runtime_error("Synthetic size must be at least 8: " + spec);
+    }
+
+    Dataset dataset;
+    dataset.name = spec;
+    dataset.W = dataset.H = dataset.D = n;
+    dataset.data.resize(static_cast<size_t>(n) * n * n);
+    std::mt19937 rng(12345);
+    float c = 0.5f * (n - 1);
+
+    if (kind == "sphere") {
+        for (int z = 0; z < n; ++z)
+            for (int y = 0; y < n; ++y)
+                for (int x = 0; x < n; ++x) {
+                    float r = std::sqrt((x - c) * (x - c) + (y - c) * (y - c) + (z - c) * (z - c)) / (0.4f * n);
+                    dataset.data[(static_cast<size_t>(z) * n + y) * n + x] = r < 1.0f ? 1000.0f * (1.0f - r * r) : 0.0f;
+                }
+    } else if (kind == "blobs") {
+        std::uniform_real_distribution<float> position(0.1f * n, 0.9f * n);
+        std::uniform_real_distribution<float> radius(0.03f * n, 0.12f * n);
+        std::normal_distribution<float> noise(0.0f, 2.0f);
+        std::vector<float> blobs;
+        for (int b = 0; b < 12; ++b) {
+            blobs.push_back(position(rng));
+            blobs.push_back(position(rng));
+            blobs.push_back(position(rng));
+            blobs.push_back(radius(rng));
+        }
+        for (int z = 0; z < n; ++z)
+            for (int y = 0; y < n; ++y)
+                for (int x = 0; x < n; ++x) {
+                    float v = 100.0f + noise(rng);
+                    for (size_t b = 0; b < blobs.size(); b += 4) {
+                        float dx = x - blobs[b], dy = y - blobs[b + 1], dz = z - blobs[b + 2];
+                        v += 800.0f * std::exp(-(dx * dx + dy * dy + dz * dz) / (2.0f * blobs[b + 3] * blobs[b + 3]));
+                    }
+                    dataset.data[(static_cast<size_t>(z) * n + y) * n + x] = v;
+                }
+    } else if (kind == "noise") {
+        std::uniform_real_distribution<float> value(0.0f, 1000.0f);
+        std::vector<float> raw(dataset.data.size());
+        for (auto& v : raw) v = value(rng);
+        // 3-tap box filter along x to give the noise some correlation
+        for (size_t i = 0; i < raw.size(); ++i) {
+            int x = static_cast<int>(i % n);
+            float left = raw[x > 0 ? i - 1 : i];
+            float right = raw[x < n - 1 ? i + 1 : i];
+            dataset.data[i] = (left + raw[i] + right) / 3.0f;
+        }
+    } else {
+        throw std::runtime_error("Unknown synthetic dataset: " + kind + " (expected sphere, blobs or noise)");
+    }
+    return dataset;
+}
+
+Dataset loadDataset(const std::string& spec) {
+    if (spec.find(".vtk") != std::string::npos) {
+        Dataset dataset;
+        dataset.name = spec;
+        loadVTKVolume(spec, dataset.data, dataset.W, dataset.H, dataset.D);
+        return dataset;
+    }
+    return generateDataset(spec);
+}
+
+void meanStd(const std::vector<Sample>& samples, double Sample::*field, double& mean, double& stddev) {
+    mean = 0.0;
+    for (const auto& s : samples) mean += s.*field;
+    mean /= samples.size();
+    stddev = 0.0;
+    for (const auto& s : samples) stddev += (s.*field - mean) * (s.*field - mean);
+    stddev = samples.size() > 1 ? std::sqrt(stddev / (samples.size() - 1)) : 0.0;
+}
+
+std::vector<PhaseSummary> summarizePhases(const std::vector<Sample>& samples) {
+    std::vector<PhaseSummary> summaries;
+    for (const auto& s : samples) {
+        for (const auto& phase : s.phases) {
+            auto it = std::find_if(summaries.begin(), summaries.end(),
+                                   [&](const PhaseSummary& p) { return p.name == phase.name; });
+            if (it == summaries.end()) {
+                summaries.push_back(PhaseSummary());
+                summaries.back().name = phase.name;
+                it = summaries.end() - 1;
+            }
+            it->meanSeconds += (phase.endSeconds - phase.startSeconds) / samples.size();
+            it->peakRSS = std::max(it->peakRSS, phase.rssPeak);
+        }
+    }
+    return summaries;
+}
+
+std::string jsonNumber(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    std::ostringstream text;
+    text.precision(9);
+    text << value;
+    return text.str();
+}
+
+void writeCSV(const std::vector<RunResult>& results, const std::vector<Dataset>& datasets, std::ostream& out) {
+    out << "dataset,voxels,quality,brick_size,metric,repeats,compress_s_mean,compress_s_std,"
+           "serialize_s_mean,serialize_s_std,voxels_per_s,peak_rss_bytes,output_bytes,ratio,"
+           "active_voxels,rmse,psnr,max_error,ssim_mean,phase_s_mean,phase_peak_rss_bytes" << std::endl;
+    for (const auto& r : results) {
+        const Dataset& d = datasets[r.config.dataset];
+        size_t voxels = d.data.size();
+        double cMean, cStd, sMean, sStd;
+        meanStd(r.samples, &Sample::compressSeconds, cMean, cStd);
+        meanStd(r.samples, &Sample::serializeSeconds, sMean, sStd);
+        size_t rss = 0;
+        for (const auto& s : r.samples) rss = std::max(rss, s.peakRSS);
+        // Phases as "name=value" pairs separated by ';' within one column each
+        std::ostringstream phaseTimes, phaseRSS;
+        for (const auto& p : summarizePhases(r.samples)) {
+            phaseTimes << (phaseTimes.tellp() > 0 ? ";" : "") << p.name << "=" << p.meanSeconds;
+            phaseRSS << (phaseRSS.tellp() > 0 ? ";" : "") << p.name << "=" << p.peakRSS;
+        }
+        out << d.name << "," << voxels << "," << r.config.quality << "," << r.config.brickSize << ","
+            << r.config.metricType << "," << r.samples.size() << "," << cMean << "," << cStd << ","
+            << sMean << "," << sStd << "," << (cMean > 0.0 ? voxels / cMean : 0.0) << "," << rss << ","
+            << r.outputBytes << "," << static_cast<double>(voxels * sizeof(float)) / std::max<size_t>(r.outputBytes, 1)
+            << "," << r.activeVoxels << "," << r.quality.rmse << "," << r.quality.psnr << ","
+            << r.quality.maxError << "," << r.quality.meanSSIM << "," << phaseTimes.str() << ","
+            << phaseRSS.str() << std::endl;
+    }
+}
+
+void writeJSON(const std::vector<RunResult>& results, const std::vector<Dataset>& datasets, std::ostream& out) {
+    out << "[" << std::endl;
+    for (size_t i = 0; i < results.size(); ++i) {
+        const RunResult& r = results[i];
+        const Dataset& d = datasets[r.config.dataset];
+        double cMean, cStd, sMean, sStd;
+        meanStd(r.samples, &Sample::compressSeconds, cMean, cStd);
+        meanStd(r.samples, &Sample::serializeSeconds, sMean, sStd);
+        out << "  {\"dataset\": \"" << d.name << "\", \"dimensions\": [" << d.W << ", " << d.H << ", " << d.D
+            << "], \"quality\": " << jsonNumber(r.config.quality) << ", \"brick_size\": " << r.config.brickSize
+            << ", \"metric\": " << r.config.metricType << "," << std::endl;
+        out << "   \"compress_s\": {\"mean\": " << jsonNumber(cMean) << ", \"std\": " << jsonNumber(cStd)
+            << "}, \"serialize_s\": {\"mean\": " << jsonNumber(sMean) << ", \"std\": " << jsonNumber(sStd)
+            << "}, \"samples\": [";
+        for (size_t s = 0; s < r.samples.size(); ++s) {
+            out << (s ? ", " : "") << "{\"compress_s\": " << jsonNumber(r.samples[s].compressSeconds)
+                << ", \"serialize_s\": " << jsonNumber(r.samples[s].serializeSeconds)
+                << ", \"peak_rss_bytes\": " << r.samples[s].peakRSS << "}";
+        }
+        out << "]," << std::endl;
+        out << "   \"phases\": [";
+        std::vector<PhaseSummary> phases = summarizePhases(r.samples);
+        for (size_t p = 0; p < phases.size(); ++p) {
+            out << (p ? ", " : "") << "{\"name\": \"" << phases[p].name << "\", \"seconds_mean\": "
+                << jsonNumber(phases[p].meanSeconds) << ", \"peak_rss_bytes\": " << phases[p].peakRSS << "}";
+        }
+        out << "]," << std::endl;
+        out << "   \"voxels_per_s\": " << jsonNumber(cMean > 0.0 ? d.data.size() / cMean : 0.0)
+            << ", \"output_bytes\": " << r.outputBytes << ", \"active_voxels\": " << r.activeVoxels
+            << ", \"rmse\": " << jsonNumber(r.quality.rmse) << ", \"psnr\": " << jsonNumber(r.quality.psnr)
+            << ", \"max_error\": " << jsonNumber(r.quality.maxError)
+            << ", \"ssim_mean\": " << jsonNumber(r.quality.meanSSIM) << "}"
+            << (i + 1 < results.size() ? "," : "") << std::endl;
+    }
+    out << "]" << std::endl;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --dataset <spec>      A .vtk file or a synthetic volume <sphere|blobs|noise>:<size>;" << std::endl;
+    std::cout << "                        repeatable (default sphere:96 and blobs:96)" << std::endl;
+    std::cout << "  --quality <list>      Comma-separated qualities (default 0.25,0.5,0.75)" << std::endl;
+    std::cout << "  --brick-size <list>   Comma-separated brick sizes (default 16,32)" << std::endl;
+    std::cout << "  --metric <list>       Comma-separated similarity metrics 1-7 (default 1,2,3)" << std::endl;
+    std::cout << "  --repeat <n>          Runs per configuration (default 3)" << std::endl;
+    std::cout << "  --csv <file>          Write results as CSV" << std::endl;
+    std::cout << "  --json <file>         Write results as JSON" << std::endl;
+    std::cout << "  --verbose             Keep the compressor's own output" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> datasetSpecs;
+    std::vector<float> qualities = {0.25f, 0.5f, 0.75f};
+    std::vector<int> brickSizes = {16, 32};
+    std::vector<int> metrics = {1, 2, 3};
+    int repeats = 3;
+    std::string csvFile;
+    std::string jsonFile;
+    bool verbose = false;
+
+    try {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--dataset" && i + 1 < argc) {
+                datasetSpecs.push_back(argv[++i]);
+            } else if (arg == "--quality" && i + 1 < argc) {
+                qualities = parseList<float>(argv[++i]);
+            } else if (arg == "--brick-size" && i + 1 < argc) {
+                brickSizes = parseList<int>(argv[++i]);
+            } else if (arg == "--metric" && i + 1 < argc) {
+                metrics = parseList<int>(argv[++i]);
+            } else if (arg == "--repeat" && i + 1 < argc) {
+                repeats = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--csv" && i + 1 < argc) {
+                csvFile = argv[++i];
+            } else if (arg == "--json" && i + 1 < argc) {
+                jsonFile = argv[++i];
+            } else if (arg == "--verbose") {
+                verbose = true;
+            } else if (arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else {
+                throw std::runtime_error("Unknown or incomplete option: " + arg);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (datasetSpecs.empty()) {
+        datasetSpecs = {"sphere:96", "blobs:96"};
+    }
+
+    openvdb::initialize();
+    std::vector<RunResult> results;
+
+    try {
+        std::vector<Dataset> datasets;
+        for (const auto& spec : datasetSpecs) {
+            auto start = std::chrono::steady_clock::now();
+            datasets.push_back(loadDataset(spec));
+            const Dataset& d = datasets.back();
+            std::cout << "Dataset " << d.name << ": " << d.W << " x " << d.H << " x " << d.D
+                      << " (" << secondsSince(start) << " s to load)" << std::endl;
+        }
+
+        for (size_t d = 0; d < datasets.size(); ++d) {
+            for (float quality : qualities) {
+                for (int brickSize : brickSizes) {
+                    for (int metricType : metrics) {
+                        RunResult result;
+                        result.config = {d, quality, brickSize, metricType};
+                        const Dataset& dataset = datasets[d];
+                        openvdb::FloatGrid::Ptr grid;
+
+                        for (int rep = 0; rep < repeats; ++rep) {
+                            Sample sample;
+                            grid.reset();
+                            resetPeakRSS();
+
+                            auto start = std::chrono::steady_clock::now();
+                            {
+                                QuietCout quiet(!verbose);
+                                VDBCompressor compressor;
+                                compressor.profiler().startSampling();
+                                grid = compressor.compressVolume(dataset.data, dataset.W, dataset.H, dataset.D,
+                                                                 quality, brickSize, metricType);
+                                compressor.profiler().stopSampling();
+                                sample.phases = compressor.profiler().phases();
+                            }
+                            sample.compressSeconds = secondsSince(start);
+
+                            start = std::chrono::steady_clock::now();
+                            std::ostringstream bytes(std::ios_base::binary);
+                            openvdb::GridPtrVec grids;
+                            grids.push_back(grid);
+                            openvdb::io::Stream(bytes).write(grids);
+                            sample.serializeSeconds = secondsSince(start);
+                            result.outputBytes = static_cast<size_t>(bytes.tellp());
+
+                            sample.peakRSS = PhaseProfiler::peakRSS();
+                            result.samples.push_back(sample);
+                        }
+
+                        result.activeVoxels = grid->activeVoxelCount();
+                        int metricsBrick = grid->metaValue<int>("brick_size");
+                        result.quality = QualityMetrics(grid, metricsBrick).compare(
+                            dataset.data, dataset.W, dataset.H, dataset.D);
+
+                        double mean, stddev;
+                        meanStd(result.samples, &Sample::compressSeconds, mean, stddev);
+                        std::cout << dataset.name << " q=" << quality << " brick=" << brickSize
+                                  << " metric=" << metricType << ": " << mean << " +/- " << stddev << " s, "
+                                  << (mean > 0.0 ? dataset.data.size() / mean : 0.0) << " voxels/s, "
+                                  << result.outputBytes << " bytes, PSNR " << result.quality.psnr << " dB" << std::endl;
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+
+        if (!csvFile.empty()) {
+            std::ofstream out(csvFile);
+            if (!out) throw std::runtime_error("Failed to open for writing: " + csvFile);
+            writeCSV(results, datasets, out);
+            std::cout << "CSV saved to: " << csvFile << std::endl;
+        }
+        if (!jsonFile.empty()) {
+            std::ofstream out(jsonFile);
+            if (!out) throw std::runtime_error("Failed to open for writing: " + jsonFile);
+            writeJSON(results, datasets, out);
+            std::cout << "JSON saved to: " << jsonFile << std::endl;
+        }
+        if (csvFile.empty() && jsonFile.empty()) {
+            writeCSV(results, datasets, std::cout);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
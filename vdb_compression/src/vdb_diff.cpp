@@ -0,0 +1,466 @@
+#include "OutputPrecision.h"
+#include <openvdb/openvdb.h>
+#include <openvdb/io/File.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Voxel-wise comparison of two scalar grids. Work is split over the union of
+// both topologies: every leaf of the union is compared voxel by voxel
+// straight from the leaf buffers, every active tile of the union by value,
+// descending only where one of the trees is finer than the tile. Units run
+// in parallel and merge their results once per chunk.
+
+namespace {
+
+using LeafT = openvdb::FloatTree::LeafNodeType;
+using BoolLeafT = openvdb::BoolTree::LeafNodeType;
+using AccessorT = openvdb::tree::ValueAccessor<const openvdb::FloatTree>;
+
+const int kLeafDim = LeafT::DIM;
+const int kLowerDim = openvdb::FloatTree::RootNodeType::ChildNodeType::ChildNodeType::DIM;
+
+// Edge of a constant region at a tree depth returned by getValueDepth:
+// root tiles and background (-1, 0) cover any region, tiles of the upper and
+// lower internal nodes cover a child node, leaf voxels only themselves
+int constantExtent(int depth) {
+    switch (depth) {
+        case -1:
+        case 0: return std::numeric_limits<int>::max();
+        case 1: return kLowerDim;
+        case 2: return kLeafDim;
+        default: return 1;
+    }
+}
+
+struct DiffStats {
+    uint64_t compared = 0;       // voxels active in both grids
+    uint64_t onlyA = 0;          // active in A only
+    uint64_t onlyB = 0;          // active in B only
+    uint64_t valueDiffs = 0;     // active in both, |B - A| > tolerance
+    double sumAbsDiff = 0.0;
+    double sumSqDiff = 0.0;
+    float maxDiff = 0.0f;
+    openvdb::Coord maxDiffAt;
+    openvdb::CoordBBox changedBBox;
+    bool changed = false;
+
+    void merge(const DiffStats& other) {
+        compared += other.compared;
+        onlyA += other.onlyA;
+        onlyB += other.onlyB;
+        valueDiffs += other.valueDiffs;
+        sumAbsDiff += other.sumAbsDiff;
+        sumSqDiff += other.sumSqDiff;
+        if (other.maxDiff > maxDiff) {
+            maxDiff = other.maxDiff;
+            maxDiffAt = other.maxDiffAt;
+        }
+        if (other.changed) {
+            if (changed) {
+                changedBBox.expand(other.changedBBox);
+            } else {
+                changedBBox = other.changedBBox;
+            }
+            changed = true;
+        }
+    }
+};
+
+// Hashes the block coordinates of changed regions
+struct CoordHash {
+    size_t operator()(const openvdb::Coord& c) const {
+        return (static_cast<size_t>(c.x()) * 73856093) ^ (static_cast<size_t>(c.y()) * 19349663) ^
+               (static_cast<size_t>(c.z()) * 83492791);
+    }
+};
+
+struct ChangedRegion {
+    openvdb::CoordBBox bbox;
+    size_t blocks = 0;
+};
+
+// Results of one parallel chunk: statistics, changed region blocks and the
+// pieces of the difference grid
+struct Chunk {
+    DiffStats stats;
+    std::vector<openvdb::Coord> changedBlocks;
+    std::vector<LeafT*> diffLeaves;
+    std::vector<std::pair<openvdb::CoordBBox, float>> diffFills;
+};
+
+class GridDiff {
+public:
+    GridDiff(const openvdb::FloatGrid& a, const openvdb::FloatGrid& b, float tolerance, int regionSize, bool buildDiff)
+        : a_(a), b_(b), tolerance_(tolerance), regionLog2_(0), buildDiff_(buildDiff) {
+        while ((1 << regionLog2_) < regionSize) ++regionLog2_;
+    }
+
+    void run(DiffStats& stats, std::vector<openvdb::Coord>& changedBlocks, openvdb::FloatGrid::Ptr& diff) {
+        // Topology union: a leaf wherever either tree has one, an active
+        // tile where a tile of one tree is not refined by the other
+        openvdb::BoolTree unionTree(a_.tree(), false, openvdb::TopologyCopy());
+        unionTree.topologyUnion(b_.tree());
+
+        const openvdb::BoolTree& unionTopology = unionTree;
+        std::vector<const BoolLeafT*> leaves;
+        unionTopology.getNodes(leaves);
+        std::vector<openvdb::CoordBBox> tiles;
+        auto tile = unionTopology.cbeginValueOn();
+        tile.setMaxDepth(tile.getLeafDepth() - 1);
+        for (; tile; ++tile) {
+            openvdb::CoordBBox bbox;
+            tile.getBoundingBox(bbox);
+            tiles.push_back(bbox);
+        }
+
+        std::mutex mutex;
+        if (buildDiff_) {
+            diff = openvdb::FloatGrid::create(0.0f);
+            diff->setTransform(a_.transform().copy());
+            diff->setName("difference");
+        }
+        auto mergeChunk = [&](Chunk& chunk) {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.merge(chunk.stats);
+            changedBlocks.insert(changedBlocks.end(), chunk.changedBlocks.begin(), chunk.changedBlocks.end());
+            if (diff) {
+                for (LeafT* leaf : chunk.diffLeaves) {
+                    diff->tree().addLeaf(leaf);
+                }
+                for (const auto& fill : chunk.diffFills) {
+                    diff->tree().fill(fill.first, fill.second, true);
+                }
+            }
+        };
+
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, leaves.size()), [&](const tbb::blocked_range<size_t>& r) {
+            AccessorT accA(a_.tree()), accB(b_.tree());
+            Chunk chunk;
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                compareLeafBlock(leaves[i]->origin(), accA, accB, chunk);
+            }
+            mergeChunk(chunk);
+        });
+        tbb::parallel_for(tbb::blocked_range<size_t>(0, tiles.size()), [&](const tbb::blocked_range<size_t>& r) {
+            AccessorT accA(a_.tree()), accB(b_.tree());
+            Chunk chunk;
+            for (size_t i = r.begin(); i != r.end(); ++i) {
+                compareRegion(tiles[i].min(), tiles[i].dim().x(), accA, accB, chunk);
+            }
+            mergeChunk(chunk);
+        });
+    }
+
+private:
+    void markChanged(const openvdb::Coord& xyz, int dim, Chunk& chunk) const {
+        openvdb::CoordBBox bbox(xyz, xyz.offsetBy(dim - 1));
+        if (chunk.stats.changed) {
+            chunk.stats.changedBBox.expand(bbox);
+        } else {
+            chunk.stats.changedBBox = bbox;
+            chunk.stats.changed = true;
+        }
+        int blocks = std::max(1, dim >> regionLog2_);
+        int step = blocks > 1 ? (1 << regionLog2_) : dim;
+        for (int z = 0; z < blocks; ++z) {
+            for (int y = 0; y < blocks; ++y) {
+                for (int x = 0; x < blocks; ++x) {
+                    openvdb::Coord c = xyz.offsetBy(x * step, y * step, z * step);
+                    chunk.changedBlocks.push_back(openvdb::Coord(c.x() >> regionLog2_, c.y() >> regionLog2_,
+                                                                 c.z() >> regionLog2_));
+                }
+            }
+        }
+    }
+
+    // Compares dim^3 voxels whose values and states are va/aa and vb/ab;
+    // returns true when the region counts as changed
+    bool compareValues(float va, bool aa, float vb, bool ab, uint64_t voxels,
+                       const openvdb::Coord& xyz, DiffStats& stats) const {
+        if (aa != ab) {
+            (aa ? stats.onlyA : stats.onlyB) += voxels;
+            return true;
+        }
+        float d = std::abs(vb - va);
+        stats.compared += voxels;
+        stats.sumAbsDiff += static_cast<double>(d) * voxels;
+        stats.sumSqDiff += static_cast<double>(d) * d * voxels;
+        if (d > stats.maxDiff) {
+            stats.maxDiff = d;
+            stats.maxDiffAt = xyz;
+        }
+        if (d > tolerance_) {
+            stats.valueDiffs += voxels;
+            return true;
+        }
+        return false;
+    }
+
+    // A leaf-sized block: voxels come from the leaf buffers where a tree has
+    // a leaf, otherwise from the constant tile or background covering it
+    void compareLeafBlock(const openvdb::Coord& origin, AccessorT& accA, AccessorT& accB, Chunk& chunk) const {
+        const LeafT* leafA = accA.probeConstLeaf(origin);
+        const LeafT* leafB = accB.probeConstLeaf(origin);
+        float constA = leafA ? 0.0f : accA.getValue(origin);
+        float constB = leafB ? 0.0f : accB.getValue(origin);
+        bool onA = leafA ? false : accA.isValueOn(origin);
+        bool onB = leafB ? false : accB.isValueOn(origin);
+
+        LeafT* diffLeaf = nullptr;
+        bool changed = false;
+        for (openvdb::Index i = 0; i < LeafT::SIZE; ++i) {
+            float va = leafA ? leafA->getValue(i) : constA;
+            bool aa = leafA ? leafA->isValueOn(i) : onA;
+            float vb = leafB ? leafB->getValue(i) : constB;
+            bool ab = leafB ? leafB->isValueOn(i) : onB;
+            if (!aa && !ab) continue;
+
+            openvdb::Coord xyz = origin + LeafT::offsetToLocalCoord(i);
+            if (!compareValues(va, aa, vb, ab, 1, xyz, chunk.stats)) continue;
+            changed = true;
+            if (buildDiff_) {
+                if (!diffLeaf) {
+                    diffLeaf = new LeafT(origin, 0.0f, false);
+                }
+                diffLeaf->setValueOn(i, vb - va);
+            }
+        }
+        if (changed) {
+            markChanged(origin, kLeafDim, chunk);
+        }
+        if (diffLeaf) {
+            chunk.diffLeaves.push_back(diffLeaf);
+        }
+    }
+
+    // An aligned dim^3 region: compared as one value when both trees are
+    // constant over it, otherwise split into child-node-sized regions
+    void compareRegion(const openvdb::Coord& origin, int dim, AccessorT& accA, AccessorT& accB, Chunk& chunk) const {
+        if (dim <= kLeafDim) {
+            compareLeafBlock(origin, accA, accB, chunk);
+            return;
+        }
+        if (constantExtent(accA.getValueDepth(origin)) >= dim && constantExtent(accB.getValueDepth(origin)) >= dim) {
+            float va = accA.getValue(origin), vb = accB.getValue(origin);
+            bool aa = accA.isValueOn(origin), ab = accB.isValueOn(origin);
+            if ((aa || ab) && compareValues(va, aa, vb, ab, static_cast<uint64_t>(dim) * dim * dim, origin, chunk.stats)) {
+                markChanged(origin, dim, chunk);
+                if (buildDiff_) {
+                    chunk.diffFills.push_back(std::make_pair(
+                        openvdb::CoordBBox(origin, origin.offsetBy(dim - 1)), vb - va));
+                }
+            }
+            return;
+        }
+        int child = dim > kLowerDim ? kLowerDim : kLeafDim;
+        for (int z = 0; z < dim; z += child) {
+            for (int y = 0; y < dim; y += child) {
+                for (int x = 0; x < dim; x += child) {
+                    compareRegion(origin.offsetBy(x, y, z), child, accA, accB, chunk);
+                }
+            }
+        }
+    }
+
+    const openvdb::FloatGrid& a_;
+    const openvdb::FloatGrid& b_;
+    float tolerance_;
+    int regionLog2_;
+    bool buildDiff_;
+};
+
+// Groups changed blocks into face-connected regions
+std::vector<ChangedRegion> groupRegions(const std::vector<openvdb::Coord>& blocks, int regionSize) {
+    std::unordered_map<openvdb::Coord, char, CoordHash> pending;
+    for (const auto& c : blocks) {
+        pending[c] = 1;
+    }
+    const int offsets[6][3] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    std::vector<ChangedRegion> regions;
+    std::vector<openvdb::Coord> stack;
+    while (!pending.empty()) {
+        ChangedRegion region;
+        openvdb::Coord seed = pending.begin()->first;
+        pending.erase(pending.begin());
+        stack.push_back(seed);
+        region.bbox = openvdb::CoordBBox(seed, seed);
+        while (!stack.empty()) {
+            openvdb::Coord c = stack.back();
+            stack.pop_back();
+            region.bbox.expand(c);
+            ++region.blocks;
+            for (const auto& o : offsets) {
+                auto it = pending.find(c.offsetBy(o[0], o[1], o[2]));
+                if (it != pending.end()) {
+                    stack.push_back(it->first);
+                    pending.erase(it);
+                }
+            }
+        }
+        // Block coordinates to voxel coordinates
+        region.bbox = openvdb::CoordBBox(
+            openvdb::Coord(region.bbox.min().x() * regionSize, region.bbox.min().y() * regionSize,
+                           region.bbox.min().z() * regionSize),
+            openvdb::Coord((region.bbox.max().x() + 1) * regionSize - 1, (region.bbox.max().y() + 1) * regionSize - 1,
+                           (region.bbox.max().z() + 1) * regionSize - 1));
+        regions.push_back(region);
+    }
+    std::sort(regions.begin(), regions.end(), [](const ChangedRegion& x, const ChangedRegion& y) {
+        return x.blocks > y.blocks;
+    });
+    return regions;
+}
+
+openvdb::FloatGrid::Ptr readGrid(const std::string& filename, std::string& gridName) {
+    openvdb::io::File file(filename);
+    file.open();
+    if (gridName.empty()) {
+        openvdb::io::File::NameIterator nameIter = file.beginName();
+        if (nameIter == file.endName()) {
+            throw std::runtime_error("No grids in: " + filename);
+        }
+        gridName = nameIter.gridName();
+    }
+    openvdb::GridBase::Ptr baseGrid = file.readGrid(gridName);
+    file.close();
+
+    openvdb::FloatGrid::Ptr grid = restorePhysicalGrid(baseGrid);
+    if (!grid) {
+        throw std::runtime_error("Grid " + gridName + " in " + filename + " is not a scalar compressed grid");
+    }
+    return grid;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " <a.vdb> <b.vdb> [options]" << std::endl;
+    std::cout << "Compares B against A voxel by voxel; exits with 0 when they match, 1 when they differ." << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --grid <name>         Grid to compare in both files (default: the first grid of each)" << std::endl;
+    std::cout << "  --grid-a <name>       Grid to compare in A" << std::endl;
+    std::cout << "  --grid-b <name>       Grid to compare in B" << std::endl;
+    std::cout << "  --tolerance <v>       Value differences up to v count as equal (default 0)" << std::endl;
+    std::cout << "  --region-size <n>     Edge of the blocks changed regions are built from (default 32)" << std::endl;
+    std::cout << "  --max-regions <n>     Changed regions to list (default 20)" << std::endl;
+    std::cout << "  --diff <out.vdb>      Write B - A at the changed voxels as a grid" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> files;
+    std::string gridA, gridB;
+    std::string diffFile;
+    float tolerance = 0.0f;
+    int regionSize = 32;
+    size_t maxRegions = 20;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--grid" && i + 1 < argc) {
+            gridA = gridB = argv[++i];
+        } else if (arg == "--grid-a" && i + 1 < argc) {
+            gridA = argv[++i];
+        } else if (arg == "--grid-b" && i + 1 < argc) {
+            gridB = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::atof(argv[++i]);
+        } else if (arg == "--region-size" && i + 1 < argc) {
+            regionSize = std::atoi(argv[++i]);
+        } else if (arg == "--max-regions" && i + 1 < argc) {
+            maxRegions = static_cast<size_t>(std::atol(argv[++i]));
+        } else if (arg == "--diff" && i + 1 < argc) {
+            diffFile = argv[++i];
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "✗ Error: Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 2;
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.size() != 2) {
+        printUsage(argv[0]);
+        return 2;
+    }
+    if (regionSize < kLeafDim || (regionSize & (regionSize - 1)) != 0) {
+        std::cerr << "✗ Error: --region-size must be a power of two of at least " << kLeafDim << std::endl;
+        return 2;
+    }
+
+    openvdb::initialize();
+    registerOutputGridTypes();
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        openvdb::FloatGrid::Ptr a = readGrid(files[0], gridA);
+        openvdb::FloatGrid::Ptr b = readGrid(files[1], gridB);
+        double readSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "=== VDB Diff ===" << std::endl;
+        std::cout << "A: " << files[0] << " (grid " << gridA << ", " << a->activeVoxelCount() << " active voxels)" << std::endl;
+        std::cout << "B: " << files[1] << " (grid " << gridB << ", " << b->activeVoxelCount() << " active voxels)" << std::endl;
+        if (a->background() != b->background()) {
+            std::cout << "Backgrounds differ: " << a->background() << " vs " << b->background() << std::endl;
+        }
+        if (a->transform() != b->transform()) {
+            std::cout << "Warning: transforms differ; comparing in index space" << std::endl;
+        }
+
+        start = std::chrono::steady_clock::now();
+        DiffStats stats;
+        std::vector<openvdb::Coord> changedBlocks;
+        openvdb::FloatGrid::Ptr diff;
+        GridDiff(*a, *b, tolerance, regionSize, !diffFile.empty()).run(stats, changedBlocks, diff);
+        std::vector<ChangedRegion> regions = groupRegions(changedBlocks, regionSize);
+        double diffSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Active in both: " << stats.compared << std::endl;
+        std::cout << "Active only in A: " << stats.onlyA << std::endl;
+        std::cout << "Active only in B: " << stats.onlyB << std::endl;
+        std::cout << "Values differing by more than " << tolerance << ": " << stats.valueDiffs << std::endl;
+        if (stats.compared > 0) {
+            std::cout << "Max |B - A|: " << stats.maxDiff << " at " << stats.maxDiffAt << std::endl;
+            std::cout << "Mean |B - A|: " << stats.sumAbsDiff / stats.compared << std::endl;
+            std::cout << "RMS difference: " << std::sqrt(stats.sumSqDiff / stats.compared) << std::endl;
+        }
+        if (stats.changed) {
+            std::cout << "Changed bbox: " << stats.changedBBox.min() << " - " << stats.changedBBox.max() << std::endl;
+            std::cout << "Changed regions (" << regionSize << "^3 blocks, face-connected): " << regions.size() << std::endl;
+            for (size_t i = 0; i < regions.size() && i < maxRegions; ++i) {
+                std::cout << "  " << regions[i].bbox.min() << " - " << regions[i].bbox.max()
+                          << " (" << regions[i].blocks << " blocks)" << std::endl;
+            }
+            if (regions.size() > maxRegions) {
+                std::cout << "  ... " << regions.size() - maxRegions << " more" << std::endl;
+            }
+        }
+        std::cout << "Read: " << readSeconds << " s, compare: " << diffSeconds << " s" << std::endl;
+
+        if (diff) {
+            diff->insertMeta("diff_a", openvdb::StringMetadata(files[0] + ":" + gridA));
+            diff->insertMeta("diff_b", openvdb::StringMetadata(files[1] + ":" + gridB));
+            openvdb::GridPtrVec grids;
+            grids.push_back(diff);
+            openvdb::io::File(diffFile).write(grids);
+            std::cout << "Difference grid saved to: " << diffFile << " (" << diff->activeVoxelCount()
+                      << " active voxels)" << std::endl;
+        }
+
+        std::cout << (stats.changed ? "✗ Grids differ" : "✓ Grids match") << std::endl;
+        return stats.changed ? 1 : 0;
+    } catch (const std::exception& e) {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        return 2;
+    }
+}
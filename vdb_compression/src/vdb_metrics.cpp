@@ -0,0 +1,108 @@
+#include "OutputPrecision.h"
+#include "QualityMetrics.h"
+#include "VTKSlabReader.h"
+#include <openvdb/openvdb.h>
+#include <openvdb/io/File.h>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " <original.vtk> <compressed.vdb> [options]" << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --grid <name>         Grid to compare (default: the first grid)" << std::endl;
+    std::cout << "  --brick-size <n>      Per-brick error granularity (default: the grid's brick_size, else 32)" << std::endl;
+    std::cout << "  --json <file|->       Write the report as JSON to a file or stdout" << std::endl;
+    std::cout << "  --bricks              List every brick in the JSON report" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string originalFile;
+    std::string vdbFile;
+    std::string gridName;
+    std::string jsonFile;
+    int brickSize = 0;
+    bool allBricks = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--grid" && i + 1 < argc) {
+            gridName = argv[++i];
+        } else if (arg == "--brick-size" && i + 1 < argc) {
+            brickSize = std::atoi(argv[++i]);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonFile = argv[++i];
+        } else if (arg == "--bricks") {
+            allBricks = true;
+        } else if (arg.compare(0, 2, "--") == 0) {
+            std::cerr << "✗ Error: Unknown or incomplete option: " << arg << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        } else if (originalFile.empty()) {
+            originalFile = arg;
+        } else if (vdbFile.empty()) {
+            vdbFile = arg;
+        }
+    }
+    if (originalFile.empty() || vdbFile.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    openvdb::initialize();
+    registerOutputGridTypes();
+
+    try {
+        openvdb::io::File file(vdbFile);
+        file.open();
+        if (gridName.empty()) {
+            openvdb::io::File::NameIterator nameIter = file.beginName();
+            if (nameIter == file.endName()) {
+                throw std::runtime_error("No grids in: " + vdbFile);
+            }
+            gridName = nameIter.gridName();
+        }
+        openvdb::GridBase::Ptr baseGrid = file.readGrid(gridName);
+        file.close();
+
+        openvdb::FloatGrid::Ptr grid = restorePhysicalGrid(baseGrid);
+        if (!grid) {
+            throw std::runtime_error("Grid " + gridName + " is not a scalar compressed grid");
+        }
+        if (brickSize <= 0) {
+            auto meta = grid->getMetadata<openvdb::Int32Metadata>("brick_size");
+            brickSize = meta ? meta->value() : 32;
+        }
+
+        // With the JSON on stdout the human-readable report goes to stderr,
+        // so stdout stays parseable
+        std::ostream& log = (jsonFile == "-") ? std::cerr : std::cout;
+
+        VTKSlabReader original(originalFile);
+        log << "=== Reconstruction Quality ===" << std::endl;
+        log << "Original: " << originalFile << std::endl;
+        log << "Compressed: " << vdbFile << " (grid " << gridName << ")" << std::endl;
+
+        QualityMetrics metrics(grid, brickSize);
+        QualityReport report = metrics.compare(original);
+        QualityMetrics::print(report, log);
+
+        if (jsonFile == "-") {
+            QualityMetrics::writeJSON(report, std::cout, allBricks);
+        } else if (!jsonFile.empty()) {
+            std::ofstream out(jsonFile);
+            if (!out) {
+                throw std::runtime_error("Failed to open for writing: " + jsonFile);
+            }
+            QualityMetrics::writeJSON(report, out, allBricks);
+            std::cout << "JSON report saved to: " << jsonFile << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "✗ Error: " << e.what() << std::endl;
+        return 1;
+    }
+
+    return 0;
+}